@@ -0,0 +1,121 @@
+/*----------------------------------------------------------------------
+Fritzpart - Generates Fritzing parts from a part description script.
+Copyright (C) 2021, Jason Cipriani <jason.cipriani.dev@gmail.com>
+Not affiliated with Fritzing.
+
+This file is part of Fritzpart.
+
+Fritzpart is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+https://github.com/JC3/fritzpart
+----------------------------------------------------------------------*/
+
+#include "atomicfile.h"
+#include <QFileInfo>
+#include <QDir>
+#include <QDebug>
+#include <stdexcept>
+#ifdef Q_OS_WIN
+#  include <windows.h>
+#  include <io.h>
+#else
+#  include <unistd.h>
+#  include <cstdio>
+#endif
+
+static bool replaceFile (const QString &from, const QString &to) {
+#ifdef Q_OS_WIN
+    return MoveFileExW((LPCWSTR)QDir::toNativeSeparators(from).utf16(), (LPCWSTR)QDir::toNativeSeparators(to).utf16(),
+                       MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+#else
+    return ::rename(QFile::encodeName(from).constData(), QFile::encodeName(to).constData()) == 0;
+#endif
+}
+
+static bool linkFile (const QString &from, const QString &to) {
+#ifdef Q_OS_WIN
+    return CreateHardLinkW((LPCWSTR)QDir::toNativeSeparators(to).utf16(), (LPCWSTR)QDir::toNativeSeparators(from).utf16(), nullptr);
+#else
+    return ::link(QFile::encodeName(from).constData(), QFile::encodeName(to).constData()) == 0;
+#endif
+}
+
+static bool syncFile (QFile &file) {
+    if (!file.flush())
+        return false;
+#ifdef Q_OS_WIN
+    return FlushFileBuffers((HANDLE)_get_osfhandle(file.handle()));
+#else
+    return ::fsync(file.handle()) == 0;
+#endif
+}
+
+AtomicFile::AtomicFile (const QString &filename, int backups, bool sync) :
+    filename(QFileInfo(filename).absoluteFilePath()), backups(backups), sync(sync), committed(false)
+{
+    // a hidden file in the same directory, so the final rename never crosses filesystems.
+    const QFileInfo info(this->filename);
+    temp.setFileTemplate(info.absoluteDir().absoluteFilePath(QString(".%1.XXXXXX.tmp").arg(info.fileName())));
+    if (!temp.open())
+        throw std::runtime_error(QString("%1: %2").arg(filename, temp.errorString()).toStdString());
+}
+
+QString AtomicFile::backupFileName (const QString &filename, int n) {
+    return QString("%1.fritzpart.bak%2").arg(filename).arg(n > 1 ? QString::number(n) : QString());
+}
+
+void AtomicFile::commit () {
+
+    if (committed)
+        return;
+
+    if (!temp.isOpen() && sync && !temp.open()) // e.g. closed so an external tool could write it
+        throw std::runtime_error(QString("%1: %2").arg(temp.fileName(), temp.errorString()).toStdString());
+    if (temp.isOpen()) {
+        if (sync ? !syncFile(temp) : !temp.flush())
+            throw std::runtime_error(QString("%1: %2").arg(filename, temp.errorString()).toStdString());
+        temp.close();
+    }
+
+    // temporary files are private to us; the real one should look like any other file.
+    QFile::Permissions perms = QFile::ReadOwner | QFile::WriteOwner | QFile::ReadUser | QFile::WriteUser |
+                               QFile::ReadGroup | QFile::ReadOther;
+    if (QFile::exists(filename))
+        perms = QFile::permissions(filename);
+    QFile::setPermissions(temp.fileName(), perms);
+
+    // rotate: .bak(n-1) -> .bakn, ..., then the current file -> .bak
+    bool renamed = false;
+    if (backups > 0 && QFile::exists(filename)) {
+        QFile::remove(backupFileName(filename, backups));
+        for (int n = backups - 1; n >= 1; -- n)
+            if (QFile::exists(backupFileName(filename, n)))
+                replaceFile(backupFileName(filename, n), backupFileName(filename, n + 1));
+        if (!linkFile(filename, backupFileName(filename, 1))) {
+            qDebug() << "backup: hard link failed, renaming instead";
+            renamed = replaceFile(filename, backupFileName(filename, 1));
+        }
+    }
+
+    if (!replaceFile(temp.fileName(), filename)) {
+        if (renamed) // put things back the way they were
+            replaceFile(backupFileName(filename, 1), filename);
+        throw std::runtime_error(QString("could not replace %1").arg(filename).toStdString());
+    }
+
+    temp.setAutoRemove(false); // it's gone, it's the target now
+    committed = true;
+    qDebug() << "wrote" << filename;
+
+}
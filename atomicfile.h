@@ -0,0 +1,56 @@
+/*----------------------------------------------------------------------
+Fritzpart - Generates Fritzing parts from a part description script.
+Copyright (C) 2021, Jason Cipriani <jason.cipriani.dev@gmail.com>
+Not affiliated with Fritzing.
+
+This file is part of Fritzpart.
+
+Fritzpart is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+https://github.com/JC3/fritzpart
+----------------------------------------------------------------------*/
+
+#ifndef ATOMICFILE_H
+#define ATOMICFILE_H
+
+#include <QString>
+#include <QTemporaryFile>
+
+// replaces a file all at once: everything is written to a temporary file next to the
+// target, which is renamed over the target by commit(). readers (e.g. fritzing, or
+// anybody on a network share) only ever see the old file or the complete new one.
+//
+// if backups > 0 the previous file is kept as filename.fritzpart.bak, with older ones
+// rotated to .bak2, .bak3, ... up to backups deep. the previous file becomes the backup
+// by hard link (or rename, where links aren't possible), never by copying it.
+//
+// if sync is set, the new file is flushed to disk before it's renamed into place.
+// if the object is destroyed without commit() the temporary file is removed and the
+// target is left alone. errors throw std::runtime_error.
+class AtomicFile {
+public:
+    AtomicFile (const QString &filename, int backups = 0, bool sync = false);
+    QFile * file () { return &temp; }        // open for writing
+    QString tempFileName () const { return temp.fileName(); }
+    void commit ();
+    static QString backupFileName (const QString &filename, int n);
+private:
+    QString filename;
+    int backups;
+    bool sync;
+    QTemporaryFile temp;
+    bool committed;
+};
+
+#endif // ATOMICFILE_H
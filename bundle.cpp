@@ -0,0 +1,238 @@
+/*----------------------------------------------------------------------
+Fritzpart - Generates Fritzing parts from a part description script.
+Copyright (C) 2021, Jason Cipriani <jason.cipriani.dev@gmail.com>
+Not affiliated with Fritzing.
+
+This file is part of Fritzpart.
+
+Fritzpart is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+https://github.com/JC3/fritzpart
+----------------------------------------------------------------------*/
+
+#include "bundle.h"
+#include "partsnapshot.h"
+#include <QtConcurrent>
+#include <QDomDocument>
+#include <QFileInfo>
+#include <QDebug>
+#include <functional>
+#include <stdexcept>
+
+PartBundleWriter::PartBundleWriter (const QString &filename, const QString &title) :
+    filename(filename), title(title), file(filename), zip(new ZipWriter(file.file()))
+{
+}
+
+PartBundleWriter::~PartBundleWriter () {
+}
+
+void PartBundleWriter::addPart (const QList<ZipEntry> &entries, const Part &part, const PartFilenames &names) {
+
+    if (!zip)
+        throw std::runtime_error("bundle already closed");
+
+    const QString moduleid = part.metadata[MetaModuleId];
+    if (moduleids.contains(moduleid))
+        throw std::runtime_error(QString("module id %1 is already in the bundle").arg(moduleid).toStdString());
+    if (fzps.contains(names.fzp))
+        throw std::runtime_error(QString("%1 is already in the bundle").arg(names.fzp).toStdString());
+
+    // a part that fails part way through doesn't leave half of itself behind.
+    const int entry = zip->entryCount();
+    try {
+        for (const ZipEntry &entry : entries)
+            zip->add(entry);
+    } catch (...) {
+        zip->truncate(entry);
+        throw;
+    }
+
+    moduleids.insert(moduleid);
+    fzps.insert(names.fzp);
+    instances.append({ moduleid, names.fzp, part.metadata[MetaTitle], entry });
+
+}
+
+// drops every part from count on.
+void PartBundleWriter::truncate (int count) {
+
+    if (!zip)
+        throw std::runtime_error("bundle already closed");
+    if (count >= instances.size())
+        return;
+
+    zip->truncate(instances[count].entry);
+    while (instances.size() > count) {
+        const Instance instance = instances.takeLast();
+        moduleids.remove(instance.moduleid);
+        fzps.remove(instance.fzp);
+    }
+
+}
+
+void PartBundleWriter::close () {
+
+    if (!zip)
+        return;
+
+    // the bin: one instance per part, shown in the bin's icon view.
+    QDomDocument doc;
+    doc.appendChild(doc.createProcessingInstruction("xml", "version=\"1.0\" encoding=\"UTF-8\""));
+    doc.appendChild(doc.createComment("Generated by fritzpart."));
+    QDomElement module = doc.createElement("module");
+    module.setAttribute("fritzingVersion", "0.9.3");
+    module.setAttribute("icon", "Custom1.png");
+    doc.appendChild(module);
+    QDomElement etitle = doc.createElement("title");
+    etitle.appendChild(doc.createTextNode(title));
+    module.appendChild(etitle);
+    QDomElement einstances = doc.createElement("instances");
+    module.appendChild(einstances);
+    for (int n = 0; n < instances.size(); ++ n) {
+        const Instance &instance = instances[n];
+        QDomElement e = doc.createElement("instance");
+        e.setAttribute("moduleIdRef", instance.moduleid);
+        e.setAttribute("modelIndex", n + 1);
+        e.setAttribute("path", instance.fzp);
+        QDomElement t = doc.createElement("title");
+        t.appendChild(doc.createTextNode(instance.title));
+        e.appendChild(t);
+        QDomElement views = doc.createElement("views");
+        QDomElement icon = doc.createElement("iconView");
+        icon.setAttribute("layer", "icon");
+        QDomElement geometry = doc.createElement("geometry");
+        geometry.setAttribute("z", -1);
+        geometry.setAttribute("x", -1);
+        geometry.setAttribute("y", -1);
+        icon.appendChild(geometry);
+        views.appendChild(icon);
+        e.appendChild(views);
+        einstances.appendChild(e);
+    }
+
+    zip->add(compressZipEntry(QFileInfo(filename).completeBaseName() + ".fzb", doc.toByteArray(2), ZipDefaultLevel));
+    zip->close();
+    zip.reset();
+    file.commit();
+
+    qDebug() << "bundle:" << filename << instances.size() << "parts";
+
+}
+
+QList<BundleResult> writePartBundle (const QStringList &scripts, const QString &filename, const QString &title,
+                                     const QString &snapshotdir, int level, int window) {
+
+    if (window <= 0)
+        window = 2 * QThread::idealThreadCount();
+
+    struct Pending {
+        int script;
+        Part part;
+    };
+    struct Generated {
+        QList<ZipEntry> entries;
+        PartFilenames names;
+        QString error;
+    };
+
+    PartBundleWriter bundle(filename, title);
+    QList<BundleResult> results;
+    QList<int> written;  // per script: where its parts start in the bundle, once it has any
+    QList<bool> failed;
+    QList<Pending> pending, inflight;
+    QFuture<Generated> generating;
+
+    // each worker generates and compresses one whole part; with a window of parts going
+    // at once that keeps the pool busy without nesting another parallel map per member.
+    std::function<Generated(const Pending &)> generate = [level](const Pending &p) {
+        Generated g;
+        try {
+            g.names = PartFilenames(p.part.filename);
+            for (const ArchiveMember &member : partArchiveMembers(generatePartDocuments(p.part, g.names), g.names))
+                g.entries.append(compressZipEntry(member.name, member.data, level));
+        } catch (const std::exception &x) {
+            g.error = x.what();
+        }
+        return g;
+    };
+
+    // waits for the window being generated and writes it out, in order. parts of a
+    // script that has failed to compile since are dropped.
+    auto drain = [&]() {
+        generating.waitForFinished();
+        for (int n = 0; n < inflight.size(); ++ n) {
+            const Pending &p = inflight[n];
+            if (failed[p.script])
+                continue;
+            const Generated g = generating.resultAt(n);
+            BundleResult &result = results[p.script];
+            if (written[p.script] < 0)
+                written[p.script] = bundle.partCount();
+            try {
+                if (g.error != "")
+                    throw std::runtime_error(g.error.toStdString());
+                bundle.addPart(g.entries, p.part, g.names);
+                result.parts.append(g.names.fzp);
+            } catch (const std::exception &x) {
+                result.error += QString("%1%2: %3").arg(result.error == "" ? "" : "\n", p.part.filename, x.what());
+            }
+        }
+        inflight.clear();
+        generating = QFuture<Generated>();
+    };
+
+    // writes out the previous window, then starts generating the pending parts in the
+    // background, so compiling (e.g. the next blocks of a multi-part script) carries on
+    // while they're generated.
+    auto flush = [&]() {
+        drain();
+        inflight = pending;
+        pending.clear();
+        generating = QtConcurrent::mapped(inflight, generate);
+    };
+
+    for (const QString &script : scripts) {
+        const int current = results.size();
+        results.append(BundleResult());
+        results.last().source = script;
+        written.append(-1);
+        failed.append(false);
+        try {
+            compileScriptCached(script, snapshotdir, [&](const PartVariant &variant) {
+                pending.append({ current, variant.part });
+                if (pending.size() >= window)
+                    flush();
+            });
+        } catch (const std::exception &x) {
+            BundleResult &result = results[current];
+            result.error += QString("%1%2").arg(result.error == "" ? "" : "\n", x.what());
+            failed[current] = true;
+            for (int n = pending.size() - 1; n >= 0; -- n)
+                if (pending[n].script == current)
+                    pending.removeAt(n);
+            // parts are written in order, so everything from its first one on is its own.
+            if (written[current] >= 0) {
+                bundle.truncate(written[current]);
+                result.parts.clear();
+            }
+        }
+    }
+    flush();
+    drain();
+
+    bundle.close();
+    return results;
+
+}
@@ -0,0 +1,80 @@
+/*----------------------------------------------------------------------
+Fritzpart - Generates Fritzing parts from a part description script.
+Copyright (C) 2021, Jason Cipriani <jason.cipriani.dev@gmail.com>
+Not affiliated with Fritzing.
+
+This file is part of Fritzpart.
+
+Fritzpart is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+https://github.com/JC3/fritzpart
+----------------------------------------------------------------------*/
+
+#ifndef BUNDLE_H
+#define BUNDLE_H
+
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QSet>
+#include <QScopedPointer>
+#include "part.h"
+#include "partgen.h"
+#include "zipwriter.h"
+#include "atomicfile.h"
+
+// streams parts into a fritzing bin bundle (.fzbz): every part's fzp and svgs go into
+// one zip as they're added, and the bin (.fzb) listing them all is written at the end
+// by close(), which is also when the finished bundle replaces any existing one. only
+// the (small) bin index is kept around between parts. truncate() takes parts back out
+// of the end, e.g. the ones from a script that failed part way through.
+class PartBundleWriter {
+public:
+    PartBundleWriter (const QString &filename, const QString &title);
+    ~PartBundleWriter ();
+    void addPart (const QList<ZipEntry> &entries, const Part &part, const PartFilenames &names);
+    void truncate (int count);
+    void close ();
+    int partCount () const { return instances.size(); }
+private:
+    struct Instance {
+        QString moduleid;
+        QString fzp;
+        QString title;
+        int entry; // its first zip entry
+    };
+    QString filename;
+    QString title;
+    AtomicFile file;
+    QScopedPointer<ZipWriter> zip;
+    QList<Instance> instances;
+    QSet<QString> moduleids;
+    QSet<QString> fzps;
+};
+
+struct BundleResult {
+    QString source;      // script
+    QStringList parts;   // fzp filenames added
+    QString error;
+};
+
+// compiles scripts (all variants) and streams the parts into a bundle. parts are
+// generated and compressed in parallel, a window of at most window parts at a time,
+// and written in order as each window finishes. scripts that fail to compile are
+// reported, and whatever of their parts were already written is taken back out.
+// scripts with a current snapshot in snapshotdir (if given) aren't compiled again.
+QList<BundleResult> writePartBundle (const QStringList &scripts, const QString &filename, const QString &title,
+                                     const QString &snapshotdir = QString(), int level = ZipDefaultLevel, int window = 0);
+
+#endif // BUNDLE_H
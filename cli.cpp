@@ -0,0 +1,517 @@
+/*----------------------------------------------------------------------
+Fritzpart - Generates Fritzing parts from a part description script.
+Copyright (C) 2021, Jason Cipriani <jason.cipriani.dev@gmail.com>
+Not affiliated with Fritzing.
+
+This file is part of Fritzpart.
+
+Fritzpart is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+https://github.com/JC3/fritzpart
+----------------------------------------------------------------------*/
+
+#include "cli.h"
+#include "partverifier.h"
+#include "partscript.h"
+#include "fzpimporter.h"
+#include "kicadimporter.h"
+#include "partcompiler.h"
+#include "partsnapshot.h"
+#include "libraryindex.h"
+#include "partgen.h"
+#include "bundle.h"
+#include "distbuild.h"
+#include "memstats.h"
+#include <QtConcurrent>
+#include <QCommandLineParser>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QTextStream>
+#include <QElapsedTimer>
+#include <cstdio>
+#include <functional>
+#include <stdexcept>
+#ifdef Q_OS_WIN
+#  include <windows.h>
+#endif
+
+bool isCommandLineMode (int argc, char *argv[]) {
+    return argc > 1 && QByteArray(argv[1]).startsWith("--");
+}
+
+QStringList findFiles (const QStringList &paths, const QStringList &filters) {
+    QStringList files;
+    for (const QString &path : paths) {
+        if (QFileInfo(path).isDir()) {
+            QDirIterator it(path, filters, QDir::Files, QDirIterator::Subdirectories);
+            while (it.hasNext())
+                files.append(it.next());
+        } else {
+            files.append(path);
+        }
+    }
+    return files;
+}
+
+static int verify (const QStringList &paths) {
+
+    QTextStream out(stdout);
+    QElapsedTimer timer;
+    timer.start();
+
+    QStringList files = findFiles(paths, { "*.fzpz" });
+    QList<VerifyResult> results = verifyPartArchives(files);
+
+    int failed = 0;
+    for (const VerifyResult &result : results) {
+        if (result.ok())
+            continue;
+        ++ failed;
+        out << "FAIL " << result.filename << "\n";
+        for (const QString &error : result.errors)
+            out << "  " << error << "\n";
+    }
+    out << QString("%1 of %2 parts ok (%3 ms).").arg(results.size() - failed).arg(results.size()).arg(timer.elapsed()) << "\n";
+
+    return failed ? 1 : 0;
+
+}
+
+// compiles scripts (every variant of param sweeps) and builds their fzpz files.
+static int build (const QStringList &paths, const QString &outdir, const QString &snapshotdir, const ArchiveOptions &options) {
+
+    QTextStream out(stdout);
+    QElapsedTimer timer;
+    timer.start();
+
+    if (outdir != "" && !QDir().mkpath(outdir)) {
+        out << "could not create " << outdir << "\n";
+        return 1;
+    }
+
+    QStringList files = PartCompiler::withoutPinTables(findFiles(paths, { "*.txt" }));
+    QHash<QString,LibraryIndex> libraries; // by root, for scripts in an indexed library
+    int failed = 0, built = 0;
+    const MemCounters memstart = memCounters();
+    for (const QString &filename : files) {
+        const MemCounters membefore = memCounters();
+        try {
+            // module ids are checked against the rest of the library before any part is built.
+            const QString root = LibraryIndex::findRoot(filename);
+            if (root != "" && !libraries.contains(root)) {
+                LibraryIndex library(root);
+                library.load();
+                libraries.insert(root, library);
+            }
+            LibraryIndex *library = (root == "" ? nullptr : &libraries[root]);
+            // parts are built in the background as they come out of the compiler, so the
+            // blocks of a multi-part script are built while the next ones are parsed. in a
+            // library they're held until the whole script is checked, so a collision in a
+            // later block doesn't leave the earlier ones written.
+            bool cached;
+            QList<Part> indexed;
+            PartArchiveQueue queue(outdir == "" ? filename : outdir, options, false);
+            compileScriptCached(filename, snapshotdir, [&](const PartVariant &variant) {
+                if (library)
+                    indexed.append(variant.part);
+                else
+                    queue.add(variant.part);
+            }, &cached);
+            if (library) {
+                const QStringList problems = library->collisions(filename, indexed);
+                if (!problems.empty())
+                    throw std::runtime_error(problems.join("; ").toStdString());
+                for (const Part &part : indexed)
+                    queue.add(part);
+            }
+            QStringList fzpzs = queue.finish();
+            if (library)
+                library->update(filename, indexed);
+            built += fzpzs.size();
+            out << "ok   " << filename << " -> " << (fzpzs.size() == 1 ? fzpzs.first() : QString("%1 parts").arg(fzpzs.size()))
+                << (cached ? " (snapshot)" : "") << "\n";
+            if (memStatsEnabled())
+                out << memStatsTable(memCounters() - membefore) << "\n";
+        } catch (const std::exception &x) {
+            ++ failed;
+            out << "FAIL " << filename << ": " << x.what() << "\n";
+        }
+    }
+    bool indexfailed = false;
+    for (LibraryIndex &library : libraries) {
+        try {
+            library.save();
+        } catch (const std::exception &x) {
+            indexfailed = true;
+            out << "FAIL " << LibraryIndex::indexFileName(library.root()) << ": " << x.what() << "\n";
+        }
+    }
+    out << QString("%1 of %2 scripts built, %3 parts (%4 ms).").arg(files.size() - failed).arg(files.size()).arg(built).arg(timer.elapsed()) << "\n";
+    if (memStatsEnabled())
+        out << memStatsSummary(memCounters() - memstart) << "\n" << memStatsTable(memCounters() - memstart) << "\n";
+
+    return (failed || indexfailed) ? 1 : 0;
+
+}
+
+// builds the scripts in worker processes instead (see DistBuildCoordinator). snapshots
+// and library indexes aren't used here, so module ids aren't checked against the
+// library and its index isn't updated. parts are all written by the coordinator, which
+// fails a script whose part would overwrite another script's.
+static int distributedBuild (const QStringList &paths, const DistBuildOptions &options) {
+
+    QTextStream out(stdout);
+    QElapsedTimer timer;
+    timer.start();
+
+    if (options.outdir != "" && !QDir().mkpath(options.outdir)) {
+        out << "could not create " << options.outdir << "\n";
+        return 1;
+    }
+
+    QStringList files = PartCompiler::withoutPinTables(findFiles(paths, { "*.txt" }));
+    int failed = 0, built = 0;
+    try {
+        DistBuildCoordinator coordinator(files, options);
+        coordinator.run([&](const DistBuildResult &result) {
+            if (result.error != "") {
+                ++ failed;
+                out << "FAIL " << result.script << ": " << result.error << "\n";
+            } else {
+                built += result.fzpzs.size();
+                out << "ok   " << result.script << " -> "
+                    << (result.fzpzs.size() == 1 ? result.fzpzs.first() : QString("%1 parts").arg(result.fzpzs.size())) << "\n";
+            }
+            out.flush();
+        });
+    } catch (const std::exception &x) {
+        out << "FAIL " << x.what() << "\n";
+        return 1;
+    }
+    out << QString("%1 of %2 scripts built, %3 parts (%4 ms).").arg(files.size() - failed).arg(files.size()).arg(built).arg(timer.elapsed()) << "\n";
+
+    return failed ? 1 : 0;
+
+}
+
+// creates or brings up to date the library index in each directory, and reports
+// scripts that don't compile and module ids used more than once.
+static int indexLibraries (const QStringList &paths) {
+
+    QTextStream out(stdout);
+    QElapsedTimer timer;
+    timer.start();
+
+    int problems = 0;
+    for (const QString &path : paths) {
+        try {
+            if (!QFileInfo(path).isDir())
+                throw std::runtime_error("not a directory");
+            LibraryIndex library(QFileInfo(path).absoluteFilePath());
+            library.load();
+            for (const QString &problem : library.refresh()) {
+                ++ problems;
+                out << "  " << problem << "\n";
+            }
+            library.save();
+            out << "ok   " << path << " (" << library.scriptCount() << " scripts)\n";
+        } catch (const std::exception &x) {
+            ++ problems;
+            out << "FAIL " << path << ": " << x.what() << "\n";
+        }
+    }
+    out << QString("%1 problem(s) (%2 ms).").arg(problems).arg(timer.elapsed()) << "\n";
+
+    return problems ? 1 : 0;
+
+}
+
+// looks parts up in the library containing each path (or the current directory).
+static int findParts (const QString &query, QStringList paths) {
+
+    QTextStream out(stdout);
+    if (paths.empty())
+        paths.append(".");
+
+    int found = 0;
+    for (const QString &path : paths) {
+        const QString root = LibraryIndex::findRoot(QFileInfo(path).absoluteFilePath());
+        if (root == "") {
+            out << "FAIL " << path << ": not in an indexed library (see --index)\n";
+            continue;
+        }
+        try {
+            LibraryIndex library(root);
+            library.load();
+            for (const LibraryEntry &entry : library.search(query)) {
+                ++ found;
+                out << entry.moduleid << "\t" << entry.script << "\t" << entry.fzpz << "\n";
+            }
+        } catch (const std::exception &x) {
+            out << "FAIL " << root << ": " << x.what() << "\n";
+        }
+    }
+
+    return found ? 0 : 1;
+
+}
+
+// compiles scripts and streams every part into one bin bundle.
+static int bundle (const QStringList &paths, const QString &filename, const QString &title, const QString &snapshotdir, int level) {
+
+    QTextStream out(stdout);
+    QElapsedTimer timer;
+    timer.start();
+
+    QStringList files = PartCompiler::withoutPinTables(findFiles(paths, { "*.txt" }));
+    QList<BundleResult> results;
+    const MemCounters memstart = memCounters();
+    try {
+        results = writePartBundle(files, filename, title == "" ? QFileInfo(filename).completeBaseName() : title, snapshotdir, level);
+    } catch (const std::exception &x) {
+        out << "FAIL " << filename << ": " << x.what() << "\n";
+        return 1;
+    }
+
+    int failed = 0, parts = 0;
+    for (const BundleResult &result : results) {
+        parts += result.parts.size();
+        if (result.error != "") {
+            ++ failed;
+            out << "FAIL " << result.source << ": " << result.error << "\n";
+        } else {
+            out << "ok   " << result.source << " (" << result.parts.size() << " parts)\n";
+        }
+    }
+    out << QString("%1 parts from %2 of %3 scripts written to %4 (%5 ms).").arg(parts).arg(results.size() - failed)
+           .arg(results.size()).arg(filename).arg(timer.elapsed()) << "\n";
+    if (memStatsEnabled())
+        out << memStatsSummary(memCounters() - memstart) << "\n" << memStatsTable(memCounters() - memstart) << "\n";
+
+    return failed ? 1 : 0;
+
+}
+
+// writes script text for an imported part; outdir may be empty to put it next to the source.
+static QString writeImportedScript (const QString &source, const QString &outdir, const QString &script, bool overwrite) {
+    QFileInfo info(source);
+    QDir dir = (outdir == "" ? info.absoluteDir() : QDir(outdir));
+    QString filename = dir.absoluteFilePath(info.completeBaseName() + ".txt");
+    if (!overwrite && QFile::exists(filename))
+        throw std::runtime_error(QString("%1 already exists").arg(filename).toStdString());
+    QFile file(filename);
+    if (!file.open(QFile::WriteOnly | QFile::Text))
+        throw std::runtime_error(file.errorString().toStdString());
+    QByteArray data = script.toUtf8();
+    if (file.write(data) != data.length())
+        throw std::runtime_error(file.errorString().toStdString());
+    return filename;
+}
+
+struct ImportOutcome {
+    QString source;
+    QString output;
+    QString error;
+    QStringList warnings;
+};
+
+// builds an fzpz for an imported part. the script is round tripped through the compiler
+// so the part gets exactly the same defaults and checks as one built from the editor.
+static QString buildImportedPart (const QString &source, const QString &outdir, const QString &script, const ArchiveOptions &options, bool overwrite) {
+    Part part = PartCompiler().compile(script);
+    PartFilenames names(part.filename, outdir == "" ? source : outdir);
+    if (!overwrite && QFile::exists(names.fzpz))
+        throw std::runtime_error(QString("%1 already exists").arg(names.fzpz).toStdString());
+    writePartArchive(generatePartDocuments(part, names), names, options, false);
+    return names.fzpz;
+}
+
+typedef std::function<Part(const QString &, QStringList *)> PartImporter;
+
+static int importParts (const QStringList &files, PartImporter importer, const QString &outdir, bool overwrite, bool fzpz, const ArchiveOptions &options) {
+
+    QTextStream out(stdout);
+    QElapsedTimer timer;
+    timer.start();
+
+    if (outdir != "" && !QDir().mkpath(outdir)) {
+        out << "could not create " << outdir << "\n";
+        return 1;
+    }
+
+    // each file is read, converted and written by one worker without holding on to
+    // anything afterwards, so memory use is bounded by the number of threads.
+    auto convert = [&](const QString &source) {
+        ImportOutcome outcome;
+        outcome.source = source;
+        try {
+            Part part = importer(source, &outcome.warnings);
+            QString script = writePartScript(part, { QString("imported from %1").arg(QFileInfo(source).fileName()) });
+            if (fzpz)
+                outcome.output = buildImportedPart(source, outdir, script, options, overwrite);
+            else
+                outcome.output = writeImportedScript(source, outdir, script, overwrite);
+        } catch (const std::exception &x) {
+            outcome.error = x.what();
+        }
+        return outcome;
+    };
+    QList<ImportOutcome> outcomes = QtConcurrent::blockingMapped<QList<ImportOutcome> >(files, std::function<ImportOutcome(const QString &)>(convert));
+
+    int failed = 0;
+    for (const ImportOutcome &outcome : outcomes) {
+        if (outcome.error != "") {
+            ++ failed;
+            out << "FAIL " << outcome.source << ": " << outcome.error << "\n";
+        } else {
+            out << "ok   " << outcome.source << " -> " << outcome.output << "\n";
+        }
+        for (const QString &warning : outcome.warnings)
+            out << "  warning: " << warning << "\n";
+    }
+    out << QString("%1 of %2 parts imported (%3 ms).").arg(outcomes.size() - failed).arg(outcomes.size()).arg(timer.elapsed()) << "\n";
+
+    return failed ? 1 : 0;
+
+}
+
+int runCommandLine (QCoreApplication &app) {
+
+#ifdef Q_OS_WIN
+    // we're a gui subsystem app, so borrow the console we were started from (if any).
+    if (AttachConsole(ATTACH_PARENT_PROCESS)) {
+        freopen("CONOUT$", "w", stdout);
+        freopen("CONOUT$", "w", stderr);
+    }
+#endif
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Generates Fritzing parts from a part description script.");
+    parser.addHelpOption();
+    parser.addVersionOption();
+
+    QCommandLineOption optBuild("build", "Build .fzpz parts from part scripts (.txt), including every variant of "
+                                "scripts with param sweeps.");
+    parser.addOption(optBuild);
+    QCommandLineOption optBundle("bundle", "With --build, put all of the parts into a single Fritzing bin bundle.", "file.fzbz");
+    parser.addOption(optBundle);
+    QCommandLineOption optBundleTitle("bundle-title", "Title of the bundle's bin (default: the bundle filename).", "title");
+    parser.addOption(optBundleTitle);
+    QCommandLineOption optLevel("level", "Compression level for built archives, 0 (store only) to 9 "
+                                "(default: from the GUI settings).", "0-9");
+    parser.addOption(optLevel);
+    QCommandLineOption optVerify("verify", "Check the connector and layer references in built .fzpz files, "
+                                 "and that their module IDs are unique.");
+    parser.addOption(optVerify);
+    QCommandLineOption optImportFzp("import-fzp", "Convert existing Fritzing parts (.fzpz, or .fzp with SVGs in the "
+                                    "usual Fritzing folder layout) to part scripts.");
+    parser.addOption(optImportFzp);
+    QCommandLineOption optImportKicad("import-kicad", "Convert KiCad footprints (.kicad_mod, or .pretty library "
+                                      "directories) to part scripts.");
+    parser.addOption(optImportKicad);
+    QCommandLineOption optFzpz("fzpz", "With --import-fzp or --import-kicad, build .fzpz parts instead of writing scripts.");
+    parser.addOption(optFzpz);
+    QCommandLineOption optOutput({ "o", "output" }, "Output directory for converted files (default: next to the source).", "dir");
+    parser.addOption(optOutput);
+    QCommandLineOption optOverwrite("overwrite", "Replace existing output files.");
+    parser.addOption(optOverwrite);
+    QCommandLineOption optSnapshots("snapshots", "With --build, keep compiled parts in dir and reuse them for scripts "
+                                    "that haven't changed since.", "dir");
+    parser.addOption(optSnapshots);
+    QCommandLineOption optIndex("index", "Create or update the library index in each of the given directories, and "
+                                "report module IDs that are used more than once. --build checks and updates the index "
+                                "of the library a script is in.");
+    parser.addOption(optIndex);
+    QCommandLineOption optFind("find", "Look up parts in the indexed library containing the given paths (default: the "
+                               "current directory) by module ID, part number, family, tag or property name=value; "
+                               "field:value looks in just one of those.", "query");
+    parser.addOption(optFind);
+    QCommandLineOption optMemStats("memstats", "With --build, report operator new calls by pipeline stage (fritzpart's own; on "
+                                   "Windows, not Qt's) and the process's peak memory use.");
+    parser.addOption(optMemStats);
+    QCommandLineOption optWorkers("workers", "With --build, build scripts in n separate worker processes, so one that "
+                                  "crashes or hangs doesn't stop the rest.", "n");
+    parser.addOption(optWorkers);
+    QCommandLineOption optListen("listen", "With --build, also accept workers from other hosts (started with --worker "
+                                 "host:port) on the given tcp port. FRITZPART_WORKER_TOKEN has to be set to the same "
+                                 "secret here and on the workers.", "port");
+    parser.addOption(optListen);
+    QCommandLineOption optJobTimeout("job-timeout", "With --workers or --listen, give up on a script's worker after this "
+                                     "many seconds (default: 600, 0 for no limit).", "seconds");
+    parser.addOption(optJobTimeout);
+    QCommandLineOption optWorker("worker", "Run as a build worker for the --build at address (host:port), with the "
+                                 "build's FRITZPART_WORKER_TOKEN.", "address");
+    parser.addOption(optWorker);
+    parser.addPositionalArgument("paths", "Files or directories (searched recursively).", "[paths...]");
+
+    parser.process(app);
+
+    if (parser.isSet(optMemStats))
+        setMemStatsEnabled(true);
+
+    ArchiveOptions options = ArchiveOptions::fromSettings();
+    if (parser.isSet(optLevel)) {
+        bool ok;
+        options.level = parser.value(optLevel).toInt(&ok);
+        if (!ok || options.level < ZipStore || options.level > ZipBest) {
+            QTextStream(stderr) << "invalid --level: " << parser.value(optLevel) << "\n";
+            return 1;
+        }
+    }
+
+    if (parser.isSet(optWorker))
+        return runBuildWorker(parser.value(optWorker));
+
+    if (parser.isSet(optBuild) && (parser.isSet(optWorkers) || parser.isSet(optListen))) {
+        DistBuildOptions distoptions;
+        bool ok = true, okport = true, oktimeout = true;
+        distoptions.workers = parser.isSet(optWorkers) ? parser.value(optWorkers).toInt(&ok) : 0;
+        distoptions.port = parser.isSet(optListen) ? parser.value(optListen).toUShort(&okport) : 0;
+        if (parser.isSet(optJobTimeout))
+            distoptions.timeout = parser.value(optJobTimeout).toInt(&oktimeout);
+        if (!ok || distoptions.workers < 0 || !okport || !oktimeout || distoptions.timeout < 0) {
+            QTextStream(stderr) << "invalid --workers, --listen or --job-timeout\n";
+            return 1;
+        }
+        if (parser.isSet(optBundle)) {
+            QTextStream(stderr) << "--bundle can't be used with --workers or --listen\n";
+            return 1;
+        }
+        distoptions.outdir = parser.value(optOutput);
+        distoptions.level = options.level;
+        distoptions.sync = options.sync;
+        return distributedBuild(parser.positionalArguments(), distoptions);
+    }
+
+    if (parser.isSet(optBuild) && parser.isSet(optBundle))
+        return bundle(parser.positionalArguments(), parser.value(optBundle), parser.value(optBundleTitle),
+                      parser.value(optSnapshots), options.level);
+    else if (parser.isSet(optBuild))
+        return build(parser.positionalArguments(), parser.value(optOutput), parser.value(optSnapshots), options);
+    else if (parser.isSet(optIndex))
+        return indexLibraries(parser.positionalArguments());
+    else if (parser.isSet(optFind))
+        return findParts(parser.value(optFind), parser.positionalArguments());
+    else if (parser.isSet(optVerify))
+        return verify(parser.positionalArguments());
+    else if (parser.isSet(optImportFzp))
+        return importParts(findFiles(parser.positionalArguments(), { "*.fzpz", "*.fzp" }), importFritzingPart,
+                           parser.value(optOutput), parser.isSet(optOverwrite), parser.isSet(optFzpz), options);
+    else if (parser.isSet(optImportKicad))
+        return importParts(findFiles(parser.positionalArguments(), { "*.kicad_mod" }), importKicadFootprint,
+                           parser.value(optOutput), parser.isSet(optOverwrite), parser.isSet(optFzpz), options);
+
+    parser.showHelp(1);
+
+}
@@ -0,0 +1,613 @@
+/*----------------------------------------------------------------------
+Fritzpart - Generates Fritzing parts from a part description script.
+Copyright (C) 2021, Jason Cipriani <jason.cipriani.dev@gmail.com>
+Not affiliated with Fritzing.
+
+This file is part of Fritzpart.
+
+Fritzpart is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+https://github.com/JC3/fritzpart
+----------------------------------------------------------------------*/
+
+
+#include "distbuild.h"
+#include "partcompiler.h"
+#include "partgen.h"
+#include "atomicfile.h"
+#include <QBuffer>
+#include <QCoreApplication>
+#include <QDataStream>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QProcess>
+#include <QProcessEnvironment>
+#include <QRandomGenerator>
+#include <QScopedPointer>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTextStream>
+#include <stdexcept>
+
+// ---- protocol: each message is a QDataStream'd QByteArray (so, length prefixed)
+// holding a type byte and its fields.
+
+namespace {
+
+enum MessageType : quint8 {
+    MsgHello = 1,   // worker: version, pid, token
+    MsgJob,         // coordinator: id, script, text, level
+    MsgCancel,      // coordinator: id (ignored if already started)
+    MsgStarted,     // worker: id
+    MsgResult,      // worker: id, error, fzpz file names, fzpz bytes
+    MsgQuit         // coordinator
+};
+
+const quint32 ProtocolVersion = 2;
+const char * const TokenVariable = "FRITZPART_WORKER_TOKEN";
+
+template <typename... Args> QByteArray message (MessageType type, const Args &... args) {
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_5_12);
+    out << (quint8)type;
+    (out << ... << args);
+    return payload;
+}
+
+void writeMessage (QIODevice *socket, const QByteArray &payload) {
+    QDataStream out(socket);
+    out.setVersion(QDataStream::Qt_5_12);
+    out << payload;
+}
+
+// false if a whole message hasn't arrived yet.
+bool readMessage (QDataStream &in, QByteArray *payload) {
+    in.startTransaction();
+    in >> *payload;
+    return in.commitTransaction();
+}
+
+}
+
+// ---- coordinator
+
+DistBuildCoordinator::DistBuildCoordinator (const QStringList &scripts, const DistBuildOptions &options) :
+    options(options),
+    local(nullptr),
+    tcp(nullptr),
+    remaining(scripts.size()),
+    spawned(0)
+{
+    for (const QString &script : scripts) {
+        Job job;
+        job.result.script = script;
+        job.attempts = 0;
+        job.done = false;
+        job.timedout = false;
+        queue.append(jobs.size());
+        jobs.append(job);
+    }
+    watchdog.setInterval(1000);
+    connect(&watchdog, &QTimer::timeout, this, &DistBuildCoordinator::checkTimeouts);
+}
+
+DistBuildCoordinator::~DistBuildCoordinator () {
+    qDeleteAll(workers);
+}
+
+QList<DistBuildResult> DistBuildCoordinator::run (const std::function<void(const DistBuildResult &)> &finished) {
+
+    report = finished;
+
+    // anybody who can reach the port can connect, so remote workers have to know a
+    // token the user picked. local ones are handed a made up one.
+    token = qgetenv(TokenVariable);
+    if (options.port && token.isEmpty())
+        throw std::runtime_error(QString("--listen needs a token in %1, on this host and the workers'").arg(TokenVariable).toStdString());
+    if (token.isEmpty()) {
+        quint32 random[4];
+        QRandomGenerator::system()->fillRange(random);
+        token = QByteArray(reinterpret_cast<const char *>(random), sizeof(random)).toHex();
+    }
+
+    if (options.workers > 0) {
+        const QString name = QString("fritzpart-%1").arg(QCoreApplication::applicationPid());
+        QLocalServer::removeServer(name);
+        local = new QLocalServer(this);
+        local->setSocketOptions(QLocalServer::UserAccessOption);
+        if (!local->listen(name))
+            throw std::runtime_error(QString("local server: %1").arg(local->errorString()).toStdString());
+        connect(local, &QLocalServer::newConnection, this, [this] () {
+            while (QLocalSocket *socket = local->nextPendingConnection())
+                accepted(socket, false);
+        });
+    }
+    if (options.port) {
+        tcp = new QTcpServer(this);
+        if (!tcp->listen(QHostAddress::Any, options.port))
+            throw std::runtime_error(QString("port %1: %2").arg(options.port).arg(tcp->errorString()).toStdString());
+        connect(tcp, &QTcpServer::newConnection, this, [this] () {
+            while (QTcpSocket *socket = tcp->nextPendingConnection())
+                accepted(socket, true);
+        });
+        qDebug() << "distbuild: waiting for workers on port" << options.port;
+    }
+    if (!local && !tcp)
+        throw std::runtime_error("no workers");
+
+    for (int n = 0; n < qMin(options.workers, jobs.size()); ++ n)
+        spawn();
+
+    if (remaining > 0) {
+        if (options.timeout > 0)
+            watchdog.start();
+        loop.exec();
+        watchdog.stop();
+    }
+
+    // done: let the workers go.
+    for (Worker *worker : workers) {
+        writeMessage(worker->socket, message(MsgQuit));
+        worker->socket->waitForBytesWritten(1000);
+    }
+    for (QProcess *process : findChildren<QProcess *>()) {
+        if (!process->waitForFinished(3000))
+            process->kill();
+    }
+
+    QList<DistBuildResult> results;
+    for (const Job &job : jobs)
+        results.append(job.result);
+    return results;
+
+}
+
+void DistBuildCoordinator::spawn () {
+
+    QProcess *process = new QProcess(this);
+    process->setProgram(QCoreApplication::applicationFilePath());
+    process->setArguments({ "--worker", "local:" + local->fullServerName() });
+    QProcessEnvironment environment = QProcessEnvironment::systemEnvironment();
+    environment.insert(TokenVariable, QString::fromLatin1(token));
+    process->setProcessEnvironment(environment);
+    process->setStandardOutputFile(QProcess::nullDevice());
+    process->setStandardErrorFile(QProcess::nullDevice());
+    connect(process, QOverload<int,QProcess::ExitStatus>::of(&QProcess::finished), this, [this, process] () {
+        processExited(process);
+    });
+    connect(process, &QProcess::errorOccurred, this, [this, process] (QProcess::ProcessError error) {
+        if (error == QProcess::FailedToStart)
+            processExited(process);
+    });
+    starting.append(process);
+    ++ spawned;
+    process->start();
+
+}
+
+void DistBuildCoordinator::accepted (QIODevice *socket, bool remote) {
+
+    Worker *worker = new Worker;
+    worker->socket = socket;
+    worker->process = nullptr;
+    worker->remote = remote;
+    worker->ready = false;
+    worker->running = -1;
+    workers.append(worker);
+
+    connect(socket, &QIODevice::readyRead, this, [this, worker] () {
+        readMessages(worker);
+    });
+    // queued, so a worker is never dropped from inside one of its own handlers.
+    auto disconnected = [this, worker] () {
+        lost(worker);
+    };
+    if (QLocalSocket *s = qobject_cast<QLocalSocket *>(socket))
+        connect(s, &QLocalSocket::disconnected, this, disconnected, Qt::QueuedConnection);
+    else if (QTcpSocket *s = qobject_cast<QTcpSocket *>(socket))
+        connect(s, &QTcpSocket::disconnected, this, disconnected, Qt::QueuedConnection);
+
+    readMessages(worker);
+
+}
+
+void DistBuildCoordinator::readMessages (Worker *worker) {
+
+    QDataStream in(worker->socket);
+    in.setVersion(QDataStream::Qt_5_12);
+    QByteArray payload;
+    while (workers.contains(worker) && readMessage(in, &payload))
+        handleMessage(worker, payload);
+
+}
+
+void DistBuildCoordinator::handleMessage (Worker *worker, const QByteArray &payload) {
+
+    QDataStream in(payload);
+    in.setVersion(QDataStream::Qt_5_12);
+    quint8 type;
+    in >> type;
+
+    if (type == MsgHello) {
+        quint32 version;
+        qint64 pid;
+        QByteArray hello;
+        in >> version >> pid >> hello;
+        if (version != ProtocolVersion) {
+            qWarning() << "distbuild: dropping worker with protocol version" << version;
+            worker->socket->close();
+            return;
+        }
+        if (hello != token) {
+            qWarning() << "distbuild: dropping worker with the wrong token";
+            worker->socket->close();
+            return;
+        }
+        worker->ready = true;
+        // match local workers up with their processes, so they can be killed if they hang.
+        for (QProcess *process : starting) {
+            if (!worker->remote && process->processId() == pid) {
+                worker->process = process;
+                starting.removeOne(process);
+                break;
+            }
+        }
+        fill(worker);
+    } else if (!worker->ready) {
+        qWarning() << "distbuild: dropping worker that didn't say hello";
+        worker->socket->close();
+    } else if (type == MsgStarted) {
+        qint32 id;
+        in >> id;
+        if (worker->assigned.contains(id)) {
+            worker->running = id;
+            worker->started.start();
+        }
+    } else if (type == MsgResult) {
+        qint32 id;
+        QString error;
+        QStringList names;
+        QList<QByteArray> data;
+        in >> id >> error >> names >> data;
+        if (id >= 0 && id < jobs.size())
+            complete(worker, id, error, names, data);
+    }
+
+}
+
+// tops the worker up to Prefetch scripts, or gives it somebody else's if there are none left.
+void DistBuildCoordinator::fill (Worker *worker) {
+
+    while (worker->assigned.size() < Prefetch && !queue.empty())
+        assign(worker, queue.takeFirst());
+    if (worker->assigned.empty())
+        steal(worker);
+
+}
+
+void DistBuildCoordinator::steal (Worker *thief) {
+
+    Worker *victim = nullptr;
+    int most = 0;
+    for (Worker *worker : workers) {
+        int waiting = worker->assigned.size() - (worker->running >= 0 ? 1 : 0);
+        if (worker != thief && waiting > most) {
+            victim = worker;
+            most = waiting;
+        }
+    }
+    if (!victim)
+        return;
+
+    // if the victim started it anyway, whichever result arrives first wins.
+    const int id = victim->assigned.takeLast();
+    writeMessage(victim->socket, message(MsgCancel, (qint32)id));
+    assign(thief, id);
+
+}
+
+void DistBuildCoordinator::assign (Worker *worker, int id) {
+
+    QFile file(jobs[id].result.script);
+    if (!file.open(QFile::ReadOnly)) {
+        finish(id, file.errorString());
+        return;
+    }
+
+    worker->assigned.append(id);
+    writeMessage(worker->socket, message(MsgJob, (qint32)id, jobs[id].result.script, file.readAll(), (qint32)options.level));
+
+}
+
+void DistBuildCoordinator::complete (Worker *worker, int id, const QString &error, const QStringList &names, const QList<QByteArray> &data) {
+
+    worker->assigned.removeOne(id);
+    if (worker->running == id)
+        worker->running = -1;
+
+    if (!jobs[id].done) {
+        // anybody else holding it can skip it.
+        for (Worker *other : workers) {
+            if (other->assigned.removeOne(id))
+                writeMessage(other->socket, message(MsgCancel, (qint32)id));
+        }
+        QStringList fzpzs;
+        finish(id, error != "" ? error : write(id, names, data, &fzpzs), fzpzs);
+    }
+
+    if (workers.contains(worker))
+        fill(worker);
+
+}
+
+// names come from the worker, so they have to be plain fzpz file names; where they go
+// is decided here. nothing is written unless all of them can be.
+QString DistBuildCoordinator::write (int id, const QStringList &names, const QList<QByteArray> &data, QStringList *fzpzs) {
+
+    const QString &script = jobs[id].result.script;
+    const QDir builddir = (options.outdir == "" ? QFileInfo(script).absoluteDir() : QDir(options.outdir));
+    if (names.size() != data.size())
+        return "worker sent an incomplete result";
+    for (const QString &name : names) {
+        if (QFileInfo(name).fileName() != name || name.contains('\\') || name.contains(':') ||
+            !name.endsWith(".fzpz", Qt::CaseInsensitive) || name.size() <= 5)
+            return QString("worker sent a bad file name: %1").arg(name);
+        const QString fzpz = builddir.absoluteFilePath(name);
+        if (fzpzs->contains(fzpz))
+            return QString("more than one part would be saved as %1").arg(fzpz);
+        if (written.contains(fzpz))
+            return QString("%1 was already built from %2").arg(fzpz, written[fzpz]);
+        fzpzs->append(fzpz);
+    }
+
+    for (int n = 0; n < fzpzs->size(); ++ n) {
+        try {
+            AtomicFile out((*fzpzs)[n], 0, options.sync);
+            if (out.file()->write(data[n]) != data[n].size())
+                throw std::runtime_error(out.file()->errorString().toStdString());
+            out.commit();
+            written.insert((*fzpzs)[n], script);
+        } catch (const std::exception &x) {
+            return QString("%1: %2").arg((*fzpzs)[n], x.what());
+        }
+    }
+    return QString();
+
+}
+
+void DistBuildCoordinator::finish (int id, const QString &error, const QStringList &fzpzs) {
+
+    Job &job = jobs[id];
+    if (job.done)
+        return;
+    job.done = true;
+    job.result.error = error;
+    job.result.fzpzs = (error == "" ? fzpzs : QStringList());
+    queue.removeOne(id);
+    -- remaining;
+
+    if (report)
+        report(job.result);
+    if (remaining == 0)
+        loop.quit();
+
+}
+
+void DistBuildCoordinator::lost (Worker *worker) {
+
+    if (!workers.removeOne(worker))
+        return;
+
+    // whatever it hadn't started goes back to the front of the queue; what it was
+    // building is retried, unless it's already taken down too many workers.
+    for (int n = worker->assigned.size() - 1; n >= 0; -- n) {
+        const int id = worker->assigned[n];
+        Job &job = jobs[id];
+        if (job.done)
+            continue;
+        if (id == worker->running && ++ job.attempts >= options.attempts) {
+            finish(id, QString("%1 after %2 attempt(s)").arg(job.timedout ? "timed out" : "crashed the worker").arg(job.attempts));
+            continue;
+        }
+        if (id == worker->running)
+            qDebug() << "distbuild: retrying" << job.result.script;
+        job.timedout = false;
+        queue.prepend(id);
+    }
+
+    worker->socket->deleteLater();
+    delete worker;
+
+    for (Worker *other : workers)
+        fill(other);
+    checkWorkers();
+
+}
+
+void DistBuildCoordinator::processExited (QProcess *process) {
+
+    if (starting.removeOne(process))
+        qWarning() << "distbuild: worker exited before connecting:" << process->errorString();
+    for (Worker *worker : workers) {
+        if (worker->process == process)
+            worker->process = nullptr; // its socket will go too
+    }
+    process->deleteLater();
+    checkWorkers();
+
+}
+
+// starts replacements for local workers that died, and gives up if nobody is left.
+void DistBuildCoordinator::checkWorkers () {
+
+    if (remaining == 0)
+        return;
+
+    int count = starting.size();
+    for (const Worker *worker : workers)
+        count += (worker->remote ? 0 : 1);
+    // bounded, in case workers die for reasons that have nothing to do with the scripts.
+    while (count < qMin(options.workers, remaining) && spawned < options.workers + jobs.size()) {
+        spawn();
+        ++ count;
+    }
+
+    if (workers.empty() && starting.empty() && !tcp) {
+        for (int id = 0; id < jobs.size(); ++ id)
+            finish(id, "no workers left");
+    }
+
+}
+
+void DistBuildCoordinator::checkTimeouts () {
+
+    const QList<Worker *> current = workers;
+    for (Worker *worker : current) {
+        if (!workers.contains(worker) || worker->running < 0 || worker->started.elapsed() < options.timeout * 1000LL)
+            continue;
+        qDebug() << "distbuild: timed out:" << jobs[worker->running].result.script;
+        jobs[worker->running].timedout = true;
+        if (worker->process)
+            worker->process->kill();
+        else if (QAbstractSocket *socket = qobject_cast<QAbstractSocket *>(worker->socket))
+            socket->abort();
+        else
+            worker->socket->close();
+    }
+
+}
+
+// ---- worker
+
+namespace {
+
+struct WorkerJob {
+    qint32 id;
+    QString script;
+    QByteArray text;
+    qint32 level;
+};
+
+// builds every part of one script into fzpz bytes. the names are bare file names; the
+// coordinator decides where they go, since this host's paths may not be its.
+QString buildJob (const WorkerJob &job, QStringList *names, QList<QByteArray> *data) {
+
+    try {
+        QByteArray text = job.text;
+        QBuffer in(&text);
+        in.open(QBuffer::ReadOnly);
+        PartCompiler compiler;
+        compiler.setScriptPath(job.script);
+        compiler.compileVariants(&in, [&](const PartVariant &variant) {
+            const PartFilenames filenames(variant.part.filename, QString());
+            if (names->contains(filenames.fzpz))
+                throw std::runtime_error(QString("more than one part would be saved as %1").arg(filenames.fzpz).toStdString());
+            const PartDocuments docs = generatePartDocuments(variant.part, filenames);
+            QBuffer zip;
+            zip.open(QBuffer::WriteOnly);
+            writeZipArchive(&zip, compressArchiveMembers(partArchiveMembers(docs, filenames), job.level));
+            names->append(filenames.fzpz);
+            data->append(zip.data());
+        });
+    } catch (const std::exception &x) {
+        names->clear();
+        data->clear();
+        return x.what();
+    }
+    return QString();
+
+}
+
+void flushSocket (QIODevice *socket) {
+    while (socket->bytesToWrite() > 0 && socket->waitForBytesWritten(30000))
+        ;
+}
+
+}
+
+int runBuildWorker (const QString &address) {
+
+    QScopedPointer<QIODevice> socket;
+    bool connected;
+    if (address.startsWith("local:")) {
+        QLocalSocket *s = new QLocalSocket;
+        socket.reset(s);
+        s->connectToServer(address.mid(6));
+        connected = s->waitForConnected(10000);
+    } else {
+        const int colon = address.lastIndexOf(':');
+        QTcpSocket *s = new QTcpSocket;
+        socket.reset(s);
+        if (colon > 0)
+            s->connectToHost(address.left(colon), address.mid(colon + 1).toUShort());
+        connected = (colon > 0 && s->waitForConnected(10000));
+    }
+    if (!connected) {
+        QTextStream(stderr) << "could not connect to " << address << ": " << socket->errorString() << "\n";
+        return 1;
+    }
+
+    writeMessage(socket.data(), message(MsgHello, ProtocolVersion, (qint64)QCoreApplication::applicationPid(), qgetenv(TokenVariable)));
+    flushSocket(socket.data());
+
+    // scripts are built one at a time; anything that arrives meanwhile (more scripts,
+    // cancellations) is picked up between them.
+    QDataStream in(socket.data());
+    in.setVersion(QDataStream::Qt_5_12);
+    QList<WorkerJob> queue;
+    while (true) {
+        if (queue.empty()) {
+            if (!socket->waitForReadyRead(-1))
+                return 0; // coordinator's gone
+        } else {
+            socket->waitForReadyRead(0);
+        }
+        QByteArray payload;
+        while (readMessage(in, &payload)) {
+            QDataStream msg(payload);
+            msg.setVersion(QDataStream::Qt_5_12);
+            quint8 type;
+            msg >> type;
+            if (type == MsgJob) {
+                WorkerJob job;
+                msg >> job.id >> job.script >> job.text >> job.level;
+                queue.append(job);
+            } else if (type == MsgCancel) {
+                qint32 id;
+                msg >> id;
+                for (int n = 0; n < queue.size(); ++ n)
+                    if (queue[n].id == id)
+                        queue.removeAt(n --);
+            } else if (type == MsgQuit) {
+                return 0;
+            }
+        }
+        if (queue.empty())
+            continue;
+        const WorkerJob job = queue.takeFirst();
+        writeMessage(socket.data(), message(MsgStarted, job.id));
+        flushSocket(socket.data());
+        QStringList names;
+        QList<QByteArray> data;
+        const QString error = buildJob(job, &names, &data);
+        writeMessage(socket.data(), message(MsgResult, job.id, error, names, data));
+        flushSocket(socket.data());
+    }
+
+}
@@ -0,0 +1,130 @@
+/*----------------------------------------------------------------------
+Fritzpart - Generates Fritzing parts from a part description script.
+Copyright (C) 2021, Jason Cipriani <jason.cipriani.dev@gmail.com>
+Not affiliated with Fritzing.
+
+This file is part of Fritzpart.
+
+Fritzpart is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+https://github.com/JC3/fritzpart
+----------------------------------------------------------------------*/
+
+
+#ifndef DISTBUILD_H
+#define DISTBUILD_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QHash>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QTimer>
+#include <functional>
+#include "zipwriter.h"
+
+class QIODevice;
+class QLocalServer;
+class QTcpServer;
+class QProcess;
+
+struct DistBuildResult {
+    QString script;
+    QStringList fzpzs;
+    QString error;
+};
+
+struct DistBuildOptions {
+    int workers;        // local worker processes to start
+    quint16 port;       // if set, workers on other hosts can connect on this tcp port
+    QString outdir;     // empty to put parts next to their scripts
+    int level;          // compression level
+    int timeout;        // seconds one script may take before its worker is killed, 0 for no limit
+    int attempts;       // workers a script may crash (or time out) before it's given up on
+    bool sync;          // flush parts to disk before renaming them into place
+    DistBuildOptions () : workers(0), port(0), level(ZipDefaultLevel), timeout(600), attempts(2), sync(false) { }
+};
+
+// builds scripts in separate worker processes (fritzpart --worker address), so a script
+// that crashes or hangs only takes its own worker down. local workers are started here
+// and talk over a local socket; workers on other hosts connect over tcp. each worker
+// is sent up to Prefetch scripts at a time, and when the queue runs dry an idle worker
+// steals a script another one hasn't started yet. if a worker dies, scripts it hadn't
+// started are requeued and the one it was building is retried elsewhere, up to
+// attempts times. workers send back bare fzpz names and bytes, and the parts are all
+// written here, next to the script or in outdir; a part that would overwrite one from
+// another script fails its script instead. workers have to say hello with the token in
+// $FRITZPART_WORKER_TOKEN, which --listen requires; local workers get a random one.
+// pin tables have to be reachable by the same paths on every host.
+class DistBuildCoordinator : public QObject {
+    Q_OBJECT
+public:
+    enum { Prefetch = 2 };
+    DistBuildCoordinator (const QStringList &scripts, const DistBuildOptions &options);
+    ~DistBuildCoordinator ();
+    // builds everything; finished is called with each script's result as it comes in.
+    QList<DistBuildResult> run (const std::function<void(const DistBuildResult &)> &finished);
+private:
+    struct Job {
+        DistBuildResult result;
+        int attempts;   // workers lost while building it
+        bool done;
+        bool timedout;
+    };
+    struct Worker {
+        QIODevice *socket;
+        QProcess *process;  // null for workers on other hosts
+        bool remote;
+        bool ready;          // said hello with the right token
+        QList<int> assigned; // sent to it, oldest first
+        int running;         // started by it, or -1
+        QElapsedTimer started;
+    };
+    void spawn ();
+    void accepted (QIODevice *socket, bool remote);
+    void readMessages (Worker *worker);
+    void handleMessage (Worker *worker, const QByteArray &payload);
+    void fill (Worker *worker);
+    void steal (Worker *thief);
+    void assign (Worker *worker, int job);
+    void complete (Worker *worker, int job, const QString &error, const QStringList &names, const QList<QByteArray> &data);
+    QString write (int job, const QStringList &names, const QList<QByteArray> &data, QStringList *fzpzs);
+    void finish (int job, const QString &error, const QStringList &fzpzs = QStringList());
+    void lost (Worker *worker);
+    void processExited (QProcess *process);
+    void checkTimeouts ();
+    void checkWorkers ();
+    QList<Job> jobs;
+    QList<int> queue;           // not assigned to anybody
+    QList<Worker *> workers;
+    QList<QProcess *> starting; // not connected yet
+    QHash<QString,QString> written; // fzpz -> script it was built from
+    DistBuildOptions options;
+    QByteArray token;
+    QLocalServer *local;
+    QTcpServer *tcp;
+    QEventLoop loop;
+    QTimer watchdog;
+    int remaining;
+    int spawned;
+    std::function<void(const DistBuildResult &)> report;
+};
+
+// worker mode: connects to the coordinator at address ("local:name" or "host:port")
+// and builds what it's sent until told to stop or the coordinator goes away.
+int runBuildWorker (const QString &address);
+
+#endif // DISTBUILD_H
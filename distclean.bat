@@ -28,3 +28,6 @@ del Makefile Makefile.* fritzpart_resource.rc
 del *.fzp *.fzpz *.svg *.fritzpart.bak
 del examples\*.fzpz examples\*.fritzpart.bak
 del dist\version.nsh
+del manual.html manual.idx
+del tools\helpgen\*.o tools\helpgen\*.obj
+del tools\helpgen\Makefile* tools\helpgen\helpgen.exe
@@ -0,0 +1,263 @@
+/*----------------------------------------------------------------------
+Fritzpart - Generates Fritzing parts from a part description script.
+Copyright (C) 2021, Jason Cipriani <jason.cipriani.dev@gmail.com>
+Not affiliated with Fritzing.
+
+This file is part of Fritzpart.
+
+Fritzpart is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+https://github.com/JC3/fritzpart
+----------------------------------------------------------------------*/
+
+#include "expression.h"
+#include <QVarLengthArray>
+#include <stdexcept>
+#include <cmath>
+
+namespace {
+
+struct Function {
+    const char *name;
+    int args;
+    double (*fn) (const double *);
+};
+
+const double Pi = 3.14159265358979323846;
+
+const Function functions[] = {
+    { "abs", 1, [](const double *a) { return fabs(a[0]); } },
+    { "sqrt", 1, [](const double *a) { return sqrt(a[0]); } },
+    { "floor", 1, [](const double *a) { return floor(a[0]); } },
+    { "ceil", 1, [](const double *a) { return ceil(a[0]); } },
+    { "round", 1, [](const double *a) { return round(a[0]); } },
+    { "sin", 1, [](const double *a) { return sin(a[0] * Pi / 180.0); } },
+    { "cos", 1, [](const double *a) { return cos(a[0] * Pi / 180.0); } },
+    { "tan", 1, [](const double *a) { return tan(a[0] * Pi / 180.0); } },
+    { "atan2", 2, [](const double *a) { return atan2(a[0], a[1]) * 180.0 / Pi; } },
+    { "min", 2, [](const double *a) { return qMin(a[0], a[1]); } },
+    { "max", 2, [](const double *a) { return qMax(a[0], a[1]); } },
+    { "pow", 2, [](const double *a) { return pow(a[0], a[1]); } }
+};
+
+const int nfunctions = sizeof(functions) / sizeof(functions[0]);
+
+int findFunction (const QString &name) {
+    for (int n = 0; n < nfunctions; ++ n)
+        if (name == functions[n].name)
+            return n;
+    return -1;
+}
+
+}
+
+// recursive descent, emitting postfix ops. each parse function leaves exactly one value
+// on the (compile time) stack, which lets constants be folded as we go.
+class ExpressionParser {
+public:
+    ExpressionParser (Expression &expr) : expr(expr), text(expr.source), pos(0), height(0) { }
+    void run () {
+        sum();
+        skipSpace();
+        if (pos < text.size())
+            fail(QString("unexpected '%1'").arg(text[pos]));
+    }
+private:
+    Expression &expr;
+    const QString &text;
+    int pos;
+    int height;
+    [[noreturn]] void fail (const QString &message) const {
+        throw std::runtime_error(QString("in expression '%1': %2").arg(text, message).toStdString());
+    }
+    void skipSpace () {
+        while (pos < text.size() && text[pos].isSpace())
+            ++ pos;
+    }
+    bool accept (QChar ch) {
+        skipSpace();
+        if (pos < text.size() && text[pos] == ch) {
+            ++ pos;
+            return true;
+        }
+        return false;
+    }
+    void push (double value) {
+        expr.program.append({ Expression::Push, 0, value });
+        expr.depth = qMax(expr.depth, ++ height);
+    }
+    bool constant (int back) const {
+        const int n = expr.program.size() - back;
+        return n >= 0 && expr.program[n].code == Expression::Push;
+    }
+    // emits op, which pops nargs values and pushes one; folded if all args are constant.
+    void emitOp (Expression::OpCode code, int nargs, int arg = 0) {
+        bool fold = true;
+        for (int n = 1; n <= nargs; ++ n)
+            fold = fold && constant(n);
+        expr.program.append({ code, arg, 0 });
+        height -= nargs - 1;
+        if (fold) {
+            Expression folded;
+            folded.program = expr.program.mid(expr.program.size() - nargs - 1);
+            folded.depth = nargs;
+            double value = folded.evaluate(Variables());
+            expr.program.resize(expr.program.size() - nargs - 1);
+            expr.program.append({ Expression::Push, 0, value });
+        }
+    }
+    void sum () {
+        product();
+        for (;;) {
+            if (accept('+')) { product(); emitOp(Expression::Add, 2); }
+            else if (accept('-')) { product(); emitOp(Expression::Sub, 2); }
+            else return;
+        }
+    }
+    void product () {
+        power();
+        for (;;) {
+            if (accept('*')) { power(); emitOp(Expression::Mul, 2); }
+            else if (accept('/')) { power(); emitOp(Expression::Div, 2); }
+            else if (accept('%')) { power(); emitOp(Expression::Mod, 2); }
+            else return;
+        }
+    }
+    void power () {
+        unary();
+        if (accept('^')) {
+            power(); // right associative
+            emitOp(Expression::Pow, 2);
+        }
+    }
+    void unary () {
+        if (accept('-')) {
+            unary();
+            emitOp(Expression::Neg, 1);
+        } else if (accept('+')) {
+            unary();
+        } else {
+            primary();
+        }
+    }
+    void primary () {
+        skipSpace();
+        if (accept('(')) {
+            sum();
+            if (!accept(')'))
+                fail("missing ')'");
+            return;
+        }
+        const int start = pos;
+        if (pos < text.size() && (text[pos].isLetter() || text[pos] == '_')) {
+            while (pos < text.size() && (text[pos].isLetterOrNumber() || text[pos] == '_'))
+                ++ pos;
+            const QString name = text.mid(start, pos - start);
+            if (accept('(')) {
+                const int fn = findFunction(name);
+                if (fn < 0)
+                    fail(QString("unknown function '%1'").arg(name));
+                int nargs = 0;
+                if (!accept(')')) {
+                    do {
+                        sum();
+                        ++ nargs;
+                    } while (accept(','));
+                    if (!accept(')'))
+                        fail("missing ')'");
+                }
+                if (nargs != functions[fn].args)
+                    fail(QString("%1() takes %2 argument(s)").arg(name).arg(functions[fn].args));
+                emitOp(Expression::Call, nargs, fn);
+            } else if (name == "pi") {
+                push(Pi);
+            } else {
+                int index = expr.names.indexOf(name);
+                if (index < 0) {
+                    index = expr.names.size();
+                    expr.names.append(name);
+                }
+                expr.program.append({ Expression::Load, index, 0 });
+                expr.depth = qMax(expr.depth, ++ height);
+            }
+            return;
+        }
+        while (pos < text.size() && (text[pos].isDigit() || text[pos] == '.'))
+            ++ pos;
+        if (pos > start && pos < text.size() && (text[pos] == 'e' || text[pos] == 'E')) {
+            ++ pos;
+            if (pos < text.size() && (text[pos] == '+' || text[pos] == '-'))
+                ++ pos;
+            while (pos < text.size() && text[pos].isDigit())
+                ++ pos;
+        }
+        bool ok;
+        const double value = text.mid(start, pos - start).toDouble(&ok);
+        if (!ok)
+            fail(pos < text.size() ? QString("unexpected '%1'").arg(text[pos]) : QString("unexpected end"));
+        push(value);
+    }
+};
+
+Expression::Expression (const QString &source) : source(source), depth(0) {
+    ExpressionParser(*this).run();
+    program.squeeze();
+}
+
+double Expression::evaluate (const Variables &vars, bool *usedvars) const {
+
+    if (usedvars)
+        *usedvars = !names.empty();
+
+    // variables are looked up once per evaluation, not once per use.
+    QVarLengthArray<double,8> values(names.size());
+    for (int n = 0; n < names.size(); ++ n) {
+        auto value = vars.constFind(names[n]);
+        if (value == vars.constEnd())
+            throw std::runtime_error(QString("in expression '%1': unknown variable '%2'").arg(source, names[n]).toStdString());
+        values[n] = value.value();
+    }
+
+    QVarLengthArray<double,16> stack(depth);
+    int top = 0;
+    for (const Op &op : program) {
+        switch (op.code) {
+        case Push: stack[top ++] = op.value; break;
+        case Load: stack[top ++] = values[op.arg]; break;
+        case Neg: stack[top - 1] = -stack[top - 1]; break;
+        case Add: -- top; stack[top - 1] += stack[top]; break;
+        case Sub: -- top; stack[top - 1] -= stack[top]; break;
+        case Mul: -- top; stack[top - 1] *= stack[top]; break;
+        case Div: -- top; stack[top - 1] /= stack[top]; break;
+        case Mod: -- top; stack[top - 1] = fmod(stack[top - 1], stack[top]); break;
+        case Pow: -- top; stack[top - 1] = pow(stack[top - 1], stack[top]); break;
+        case Call:
+            top -= functions[op.arg].args;
+            stack[top] = functions[op.arg].fn(&stack[top]);
+            ++ top;
+            break;
+        }
+    }
+
+    return top ? stack[0] : 0;
+
+}
+
+bool Expression::isReservedName (const QString &name) {
+    return name == "pi" || findFunction(name) >= 0;
+}
+
+double evaluateExpression (const QString &expr, const Variables &vars) {
+    return Expression(expr).evaluate(vars);
+}
@@ -0,0 +1,63 @@
+/*----------------------------------------------------------------------
+Fritzpart - Generates Fritzing parts from a part description script.
+Copyright (C) 2021, Jason Cipriani <jason.cipriani.dev@gmail.com>
+Not affiliated with Fritzing.
+
+This file is part of Fritzpart.
+
+Fritzpart is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+https://github.com/JC3/fritzpart
+----------------------------------------------------------------------*/
+
+#ifndef EXPRESSION_H
+#define EXPRESSION_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QMap>
+
+typedef QMap<QString,double> Variables;
+
+// an arithmetic expression, compiled once into a little postfix program so that it can
+// be evaluated over and over (e.g. with different variable values) without parsing it
+// again. supports numbers, variables, + - * / % ^, unary minus, parentheses, pi, and the
+// functions in the table in expression.cpp (trig functions work in degrees). constant
+// subexpressions are folded at compile time. throws std::runtime_error on syntax
+// errors, and on unknown variables when evaluating.
+class Expression {
+public:
+    Expression () : depth(0) { }
+    explicit Expression (const QString &source);
+    double evaluate (const Variables &vars, bool *usedvars = nullptr) const;
+    bool isConstant () const { return names.empty(); }
+    static bool isReservedName (const QString &name);
+private:
+    enum OpCode { Push, Load, Neg, Add, Sub, Mul, Div, Mod, Pow, Call };
+    struct Op {
+        OpCode code;
+        int arg;      // Load: index into names, Call: index into function table
+        double value; // Push
+    };
+    friend class ExpressionParser;
+    QString source;
+    QVector<Op> program;
+    QStringList names;
+    int depth;        // stack size needed
+};
+
+double evaluateExpression (const QString &expr, const Variables &vars);
+
+#endif // EXPRESSION_H
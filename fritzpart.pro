@@ -23,20 +23,67 @@
 
 VERSION = 0.9.1.0
 
-QT       += core gui xml svg widgets
+QT       += core gui xml svg widgets concurrent network
+
+# for QZipReader / QZipWriter
+QT       += gui-private
 
 CONFIG += c++17
 
 SOURCES += \
+    atomicfile.cpp \
+    bundle.cpp \
+    cli.cpp \
+    distbuild.cpp \
+    expression.cpp \
+    fzpimporter.cpp \
+    gallerywindow.cpp \
     helpwindow.cpp \
+    kicadimporter.cpp \
+    libraryindex.cpp \
     main.cpp \
-    mainwindow.cpp
+    mainwindow.cpp \
+    memstats.cpp \
+    partcompiler.cpp \
+    partgen.cpp \
+    partscript.cpp \
+    partsnapshot.cpp \
+    partverifier.cpp \
+    pintable.cpp \
+    previewview.cpp \
+    rectindex.cpp \
+    startuptrace.cpp \
+    thumbnails.cpp \
+    zipwriter.cpp
 
 HEADERS += \
+    atomicfile.h \
+    bundle.h \
+    cli.h \
+    distbuild.h \
+    expression.h \
+    fzpimporter.h \
+    gallerywindow.h \
     helpwindow.h \
-    mainwindow.h
+    kicadimporter.h \
+    libraryindex.h \
+    mainwindow.h \
+    memstats.h \
+    part.h \
+    partcompiler.h \
+    partgen.h \
+    partscript.h \
+    partsnapshot.h \
+    partverifier.h \
+    pintable.h \
+    previewview.h \
+    rectindex.h \
+    startuptrace.h \
+    thumbnails.h \
+    zipwriter.h
 
 FORMS += \
+    gallerywindow.ui \
     helpwindow.ui \
     mainwindow.ui
 
@@ -48,7 +95,9 @@ DISTFILES += \
     dist/makedist.bat \
     distclean.bat \
     examples/test.txt \
-    manual.css
+    manual.css \
+    tools/helpgen/helpgen.cpp \
+    tools/helpgen/helpgen.pro
 
 RESOURCES += \
     fritzpart.qrc
@@ -65,6 +114,23 @@ nsiversion.commands = echo "!define PRODUCT_VERSION \"$$VERSION\"" > $$nsiversio
 QMAKE_EXTRA_TARGETS += nsiversion
 PRE_TARGETDEPS += $$nsiversion.target
 
+# the help window's html and directive index are rendered from README.md at build
+# time by tools/helpgen, which is built first with the same qmake. they land in the
+# source dir next to fritzpart.qrc so rcc can find them, and rcc waits for them: the
+# qrc's own dependency list is taken when qmake runs, before they exist.
+win32: HELPGEN = tools/helpgen/helpgen.exe
+else: HELPGEN = tools/helpgen/helpgen
+helpgen.target = $$HELPGEN
+helpgen.depends = $$PWD/tools/helpgen/helpgen.cpp $$PWD/tools/helpgen/helpgen.pro
+helpgen.commands = $$QMAKE_QMAKE -o tools/helpgen/Makefile $$PWD/tools/helpgen/helpgen.pro && cd $$shell_path(tools/helpgen) && $(MAKE)
+helphtml.target = $$PWD/manual.html
+helphtml.depends = $$HELPGEN $$PWD/README.md
+helphtml.commands = $$shell_path($$HELPGEN) $$PWD/README.md $$PWD/manual.html $$PWD/manual.idx
+QMAKE_EXTRA_TARGETS += helpgen helphtml
+PRE_TARGETDEPS += $$helphtml.target
+rcc.depends += $$helphtml.target
+QMAKE_CLEAN += $$PWD/manual.html $$PWD/manual.idx
+
 win32:RC_ICONS = contrib/ic.ico
 
 # Default rules for deployment.
@@ -0,0 +1,402 @@
+/*----------------------------------------------------------------------
+Fritzpart - Generates Fritzing parts from a part description script.
+Copyright (C) 2021, Jason Cipriani <jason.cipriani.dev@gmail.com>
+Not affiliated with Fritzing.
+
+This file is part of Fritzpart.
+
+Fritzpart is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+https://github.com/JC3/fritzpart
+----------------------------------------------------------------------*/
+
+#include "fzpimporter.h"
+#include <QtGui/private/qzipreader_p.h>
+#include <QXmlStreamReader>
+#include <QTransform>
+#include <QRegularExpression>
+#include <QBuffer>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QHash>
+#include <QSet>
+#include <QStack>
+#include <memory>
+#include <stdexcept>
+#include <cmath>
+
+namespace {
+
+// gets at the fzp and svgs whether they're in an fzpz or loose on disk.
+class PartFiles {
+public:
+    explicit PartFiles (const QString &filename) : info(filename) {
+        if (info.suffix().compare("fzpz", Qt::CaseInsensitive) == 0) {
+            zip.reset(new QZipReader(filename));
+            if (!zip->isReadable() || zip->status() != QZipReader::NoError)
+                throw std::runtime_error("could not open archive");
+            for (const QZipReader::FileInfo &file : zip->fileInfoList())
+                if (file.filePath.endsWith(".fzp", Qt::CaseInsensitive))
+                    fzpname = file.filePath;
+            if (fzpname == "")
+                throw std::runtime_error("no fzp in archive");
+        }
+    }
+    QByteArray fzp () const {
+        if (zip)
+            return zip->fileData(fzpname);
+        QFile file(info.filePath());
+        if (!file.open(QFile::ReadOnly))
+            throw std::runtime_error(file.errorString().toStdString());
+        return file.readAll();
+    }
+    // image is an fzp layers image path, e.g. "pcb/foo.svg". returns null if not found.
+    QIODevice * open (const QString &image) const {
+        const QString flat = "svg." + QString(image).replace('/', '.');
+        if (zip) {
+            QBuffer *buffer = new QBuffer();
+            buffer->setData(zip->fileData(flat));
+            buffer->open(QIODevice::ReadOnly);
+            if (buffer->size() == 0) {
+                delete buffer;
+                return nullptr;
+            }
+            return buffer;
+        }
+        // fritzing-parts layout (core/foo.fzp, svg/core/pcb/foo.svg), or next to the fzp.
+        const QDir dir = info.absoluteDir();
+        const QStringList candidates = {
+            dir.absoluteFilePath(QString("../svg/%1/%2").arg(dir.dirName(), image)),
+            dir.absoluteFilePath(image),
+            dir.absoluteFilePath(flat)
+        };
+        for (const QString &candidate : candidates) {
+            std::unique_ptr<QFile> file(new QFile(candidate));
+            if (file->open(QFile::ReadOnly))
+                return file.release();
+        }
+        return nullptr;
+    }
+private:
+    QFileInfo info;
+    std::unique_ptr<QZipReader> zip;
+    QString fzpname;
+};
+
+struct FzpConnectors {
+    QString pcbimage;
+    QHash<QString,int> padids;   // pcb svg element id -> pin number
+    QHash<int,QString> names;    // pin number -> name
+};
+
+}
+
+static double lengthToInches (double value, const QString &units) {
+    double perinch = unitsPerInch(units);
+    return value / (perinch > 0 ? perinch : 90);
+}
+
+static bool parseLength (const QString &str, double *value, QString *units) {
+    static const QRegularExpression re("^\\s*([-+0-9.eE]+)\\s*([a-zA-Z]*)\\s*$");
+    QRegularExpressionMatch m = re.match(str);
+    if (!m.hasMatch())
+        return false;
+    bool ok;
+    *value = m.captured(1).toDouble(&ok);
+    *units = m.captured(2).toLower();
+    return ok;
+}
+
+static QTransform parseTransform (const QString &attr) {
+    static const QRegularExpression re("(matrix|translate|scale|rotate)\\s*\\(([^)]*)\\)");
+    static const QRegularExpression sep("[\\s,]+");
+    QTransform result;
+    QRegularExpressionMatchIterator it = re.globalMatch(attr);
+    while (it.hasNext()) {
+        QRegularExpressionMatch m = it.next();
+        QVector<double> a;
+        for (const QString &s : m.captured(2).split(sep, Qt::SkipEmptyParts))
+            a.append(s.toDouble());
+        QTransform t;
+        const QString op = m.captured(1);
+        if (op == "matrix" && a.size() == 6)
+            t = QTransform(a[0], a[1], a[2], a[3], a[4], a[5]);
+        else if (op == "translate" && a.size() >= 1)
+            t.translate(a[0], a.value(1));
+        else if (op == "scale" && a.size() >= 1)
+            t.scale(a[0], a.size() > 1 ? a[1] : a[0]);
+        else if (op == "rotate" && a.size() >= 3)
+            t.translate(a[1], a[2]).rotate(a[0]).translate(-a[1], -a[2]);
+        else if (op == "rotate" && a.size() >= 1)
+            t.rotate(a[0]);
+        // svg applies the rightmost transform first.
+        result = t * result;
+    }
+    return result;
+}
+
+// looks in the attribute first, then in the style attribute.
+static QString styleString (const QXmlStreamAttributes &attrs, const QString &name, const QString &def) {
+    if (attrs.hasAttribute(name))
+        return attrs.value(name).toString().trimmed();
+    for (const QString &decl : attrs.value("style").toString().split(';')) {
+        const int colon = decl.indexOf(':');
+        if (colon > 0 && decl.left(colon).trimmed() == name)
+            return decl.mid(colon + 1).trimmed();
+    }
+    return def;
+}
+
+static double styleValue (const QXmlStreamAttributes &attrs, const QString &name, double def) {
+    const QString value = styleString(attrs, name, QString());
+    return value.isNull() ? def : value.toDouble();
+}
+
+static FzpConnectors readFzp (const QByteArray &data, Part &part) {
+
+    FzpConnectors conns;
+    QXmlStreamReader xml(data);
+    QStringList path;
+    int number = 0;
+    static const QRegularExpression connid("^connector(\\d+)$");
+    static const QStringList simple = { "version", "author", "title", "label", "description", "url" };
+
+    part.metatags.clear();
+
+    while (!xml.atEnd()) {
+        QXmlStreamReader::TokenType token = xml.readNext();
+        if (token == QXmlStreamReader::StartElement) {
+            const QString name = xml.name().toString();
+            const QXmlStreamAttributes attrs = xml.attributes();
+            const bool inconnector = path.contains("connector");
+            // the readElementText() ones consume their own end element, so don't push them.
+            if (path == QStringList({ "module" }) && simple.contains(name)) {
+                part.metadata[(MetaKey)Metadata::keyOf(name)] = xml.readElementText(QXmlStreamReader::IncludeChildElements).trimmed();
+                continue;
+            } else if (name == "tag" && !path.empty() && path.last() == "tags") {
+                QString tag = xml.readElementText().trimmed();
+                if (tag != "" && !part.metatags.contains(tag))
+                    part.metatags.append(tag);
+                continue;
+            } else if (name == "property" && !path.empty() && path.last() == "properties") {
+                const QString key = attrs.value("name").toString();
+                const QString value = xml.readElementText().trimmed();
+                if (!key.compare("family", Qt::CaseInsensitive))
+                    part.metadata[MetaFamily] = value;
+                else if (!key.compare("variant", Qt::CaseInsensitive))
+                    part.metadata[MetaVariant] = value;
+                else if (!key.compare("part number", Qt::CaseInsensitive))
+                    part.metadata[MetaPartNumber] = value;
+                else if (key != "")
+                    part.metaprops[key] = value;
+                continue;
+            }
+            if (name == "module" && path.empty()) {
+                part.metadata[MetaModuleId] = attrs.value("moduleId").toString();
+            } else if (name == "connector") {
+                QRegularExpressionMatch m = connid.match(attrs.value("id").toString());
+                number = m.hasMatch() ? m.captured(1).toInt() + 1 : conns.names.size() + 1;
+                conns.names[number] = attrs.value("name").toString();
+            } else if (inconnector && name == "p" && !path.empty() && path.last() == "pcbView") {
+                conns.padids[attrs.value("svgId").toString()] = number;
+            } else if (!inconnector && name == "layers" && !path.empty() && path.last() == "pcbView") {
+                conns.pcbimage = attrs.value("image").toString();
+            }
+            path.append(name);
+        } else if (token == QXmlStreamReader::EndElement) {
+            path.removeLast();
+        }
+    }
+
+    if (xml.hasError())
+        throw std::runtime_error(QString("fzp: %1").arg(xml.errorString()).toStdString());
+
+    return conns;
+
+}
+
+static void readPcb (QIODevice *svg, const FzpConnectors &conns, Part &part, QStringList &warnings) {
+
+    struct Frame { QTransform ctm; bool silk; };
+    struct Pad { int number; int depth; bool circle, rect; double x, y, r, sw; };
+
+    QXmlStreamReader xml(svg);
+    QStack<Frame> stack;
+    Pad pad = { -1, 0, false, false, 0, 0, 0, 0 };
+    QSet<int> seen;
+    bool gotstroke = false;
+    int skipped = 0;
+
+    while (!xml.atEnd()) {
+
+        QXmlStreamReader::TokenType token = xml.readNext();
+
+        if (token == QXmlStreamReader::EndElement) {
+            if (pad.number > 0 && stack.size() == pad.depth) {
+                if (pad.circle && 2.0 * pad.r - pad.sw > 0) {
+                    Pin pin;
+                    pin.number = pad.number;
+                    pin.name = conns.names.value(pad.number);
+                    pin.x = pad.x;
+                    pin.y = pad.y;
+                    pin.ring = pad.sw;
+                    pin.hole = 2.0 * pad.r - pad.sw;
+                    pin.square = pad.rect;
+                    pin.origleft = pin.origtop = true;
+                    part.pins.append(pin);
+                } else {
+                    warnings.append(QString("connector%1: pad is not a through-hole pad, skipped").arg(pad.number - 1));
+                }
+                seen.insert(pad.number);
+                pad.number = -1;
+            }
+            stack.pop();
+            continue;
+        } else if (token != QXmlStreamReader::StartElement) {
+            continue;
+        }
+
+        const QString name = xml.name().toString();
+        const QXmlStreamAttributes attrs = xml.attributes();
+        const QString id = attrs.value("id").toString();
+        auto attr = [&](const char *a) { return attrs.value(a).toDouble(); };
+
+        Frame frame = stack.empty() ? Frame{ QTransform(), false } : stack.top();
+
+        if (stack.empty()) {
+            // root: figure out units, and the scale from the viewbox to those units.
+            double w = 0, h = 0;
+            QString wunits, hunits;
+            if (!parseLength(attrs.value("width").toString(), &w, &wunits) ||
+                    !parseLength(attrs.value("height").toString(), &h, &hunits))
+                throw std::runtime_error("pcb svg: missing or unsupported width/height");
+            QStringList vb = attrs.value("viewBox").toString().split(QRegularExpression("[\\s,]+"), Qt::SkipEmptyParts);
+            if (wunits != hunits || wunits == "" || wunits == "px") {
+                // no usable physical units; assume 90 dpi the way fritzing does.
+                w = lengthToInches(w, wunits);
+                h = lengthToInches(h, hunits);
+                wunits = "in";
+            }
+            part.units = wunits;
+            part.width = w;
+            part.height = h;
+            if (vb.size() == 4 && vb[2].toDouble() > 0 && vb[3].toDouble() > 0)
+                frame.ctm = QTransform::fromTranslate(-vb[0].toDouble(), -vb[1].toDouble()) *
+                            QTransform::fromScale(w / vb[2].toDouble(), h / vb[3].toDouble());
+            else
+                frame.ctm = QTransform::fromScale(1.0 / 90.0, 1.0 / 90.0);
+        }
+
+        frame.ctm = parseTransform(attrs.value("transform").toString()) * frame.ctm;
+        if (id.startsWith("silkscreen"))
+            frame.silk = true;
+        stack.push(frame);
+
+        const double scale = sqrt(fabs(frame.ctm.determinant()));
+        const double sw = styleValue(attrs, "stroke-width", 0) * scale;
+        const int padnumber = conns.padids.value(id, 0);
+
+        if (pad.number < 0 && padnumber > 0 && !seen.contains(padnumber))
+            pad = { padnumber, stack.size(), false, false, 0, 0, 0, 0 };
+
+        if (pad.number > 0) {
+            if (name == "circle" && !pad.circle) {
+                QPointF c = frame.ctm.map(QPointF(attr("cx"), attr("cy")));
+                pad.circle = true;
+                pad.x = c.x();
+                pad.y = c.y();
+                pad.r = attr("r") * scale;
+                pad.sw = sw;
+            } else if (name == "rect") {
+                pad.rect = true;
+            }
+        } else if (id.startsWith("nonconn") && name == "circle") {
+            QPointF c = frame.ctm.map(QPointF(attr("cx"), attr("cy")));
+            Hole hole;
+            hole.x = c.x();
+            hole.y = c.y();
+            hole.diameter = 2.0 * attr("r") * scale;
+            hole.origleft = hole.origtop = true;
+            part.pcbholes.append(hole);
+        } else if (frame.silk && name == "rect" && id == "outline") {
+            part.outline = sw;
+        } else if (frame.silk && (name == "line" || name == "circle" || name == "rect")) {
+            if (!gotstroke) {
+                part.pcbmarkstroke = sw;
+                gotstroke = true;
+            }
+            if (name == "line") {
+                QPointF a = frame.ctm.map(QPointF(attr("x1"), attr("y1")));
+                QPointF b = frame.ctm.map(QPointF(attr("x2"), attr("y2")));
+                Marking mark = Marking::makeLine(a.x(), a.y(), b.x(), b.y(), true, true);
+                mark.capped = (styleString(attrs, "stroke-linecap", "butt") == "round");
+                part.pcbmarks.append(mark);
+            } else if (name == "circle") {
+                QPointF c = frame.ctm.map(QPointF(attr("cx"), attr("cy")));
+                part.pcbmarks.append(Marking::makeCircle(c.x(), c.y(), 2.0 * attr("r") * scale + sw, true, true));
+            } else {
+                QPolygonF r = frame.ctm.map(QPolygonF(QRectF(attr("x"), attr("y"), attr("width"), attr("height"))));
+                for (int n = 0; n < 4; ++ n)
+                    part.pcbmarks.append(Marking::makeLine(r[n].x(), r[n].y(), r[n+1].x(), r[n+1].y(), true, true));
+            }
+        } else if (frame.silk && name != "g") {
+            ++ skipped;
+        }
+
+    }
+
+    if (xml.hasError())
+        throw std::runtime_error(QString("pcb svg: %1").arg(xml.errorString()).toStdString());
+
+    if (skipped)
+        warnings.append(QString("%1 silkscreen element(s) other than lines, circles and rectangles were skipped").arg(skipped));
+    for (auto name = conns.names.cbegin(); name != conns.names.cend(); ++ name)
+        if (!seen.contains(name.key()))
+            warnings.append(QString("connector%1: no pad found in pcb svg").arg(name.key() - 1));
+
+}
+
+Part importFritzingPart (const QString &filename, QStringList *warnings) {
+
+    QStringList ignored;
+    if (!warnings)
+        warnings = &ignored;
+
+    PartFiles files(filename);
+    Part part;
+    part.filename = QFileInfo(filename).completeBaseName();
+
+    FzpConnectors conns = readFzp(files.fzp(), part);
+    if (conns.pcbimage == "")
+        throw std::runtime_error("fzp has no pcb view");
+
+    std::unique_ptr<QIODevice> svg(files.open(conns.pcbimage));
+    if (!svg)
+        throw std::runtime_error(QString("pcb image %1 not found").arg(conns.pcbimage).toStdString());
+    readPcb(svg.get(), conns, part, *warnings);
+
+    // scripts number pins in order, so there's no way to say "connector5" without
+    // connectors 0-4 existing.
+    std::sort(part.pins.begin(), part.pins.end(), pinNumberLess);
+    for (int n = 0; n < part.pins.size(); ++ n) {
+        if (part.pins[n].number != n + 1) {
+            warnings->append("connector ids are not contiguous; pins will be renumbered");
+            break;
+        }
+    }
+
+    return part;
+
+}
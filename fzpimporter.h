@@ -0,0 +1,38 @@
+/*----------------------------------------------------------------------
+Fritzpart - Generates Fritzing parts from a part description script.
+Copyright (C) 2021, Jason Cipriani <jason.cipriani.dev@gmail.com>
+Not affiliated with Fritzing.
+
+This file is part of Fritzpart.
+
+Fritzpart is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+https://github.com/JC3/fritzpart
+----------------------------------------------------------------------*/
+
+#ifndef FZPIMPORTER_H
+#define FZPIMPORTER_H
+
+#include <QString>
+#include <QStringList>
+#include "part.h"
+
+// reads an existing fritzing part (a .fzpz, or a loose .fzp with its svgs in the usual
+// fritzing folder layout) back into a Part: metadata from the fzp, and pads, holes,
+// outline and silkscreen from the pcb svg. anything that doesn't map onto a script
+// directive (smd pads, paths, ...) is skipped and mentioned in warnings. throws
+// std::runtime_error if the part can't be read at all.
+Part importFritzingPart (const QString &filename, QStringList *warnings = nullptr);
+
+#endif // FZPIMPORTER_H
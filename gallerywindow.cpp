@@ -0,0 +1,122 @@
+/*----------------------------------------------------------------------
+Fritzpart - Generates Fritzing parts from a part description script.
+Copyright (C) 2021, Jason Cipriani <jason.cipriani.dev@gmail.com>
+Not affiliated with Fritzing.
+
+This file is part of Fritzpart.
+
+Fritzpart is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+https://github.com/JC3/fritzpart
+----------------------------------------------------------------------*/
+
+
+#include "gallerywindow.h"
+#include "ui_gallerywindow.h"
+#include "cli.h"
+#include "partcompiler.h"
+#include <QtConcurrent>
+#include <QDir>
+#include <QFileInfo>
+#include <QStyle>
+#include <functional>
+
+GalleryWindow::GalleryWindow (QWidget *parent) :
+    QDialog(parent, Qt::WindowTitleHint | Qt::WindowSystemMenuHint | Qt::WindowMinMaxButtonsHint | Qt::WindowCloseButtonHint),
+    ui(new Ui::GalleryWindow),
+    ready(0),
+    cached(0),
+    failed(0)
+{
+    ui->setupUi(this);
+    ui->parts->setIconSize(QSize(ThumbnailWidth, ThumbnailHeight));
+    connect(&thumbnails, &QFutureWatcher<Thumbnail>::resultReadyAt, this, &GalleryWindow::thumbnailReady);
+    connect(&thumbnails, &QFutureWatcher<Thumbnail>::finished, this, &GalleryWindow::thumbnailsFinished);
+    connect(ui->parts, &QListWidget::itemClicked, this, &GalleryWindow::itemClicked);
+}
+
+GalleryWindow::~GalleryWindow () {
+    thumbnails.cancel();
+    thumbnails.waitForFinished();
+    delete ui;
+}
+
+void GalleryWindow::setDirectory (const QString &dir) {
+
+    thumbnails.cancel();
+    thumbnails.waitForFinished();
+
+    this->dir = QDir(dir).absolutePath();
+    ready = cached = failed = 0;
+    ui->parts->clear();
+
+    QStringList scripts = PartCompiler::withoutPinTables(findFiles({ this->dir }, { "*.txt" }));
+    scripts.sort();
+    QPixmap blank(ThumbnailWidth, ThumbnailHeight);
+    blank.fill(Qt::transparent);
+    for (const QString &script : scripts) {
+        QListWidgetItem *item = new QListWidgetItem(QIcon(blank), QFileInfo(script).completeBaseName(), ui->parts);
+        item->setData(Qt::UserRole, script);
+        item->setToolTip(QDir(this->dir).relativeFilePath(script));
+    }
+
+    setWindowTitle(QString("Part Gallery - %1").arg(QDir::toNativeSeparators(this->dir)));
+    updateStatus();
+
+    const QString cachedir = thumbnailCacheDir();
+    std::function<Thumbnail(const QString &)> make = [cachedir](const QString &script) {
+        return partThumbnail(script, cachedir);
+    };
+    thumbnails.setFuture(QtConcurrent::mapped(scripts, make));
+
+}
+
+void GalleryWindow::thumbnailReady (int index) {
+    const Thumbnail thumb = thumbnails.resultAt(index);
+    QListWidgetItem *item = ui->parts->item(index);
+    if (!item)
+        return;
+    ++ ready;
+    if (thumb.cached)
+        ++ cached;
+    if (thumb.image.isNull()) {
+        ++ failed;
+        item->setIcon(style()->standardIcon(QStyle::SP_MessageBoxWarning));
+        item->setToolTip(QString("%1\n%2").arg(item->toolTip(), thumb.error));
+    } else {
+        item->setIcon(QIcon(QPixmap::fromImage(thumb.image)));
+    }
+    updateStatus();
+}
+
+void GalleryWindow::thumbnailsFinished () {
+    updateStatus();
+}
+
+void GalleryWindow::updateStatus () {
+    QString status = QString("%1 of %2 parts (%3 from cache)").arg(ready).arg(ui->parts->count()).arg(cached);
+    if (failed)
+        status += QString(", %1 failed to compile").arg(failed);
+    ui->status->setText(status + ".");
+}
+
+void GalleryWindow::itemClicked (QListWidgetItem *item) {
+    emit scriptClicked(item->data(Qt::UserRole).toString());
+}
+
+void GalleryWindow::display () {
+    showNormal();
+    activateWindow();
+    raise();
+}
@@ -0,0 +1,65 @@
+/*----------------------------------------------------------------------
+Fritzpart - Generates Fritzing parts from a part description script.
+Copyright (C) 2021, Jason Cipriani <jason.cipriani.dev@gmail.com>
+Not affiliated with Fritzing.
+
+This file is part of Fritzpart.
+
+Fritzpart is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+https://github.com/JC3/fritzpart
+----------------------------------------------------------------------*/
+
+
+#ifndef GALLERYWINDOW_H
+#define GALLERYWINDOW_H
+
+#include <QDialog>
+#include <QFutureWatcher>
+#include "thumbnails.h"
+
+namespace Ui {
+class GalleryWindow;
+}
+
+class QListWidgetItem;
+
+// thumbnails of every part script under a directory. thumbnails are made on the thread
+// pool (or come straight out of the cache) and show up as they're ready. clicking one
+// asks for the script to be opened.
+class GalleryWindow : public QDialog {
+    Q_OBJECT
+public:
+    explicit GalleryWindow (QWidget *parent = nullptr);
+    ~GalleryWindow ();
+    void setDirectory (const QString &dir);
+public slots:
+    void display ();
+signals:
+    void scriptClicked (const QString &filename);
+private slots:
+    void thumbnailReady (int index);
+    void thumbnailsFinished ();
+    void itemClicked (QListWidgetItem *item);
+private:
+    Ui::GalleryWindow *ui;
+    QFutureWatcher<Thumbnail> thumbnails;
+    QString dir;
+    int ready;
+    int cached;
+    int failed;
+    void updateStatus ();
+};
+
+#endif // GALLERYWINDOW_H
@@ -1,7 +1,8 @@
 #include "helpwindow.h"
 #include "ui_helpwindow.h"
 #include <QResource>
-#include <QDomDocument>
+#include <QCompleter>
+#include <QTextCursor>
 
 HelpWindow::HelpWindow(QWidget *parent) :
     QDialog(parent, Qt::WindowTitleHint | Qt::WindowSystemMenuHint | Qt::WindowMinMaxButtonsHint | Qt::WindowCloseButtonHint),
@@ -9,55 +10,26 @@ HelpWindow::HelpWindow(QWidget *parent) :
 {
     ui->setupUi(this);
 
+    // the html and the directive index are generated from README.md at build time
+    // by tools/helpgen, so all that's left to do here is show it.
     auto content = ui->content;
-    content->setMarkdown(QString::fromLatin1(QResource(":/help/manual").uncompressedData()));
-
-    // === begin nightmare of forcing qt5 to style markdown sanely ===
-
-    QDomDocument doc;
-    doc.setContent(content->toHtml());
+    content->document()->setDefaultStyleSheet(QString::fromLatin1(QResource(":/help/manual.css").uncompressedData()));
+    content->setHtml(QString::fromUtf8(QResource(":/help/manual").uncompressedData()));
 
-    QStringList keepers = { "font-family", "font-weight", "font-style", "vertical-align" };
-    for (QList<QDomElement> els = { doc.documentElement() }; !els.empty(); ) {
-        QDomElement el = els.front();
-        els.pop_front();
-        // all of these make things get weird. remove them.
-        if (el.tagName() == "br" || el.tagName() == "style" || el.tagName() == "meta") {
-            el.parentNode().removeChild(el);
-            continue;
-        }
-        // traverse.
-        for (auto ec = el.firstChildElement(); !ec.isNull(); ec = ec.nextSiblingElement())
-            els.append(ec);
-        // discard unwanted style attribute values.
-        QStringList sts = el.attribute("style").split(";"), stk;
-        for (auto st : sts)
-            if (keepers.contains(st.split(":")[0].trimmed()))
-                stk.append(st.trimmed());
-        if (stk.empty() || el.tagName() == "body")
-            el.removeAttribute("style");
-        else
-            el.setAttribute("style", stk.join("; "));
-        // dom manipulations to make code blocks look less shit.
-        if (el.tagName() == "span" &&
-                el.attribute("style").contains("font-family") &&
-                el.parentNode().toElement().tagName() == "p" &&
-                el.parentNode().toElement().text().trimmed() == el.text().trimmed())
-            el.parentNode().toElement().setAttribute("class", "code");
-        if (el.tagName() == "p" &&
-                el.attribute("style").contains("font-family") &&
-                el.text() == "")
-        {
-            el.setAttribute("class", "code");
-            el.appendChild(doc.createEntityReference("nbsp"));
+    QStringList names;
+    for (QString line : QString::fromUtf8(QResource(":/help/index").uncompressedData()).split('\n', Qt::SkipEmptyParts)) {
+        QStringList fields = line.split('\t');
+        if (fields.size() == 3) {
+            keywords[fields[0]] = { fields[1], fields[2] };
+            names.append(fields[0]);
         }
     }
 
-    // right.
-    content->document()->setDefaultStyleSheet(QString::fromLatin1(QResource(":/help/manual.css").uncompressedData()));
-    content->setHtml(doc.toString());
-
-    // === end nightmare (sort of) ===
+    QCompleter *completer = new QCompleter(names, this);
+    completer->setCaseSensitivity(Qt::CaseInsensitive);
+    ui->search->setCompleter(completer);
+    connect(completer, QOverload<const QString &>::of(&QCompleter::activated), this, &HelpWindow::search);
+    connect(ui->search, &QLineEdit::returnPressed, [this] () { search(ui->search->text()); });
 
 }
 
@@ -79,3 +51,22 @@ void HelpWindow::display () {
     activateWindow();
     raise();
 }
+
+// jumps to a directive's row in the table, or else to the next occurrence of the text.
+void HelpWindow::search (const QString &text) {
+    QString key = text.trimmed().toLower();
+    if (key == "")
+        return;
+    auto keyword = keywords.find(key);
+    if (keyword != keywords.end()) {
+        ui->content->scrollToAnchor(keyword->anchor);
+        ui->search->setToolTip(keyword->description);
+        return;
+    }
+    ui->search->setToolTip(QString());
+    if (!ui->content->find(key)) {
+        // wrap around.
+        ui->content->moveCursor(QTextCursor::Start);
+        ui->content->find(key);
+    }
+}
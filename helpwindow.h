@@ -2,6 +2,7 @@
 #define HELPWINDOW_H
 
 #include <QDialog>
+#include <QMap>
 
 namespace Ui {
 class HelpWindow;
@@ -15,8 +16,14 @@ public:
     void setHelpFont (const QFont &font, float sizemult);
 public slots:
     void display ();
+    void search (const QString &text);
 private:
+    struct Keyword {
+        QString anchor;
+        QString description;
+    };
     Ui::HelpWindow *ui;
+    QMap<QString,Keyword> keywords;
 };
 
 #endif // HELPWINDOW_H
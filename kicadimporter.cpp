@@ -0,0 +1,339 @@
+/*----------------------------------------------------------------------
+Fritzpart - Generates Fritzing parts from a part description script.
+Copyright (C) 2021, Jason Cipriani <jason.cipriani.dev@gmail.com>
+Not affiliated with Fritzing.
+
+This file is part of Fritzpart.
+
+Fritzpart is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+https://github.com/JC3/fritzpart
+----------------------------------------------------------------------*/
+
+#include "kicadimporter.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QPolygonF>
+#include <QRectF>
+#include <QRegularExpression>
+#include <QtMath>
+#include <stdexcept>
+#include <algorithm>
+#include <climits>
+#include <cmath>
+
+namespace {
+
+struct SNode {
+    bool list;
+    QString atom;
+    QList<SNode> items;
+    SNode () : list(false) { }
+    QString head () const { return (list && !items.empty()) ? items[0].atom : QString(); }
+    QString arg (int n) const { return n < items.size() ? items[n].atom : QString(); }
+    double num (int n) const { return arg(n).toDouble(); }
+    const SNode * child (const QString &name) const {
+        for (const SNode &item : items)
+            if (item.head() == name)
+                return &item;
+        return nullptr;
+    }
+};
+
+// pulls s-expressions off the input one at a time, so a footprint's top level items
+// can be handled (and thrown away) as they're read instead of building the whole tree.
+class SReader {
+public:
+    explicit SReader (QIODevice *in) : in(in) { }
+    bool next (SNode *node);
+    bool enter (QString *head);
+private:
+    enum Kind { End, Open, Close, Atom };
+    Kind token (QString *atom);
+    QIODevice *in;
+};
+
+SReader::Kind SReader::token (QString *atom) {
+    char ch;
+    do {
+        if (!in->getChar(&ch))
+            return End;
+    } while (isspace((unsigned char)ch));
+    if (ch == '(')
+        return Open;
+    if (ch == ')')
+        return Close;
+    QByteArray bytes;
+    if (ch == '"') {
+        while (in->getChar(&ch) && ch != '"') {
+            if (ch == '\\' && !in->getChar(&ch))
+                break;
+            bytes += ch;
+        }
+    } else {
+        do {
+            if (isspace((unsigned char)ch) || ch == ')' || ch == '(') {
+                in->ungetChar(ch);
+                break;
+            }
+            bytes += ch;
+        } while (in->getChar(&ch));
+    }
+    *atom = QString::fromUtf8(bytes);
+    return Atom;
+}
+
+// reads the next item of the current list; false at the end of the list.
+bool SReader::next (SNode *node) {
+    QString atom;
+    Kind kind = token(&atom);
+    if (kind == End)
+        throw std::runtime_error("unexpected end of file");
+    if (kind == Close)
+        return false;
+    *node = SNode();
+    if (kind == Open) {
+        node->list = true;
+        SNode item;
+        while (next(&item))
+            node->items.append(item);
+    } else {
+        node->atom = atom;
+    }
+    return true;
+}
+
+// reads the "(head" of the outermost list.
+bool SReader::enter (QString *head) {
+    return token(head) == Open && token(head) == Atom;
+}
+
+struct KPad {
+    QString number;
+    QString type;
+    QString shape;
+    double x, y, w, h, drill;
+    double angle; // degrees, about the pad's center
+};
+
+}
+
+// numbered pads first, in order; unnumbered or named ones (e.g. "A1") keep theirs after.
+static bool padNumberLess (const KPad &a, const KPad &b) {
+    auto key = [](const KPad &pad) {
+        bool ok;
+        int n = pad.number.toInt(&ok);
+        return ok ? n : INT_MAX;
+    };
+    return key(a) < key(b);
+}
+
+static bool isFrontLayer (const QString &layer) {
+    static const QStringList layers = { "F.SilkS", "F.Silkscreen", "F.CrtYd", "F.Courtyard" };
+    return layers.contains(layer);
+}
+
+static double strokeWidth (const SNode &item) {
+    if (const SNode *width = item.child("width"))
+        return width->num(1);
+    if (const SNode *stroke = item.child("stroke"))
+        if (const SNode *width = stroke->child("width"))
+            return width->num(1);
+    return 0;
+}
+
+static QPointF point (const SNode &item, const QString &name) {
+    const SNode *node = item.child(name);
+    return node ? QPointF(node->num(1), node->num(2)) : QPointF();
+}
+
+Part importKicadFootprint (const QString &filename, QStringList *warnings) {
+
+    QStringList ignored;
+    if (!warnings)
+        warnings = &ignored;
+
+    QFile file(filename);
+    if (!file.open(QFile::ReadOnly))
+        throw std::runtime_error(file.errorString().toStdString());
+
+    SReader reader(&file);
+    QString head;
+    if (!reader.enter(&head) || (head != "footprint" && head != "module"))
+        throw std::runtime_error("not a kicad footprint");
+
+    Part part;
+    part.units = "mm";
+    part.filename = QFileInfo(filename).completeBaseName();
+
+    QList<KPad> pads;
+    QList<Marking> marks;
+    double stroke = -1;
+    int skipped = 0, smd = 0;
+
+    SNode item;
+    bool first = true;
+    while (reader.next(&item)) {
+        const QString what = item.head();
+        if (first && !item.list) {
+            part.metadata[MetaTitle] = item.atom;
+        } else if (what == "descr") {
+            part.metadata[MetaDescription] = item.arg(1);
+        } else if (what == "tags") {
+            for (const QString &tag : item.arg(1).split(QRegularExpression("\\s+"), Qt::SkipEmptyParts))
+                if (!part.metatags.contains(tag))
+                    part.metatags.append(tag);
+        } else if (what == "pad") {
+            KPad pad;
+            pad.number = item.arg(1);
+            pad.type = item.arg(2);
+            pad.shape = item.arg(3);
+            QPointF at = point(item, "at"), size = point(item, "size");
+            const SNode *atnode = item.child("at");
+            pad.x = at.x();
+            pad.y = at.y();
+            pad.w = size.x();
+            pad.h = size.y();
+            pad.angle = (atnode && atnode->items.size() > 3) ? atnode->num(3) : 0;
+            pad.drill = 0;
+            if (const SNode *drill = item.child("drill")) {
+                // (drill d), (drill oval w h), (drill d (offset x y))
+                for (int n = 1; n < drill->items.size(); ++ n) {
+                    bool ok;
+                    double d = drill->items[n].atom.toDouble(&ok);
+                    if (ok && !drill->items[n].list)
+                        pad.drill = (pad.drill > 0 ? qMin(pad.drill, d) : d);
+                }
+            }
+            if (pad.type == "thru_hole" || pad.type == "np_thru_hole")
+                pads.append(pad);
+            else
+                ++ smd;
+        } else if (what == "fp_line" || what == "fp_circle" || what == "fp_rect") {
+            const SNode *layer = item.child("layer");
+            if (!layer || !isFrontLayer(layer->arg(1)))
+                continue;
+            if (stroke < 0)
+                stroke = strokeWidth(item);
+            if (what == "fp_line") {
+                QPointF a = point(item, "start"), b = point(item, "end");
+                marks.append(Marking::makeLine(a.x(), a.y(), b.x(), b.y(), true, true));
+            } else if (what == "fp_circle") {
+                QPointF c = point(item, "center"), e = point(item, "end");
+                marks.append(Marking::makeCircle(c.x(), c.y(), 2.0 * hypot(e.x() - c.x(), e.y() - c.y()), true, true));
+            } else {
+                QPointF a = point(item, "start"), b = point(item, "end");
+                QPolygonF r(QRectF(a, b).normalized());
+                for (int n = 0; n < 4; ++ n)
+                    marks.append(Marking::makeLine(r[n].x(), r[n].y(), r[n+1].x(), r[n+1].y(), true, true));
+            }
+        } else if (what == "fp_arc" || what == "fp_poly" || what == "fp_curve") {
+            const SNode *layer = item.child("layer");
+            if (layer && isFrontLayer(layer->arg(1)))
+                ++ skipped;
+        }
+        first = false;
+    }
+
+    if (smd)
+        warnings->append(QString("%1 smd pad(s) skipped").arg(smd));
+    if (skipped)
+        warnings->append(QString("%1 silkscreen/courtyard arc(s) or polygon(s) skipped").arg(skipped));
+
+    // ---- shift everything so the bounding box starts at 0,0
+
+    // pads are rotated about their centers, so their extents are the rotated size's.
+    QRectF bounds;
+    for (KPad &pad : pads) {
+        if (std::fmod(pad.angle, 180.0) == 0) {
+            // same extents
+        } else if (std::fmod(pad.angle, 90.0) == 0) {
+            std::swap(pad.w, pad.h);
+        } else {
+            const double a = qDegreesToRadians(pad.angle), c = fabs(cos(a)), s = fabs(sin(a));
+            const double w = pad.w * c + pad.h * s, h = pad.w * s + pad.h * c;
+            pad.w = w;
+            pad.h = h;
+            if (pad.shape != "circle")
+                warnings->append(QString("pad %1: rotated %2 degrees; using its bounding box").arg(pad.number).arg(pad.angle));
+        }
+        bounds = bounds.united(QRectF(pad.x - pad.w / 2.0, pad.y - pad.h / 2.0, pad.w, pad.h));
+    }
+    for (const Marking &mark : marks) {
+        if (mark.shape == Marking::Line)
+            bounds = bounds.united(QRectF(QPointF(mark.x1, mark.y1), QPointF(mark.x2, mark.y2)).normalized());
+        else
+            bounds = bounds.united(QRectF(mark.x1 - mark.diam / 2.0, mark.y1 - mark.diam / 2.0, mark.diam, mark.diam));
+    }
+    if (bounds.isNull())
+        throw std::runtime_error("footprint has no through-hole pads or front silkscreen/courtyard");
+
+    const double dx = -bounds.left(), dy = -bounds.top();
+    part.width = bounds.width();
+    part.height = bounds.height();
+    if (stroke > 0)
+        part.pcbmarkstroke = stroke;
+
+    for (Marking mark : marks) {
+        mark.x1 += dx;
+        mark.y1 += dy;
+        mark.x2 += dx;
+        mark.y2 += dy;
+        part.pcbmarks.append(mark);
+    }
+
+    // ---- pins, numbered in pad number order (non-numeric ones after, in file order)
+
+    QList<KPad> pins;
+    for (const KPad &pad : pads) {
+        if (pad.type == "np_thru_hole") {
+            Hole hole;
+            hole.x = pad.x + dx;
+            hole.y = pad.y + dy;
+            hole.diameter = pad.drill;
+            hole.origleft = hole.origtop = true;
+            part.pcbholes.append(hole);
+        } else {
+            pins.append(pad);
+        }
+    }
+
+    std::stable_sort(pins.begin(), pins.end(), padNumberLess);
+
+    QStringList numbers;
+    for (const KPad &pad : pins) {
+        Pin pin;
+        pin.number = part.pins.size() + 1;
+        pin.name = pad.number;
+        pin.x = pad.x + dx;
+        pin.y = pad.y + dy;
+        pin.hole = pad.drill;
+        pin.ring = (qMin(pad.w, pad.h) - pad.drill) / 2.0;
+        pin.square = (pad.shape == "rect" || pad.shape == "roundrect" || pad.shape == "trapezoid");
+        pin.origleft = pin.origtop = true;
+        if (pin.ring <= 0) {
+            warnings->append(QString("pad %1: no annular ring").arg(pad.number));
+            pin.ring = 0;
+        }
+        if (pad.shape == "custom" || pad.shape == "oval")
+            warnings->append(QString("pad %1: %2 pad converted to %3").arg(pad.number, pad.shape, pin.square ? "square" : "round"));
+        if (pad.number != "" && numbers.contains(pad.number))
+            warnings->append(QString("pad %1: pad number used more than once").arg(pad.number));
+        numbers.append(pad.number);
+        part.pins.append(pin);
+    }
+
+    return part;
+
+}
@@ -0,0 +1,38 @@
+/*----------------------------------------------------------------------
+Fritzpart - Generates Fritzing parts from a part description script.
+Copyright (C) 2021, Jason Cipriani <jason.cipriani.dev@gmail.com>
+Not affiliated with Fritzing.
+
+This file is part of Fritzpart.
+
+Fritzpart is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+https://github.com/JC3/fritzpart
+----------------------------------------------------------------------*/
+
+#ifndef KICADIMPORTER_H
+#define KICADIMPORTER_H
+
+#include <QString>
+#include <QStringList>
+#include "part.h"
+
+// reads a kicad footprint (.kicad_mod, old "module" or new "footprint" syntax) into a
+// Part. through-hole pads become pins, npth pads become pcb holes, and silkscreen and
+// courtyard lines/circles/rects become pcb markings. everything is shifted so the
+// bounding box of all of that starts at 0,0 (top left). smd pads, arcs, polygons etc.
+// are skipped and mentioned in warnings. throws std::runtime_error on failure.
+Part importKicadFootprint (const QString &filename, QStringList *warnings = nullptr);
+
+#endif // KICADIMPORTER_H
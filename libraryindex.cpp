@@ -0,0 +1,313 @@
+/*----------------------------------------------------------------------
+Fritzpart - Generates Fritzing parts from a part description script.
+Copyright (C) 2021, Jason Cipriani <jason.cipriani.dev@gmail.com>
+Not affiliated with Fritzing.
+
+This file is part of Fritzpart.
+
+Fritzpart is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+https://github.com/JC3/fritzpart
+----------------------------------------------------------------------*/
+
+
+#include "libraryindex.h"
+#include "partsnapshot.h"
+#include "partgen.h"
+#include "atomicfile.h"
+#include <QDataStream>
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QSet>
+#include <QtConcurrent>
+#include <QDebug>
+#include <functional>
+#include <stdexcept>
+
+static const quint32 IndexMagic = 0x46505849; // FPXI
+
+QString LibraryIndex::indexFileName (const QString &root) {
+    return QDir(root).absoluteFilePath(".fritzpart-index");
+}
+
+QString LibraryIndex::findRoot (const QString &path) {
+    if (path == "")
+        return QString();
+    QFileInfo info(path);
+    QDir dir(info.isDir() ? info.absoluteFilePath() : info.absolutePath());
+    do {
+        if (QFileInfo(indexFileName(dir.absolutePath())).isFile())
+            return dir.absolutePath();
+    } while (dir.cdUp());
+    return QString();
+}
+
+LibraryIndex::Field LibraryIndex::fieldOf (const QString &name) {
+    static const QHash<QString,Field> fields = {
+        { "moduleid", ModuleId }, { "partnumber", PartNumber }, { "family", Family },
+        { "tag", Tag }, { "property", Property }
+    };
+    return fields.value(name.toLower(), FieldCount);
+}
+
+QStringList LibraryIndex::keys (Field field, const LibraryEntry &entry) {
+    switch (field) {
+    case ModuleId: return { entry.moduleid };
+    case PartNumber: return { entry.partnumber };
+    case Family: return { entry.family };
+    case Tag: return entry.tags;
+    case Property: {
+        QStringList keys;
+        for (auto prop = entry.props.cbegin(); prop != entry.props.cend(); ++ prop)
+            keys.append(prop.key() + "=" + prop.value());
+        return keys;
+    }
+    default: return QStringList();
+    }
+}
+
+void LibraryIndex::link (const QString &script, const Script &entry) {
+    for (int f = 0; f < FieldCount; ++ f)
+        for (const LibraryEntry &part : entry.parts)
+            for (const QString &key : keys((Field)f, part))
+                if (key != "" && !lookup[f].contains(key, script))
+                    lookup[f].insert(key, script);
+}
+
+void LibraryIndex::unlink (const QString &script, const Script &entry) {
+    for (int f = 0; f < FieldCount; ++ f)
+        for (const LibraryEntry &part : entry.parts)
+            for (const QString &key : keys((Field)f, part))
+                lookup[f].remove(key, script);
+}
+
+void LibraryIndex::load () {
+
+    scripts.clear();
+    for (int f = 0; f < FieldCount; ++ f)
+        lookup[f].clear();
+
+    // no index yet is just an empty library.
+    QFile file(indexFileName(rootdir));
+    if (!file.exists())
+        return;
+    if (!file.open(QFile::ReadOnly))
+        throw std::runtime_error(file.errorString().toStdString());
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_12);
+    quint32 magic, version, count;
+    in >> magic >> version >> count;
+    if (magic != IndexMagic || version != FileVersion)
+        throw std::runtime_error(QString("%1 is not a fritzpart %2 library index").arg(file.fileName()).arg((int)FileVersion).toStdString());
+
+    // paths are stored relative to the root, so the library can be moved.
+    const QDir root(rootdir);
+    for (quint32 n = 0; n < count && in.status() == QDataStream::Ok; ++ n) {
+        QString script;
+        Script entry;
+        quint32 nparts;
+        in >> script >> entry.mtime >> nparts;
+        script = QDir::cleanPath(root.absoluteFilePath(script));
+        for (quint32 p = 0; p < nparts && in.status() == QDataStream::Ok; ++ p) {
+            LibraryEntry part;
+            QMap<QString,QString> props;
+            in >> part.fzpz >> part.moduleid >> part.title >> part.partnumber >> part.family >> part.tags >> props;
+            part.script = script;
+            part.fzpz = QDir::cleanPath(root.absoluteFilePath(part.fzpz));
+            static_cast<QMap<QString,QString> &>(part.props) = props;
+            entry.parts.append(part);
+        }
+        scripts.insert(script, entry);
+        link(script, entry);
+    }
+    if (in.status() != QDataStream::Ok)
+        throw std::runtime_error(QString("%1 is damaged").arg(file.fileName()).toStdString());
+
+    qDebug() << "library index:" << rootdir << scripts.size() << "scripts";
+
+}
+
+void LibraryIndex::save () {
+
+    AtomicFile file(indexFileName(rootdir));
+    QDataStream out(file.file());
+    out.setVersion(QDataStream::Qt_5_12);
+    out << IndexMagic << (quint32)FileVersion << (quint32)scripts.size();
+
+    const QDir root(rootdir);
+    for (auto script = scripts.cbegin(); script != scripts.cend(); ++ script) {
+        out << root.relativeFilePath(script.key()) << script->mtime << (quint32)script->parts.size();
+        for (const LibraryEntry &part : script->parts)
+            out << root.relativeFilePath(part.fzpz) << part.moduleid << part.title << part.partnumber << part.family
+                << part.tags << static_cast<const QMap<QString,QString> &>(part.props);
+    }
+
+    if (out.status() != QDataStream::Ok)
+        throw std::runtime_error(file.file()->errorString().toStdString());
+    file.commit();
+
+}
+
+// replaces whatever was indexed for the script with these parts.
+void LibraryIndex::update (const QString &script, const QList<Part> &parts) {
+
+    const QString path = QFileInfo(script).absoluteFilePath();
+    remove(path);
+
+    Script entry;
+    entry.mtime = QFileInfo(path).lastModified().toMSecsSinceEpoch();
+    for (const Part &part : parts) {
+        LibraryEntry e;
+        e.script = path;
+        e.fzpz = PartFilenames(part.filename, path).fzpz;
+        e.moduleid = part.metadata[MetaModuleId];
+        e.title = part.metadata[MetaTitle];
+        e.partnumber = part.metadata[MetaPartNumber];
+        e.family = part.metadata[MetaFamily];
+        e.tags = part.metatags;
+        e.props = part.metaprops;
+        entry.parts.append(e);
+    }
+
+    scripts.insert(path, entry);
+    link(path, entry);
+
+}
+
+void LibraryIndex::remove (const QString &script) {
+    auto entry = scripts.find(QFileInfo(script).absoluteFilePath());
+    if (entry != scripts.end()) {
+        unlink(entry.key(), entry.value());
+        scripts.erase(entry);
+    }
+}
+
+// module ids in parts (all of script's variants or blocks) that are used more than
+// once, either by other scripts or within the script.
+QStringList LibraryIndex::collisions (const QString &script, const QList<Part> &parts) const {
+    const QString path = QFileInfo(script).absoluteFilePath();
+    const QDir root(rootdir);
+    QStringList problems;
+    QSet<QString> seen;
+    for (const Part &part : parts) {
+        const QString moduleid = part.metadata[MetaModuleId];
+        if (seen.contains(moduleid))
+            problems.append(QString("module id %1 is used by more than one part of the script").arg(moduleid));
+        seen.insert(moduleid);
+        for (const QString &other : lookup[ModuleId].values(moduleid))
+            if (other != path)
+                problems.append(QString("module id %1 is already used by %2").arg(moduleid, root.relativeFilePath(other)));
+    }
+    return problems;
+}
+
+QList<LibraryEntry> LibraryIndex::find (Field field, const QString &value) const {
+    QStringList owners = lookup[field].values(value);
+    owners.sort();
+    QList<LibraryEntry> found;
+    for (const QString &script : owners)
+        for (const LibraryEntry &entry : scripts[script].parts)
+            if (keys(field, entry).contains(value))
+                found.append(entry);
+    return found;
+}
+
+// "field:value" looks in just that field, anything else in all of them.
+QList<LibraryEntry> LibraryIndex::search (const QString &text) const {
+    const int colon = text.indexOf(':');
+    const Field field = (colon > 0 ? fieldOf(text.left(colon)) : FieldCount);
+    if (field != FieldCount)
+        return find(field, text.mid(colon + 1).trimmed());
+    QList<LibraryEntry> found;
+    QSet<QString> seen;
+    for (int f = 0; f < FieldCount; ++ f) {
+        for (const LibraryEntry &entry : find((Field)f, text.trimmed())) {
+            const QString key = entry.script + "\n" + entry.moduleid;
+            if (!seen.contains(key)) {
+                seen.insert(key);
+                found.append(entry);
+            }
+        }
+    }
+    return found;
+}
+
+// brings the index up to date with the scripts under the root: new and edited ones are
+// compiled (in parallel, through the snapshot cache) and deleted ones dropped. scripts
+// that don't compile, and module ids used more than once, come back as problems. pin
+// tables the scripts read aren't scripts, and are left out.
+QStringList LibraryIndex::refresh () {
+
+    const QDir root(rootdir);
+    QSet<QString> present;
+    QStringList files, stale;
+    QDirIterator it(rootdir, { "*.txt" }, QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext())
+        files.append(QFileInfo(it.next()).absoluteFilePath());
+    for (const QString &script : PartCompiler::withoutPinTables(files)) {
+        present.insert(script);
+        auto known = scripts.constFind(script);
+        if (known == scripts.cend() || known->mtime != QFileInfo(script).lastModified().toMSecsSinceEpoch())
+            stale.append(script);
+    }
+    for (const QString &script : scripts.keys())
+        if (!present.contains(script))
+            remove(script);
+    stale.sort();
+
+    struct Compiled {
+        QList<Part> parts;
+        QString error;
+    };
+    const QString cachedir = snapshotCacheDir();
+    std::function<Compiled(const QString &)> compile = [cachedir](const QString &script) {
+        Compiled compiled;
+        try {
+            for (const PartVariant &variant : compileScriptCached(script, cachedir))
+                compiled.parts.append(variant.part);
+        } catch (const std::exception &x) {
+            compiled.error = x.what();
+        }
+        return compiled;
+    };
+    QList<Compiled> results = QtConcurrent::blockingMapped<QList<Compiled> >(stale, compile);
+
+    QStringList problems;
+    for (int n = 0; n < stale.size(); ++ n) {
+        if (results[n].error != "") {
+            remove(stale[n]);
+            problems.append(QString("%1: %2").arg(root.relativeFilePath(stale[n]), results[n].error));
+        } else {
+            update(stale[n], results[n].parts);
+        }
+    }
+
+    QStringList ids = lookup[ModuleId].uniqueKeys();
+    ids.sort();
+    for (const QString &moduleid : ids) {
+        QStringList owners = lookup[ModuleId].values(moduleid);
+        if (owners.size() > 1) {
+            for (QString &owner : owners)
+                owner = root.relativeFilePath(owner);
+            owners.sort();
+            problems.append(QString("module id %1 is used by %2").arg(moduleid, owners.join(", ")));
+        }
+    }
+
+    qDebug() << "library index:" << rootdir << stale.size() << "of" << scripts.size() << "scripts reindexed";
+    return problems;
+
+}
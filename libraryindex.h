@@ -0,0 +1,85 @@
+/*----------------------------------------------------------------------
+Fritzpart - Generates Fritzing parts from a part description script.
+Copyright (C) 2021, Jason Cipriani <jason.cipriani.dev@gmail.com>
+Not affiliated with Fritzing.
+
+This file is part of Fritzpart.
+
+Fritzpart is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+https://github.com/JC3/fritzpart
+----------------------------------------------------------------------*/
+
+
+#ifndef LIBRARYINDEX_H
+#define LIBRARYINDEX_H
+
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QHash>
+#include <QMultiHash>
+#include "part.h"
+
+// one part (one variant) of an indexed script.
+struct LibraryEntry {
+    QString script;     // absolute path
+    QString fzpz;       // where a build puts it by default, next to the script
+    QString moduleid;
+    QString title;
+    QString partnumber;
+    QString family;
+    QStringList tags;
+    PropertyMap props;
+};
+
+// an index of every part script under a library directory, kept in the directory as
+// .fritzpart-index and found from any script in it by walking up, like .git. parts can
+// be looked up by module id, part number, family, tag or property (as name=value)
+// without touching the scripts or built parts. scripts are updated one at a time as
+// they're built; refresh() catches up with scripts added, edited or removed since.
+// fritzing requires module ids to be unique, which the index is what checks.
+class LibraryIndex {
+public:
+    enum Field { ModuleId, PartNumber, Family, Tag, Property, FieldCount };
+    enum { FileVersion = 1 };
+    explicit LibraryIndex (const QString &root = QString()) : rootdir(root) { }
+    static QString indexFileName (const QString &root);
+    static QString findRoot (const QString &path); // library containing path, or "" if none
+    QString root () const { return rootdir; }
+    bool isValid () const { return rootdir != ""; }
+    void load ();  // errors throw std::runtime_error
+    void save ();
+    QStringList refresh ();
+    void update (const QString &script, const QList<Part> &parts);
+    void remove (const QString &script);
+    QStringList collisions (const QString &script, const QList<Part> &parts) const;
+    QList<LibraryEntry> find (Field field, const QString &value) const;
+    QList<LibraryEntry> search (const QString &text) const; // any field
+    int scriptCount () const { return scripts.size(); }
+    static Field fieldOf (const QString &name); // FieldCount if unknown
+private:
+    struct Script {
+        qint64 mtime;   // of the script when it was indexed
+        QList<LibraryEntry> parts;
+    };
+    void link (const QString &script, const Script &entry);
+    void unlink (const QString &script, const Script &entry);
+    static QStringList keys (Field field, const LibraryEntry &entry);
+    QString rootdir;
+    QHash<QString,Script> scripts;                  // by absolute path
+    QMultiHash<QString,QString> lookup[FieldCount]; // value -> script
+};
+
+#endif // LIBRARYINDEX_H
@@ -22,21 +22,53 @@ https://github.com/JC3/fritzpart
 ----------------------------------------------------------------------*/
 
 #include "mainwindow.h"
+#include "cli.h"
+#include "startuptrace.h"
 #include <QApplication>
+#include <QTimer>
+#include <algorithm>
+#include <cstring>
 
 int main (int argc, char *argv[]) {
 
+    // --startup-trace works with any other arguments, so take it out of the way first.
+    for (int n = 1; n < argc; ++ n) {
+        if (!strcmp(argv[n], "--startup-trace")) {
+            enableStartupTrace();
+            std::copy(argv + n + 1, argv + argc + 1, argv + n);
+            -- argc;
+            break;
+        }
+    }
+
     QApplication::setAttribute(Qt::AA_EnableHighDpiScaling);
     QApplication::setOrganizationName("fritzpart");
     QApplication::setApplicationName("fritzpart");
+    QApplication::setApplicationVersion(APPLICATION_VERSION);
+
+    if (isCommandLineMode(argc, argv)) {
+        QCoreApplication a(argc, argv);
+        return runCommandLine(a);
+    }
 
     QApplication a(argc, argv);
+    startupTrace("application");
     MainWindow w;
+    startupTrace("main window");
 
-    if (argc > 1)
-        w.loadFile(argv[1]);
-
+    traceFirstPaint(&w);
     w.show();
+    startupTrace("shown");
+
+    // load the script once the window is up, so it appears right away even if the
+    // file is somewhere slow.
+    if (argc > 1) {
+        QString filename = QString::fromLocal8Bit(argv[1]);
+        QTimer::singleShot(0, &w, [&w, filename] () {
+            w.loadFile(filename);
+            startupTrace("script loaded");
+        });
+    }
 
     return a.exec();
 
@@ -23,70 +23,111 @@ https://github.com/JC3/fritzpart
 
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
+#include "partgen.h"
+#include "previewview.h"
 #include <QFileDialog>
 #include <QFile>
-#include <QTextStream>
+#include <QFileInfo>
+#include <QDir>
+#include <QApplication>
 #include <QMessageBox>
 #include <QDebug>
 #include <QDomDocument>
-#include <QTemporaryDir>
-#include <QProcess>
-#include <QDate>
-#include <QRegExp>
 #include <QCloseEvent>
-#include <QSvgRenderer>
+#include <QVBoxLayout>
 #include <QDesktopServices>
 #include <QResource>
 #include <QStandardPaths>
-#include <QQueue>
+#include <QStatusBar>
+#include <QActionGroup>
+#include <QInputDialog>
+#include <QPlainTextEdit>
+#include <QThread>
+#include <QTextBlock>
+#include <QtConcurrent>
 #include <stdexcept>
-#include <iomanip>
-#include <sstream>
-#include <cmath>
 
 MainWindow::MainWindow(QWidget *parent) :
     QMainWindow(parent),
     ui(new Ui::MainWindow),
-    helpdlg(nullptr)
+    helpdlg(nullptr),
+    gallery(nullptr),
+    builddoc(nullptr),
+    building(false),
+    buildask(false),
+    queuedbuild(NoBuild),
+    views{},
+    recentview(PreviewPCB),
+    previewdoc(nullptr)
 {
     ui->setupUi(this);
     ui->actShowOutput->setChecked(settings.value("showoutput", true).toBool());
     ui->actBackup->setChecked(settings.value("backupfzpz", true).toBool());
-    basetitle = windowTitle();
-    connect(ui->txtScript->document(), SIGNAL(modificationChanged(bool)), this, SLOT(updateWindowTitle()));
-    updateWindowTitle();
-    // look for minizip if necessary (so on first install the user doesn't
-    // have to find it themselves).
-    if (settings.value("minizip").toString().isEmpty()) {
-        const QStringList places = {
-            QDir(QApplication::applicationDirPath()).absoluteFilePath("contrib"),
-            QDir::current().absoluteFilePath("contrib"),
-            QApplication::applicationDirPath(),
-            QDir::currentPath()
-        };
-        qDebug() << "looking for minizip...";
-        for (const QString &place : places) {
-            QString path = QDir(place).absoluteFilePath("minizip.exe");
-            if (QFile::exists(path)) {
-                qDebug() << "found" << path;
-                settings.setValue("minizip", path);
-                break;
-            }
-        }
+    ui->actSyncOutput->setChecked(settings.value("syncoutput", false).toBool());
+    ui->actMemStats->setChecked(settings.value("memstats", false).toBool());
+    setMemStatsEnabled(ui->actMemStats->isChecked());
+    ui->actBackupCount->setEnabled(ui->actBackup->isChecked());
+    ui->actUseMinizip->setChecked(settings.value("useminizip", false).toBool());
+    ui->actLocateMinizip->setEnabled(ui->actUseMinizip->isChecked());
+    QActionGroup *levels = new QActionGroup(this);
+    const int level = settings.value("ziplevel", (int)ZipDefaultLevel).toInt();
+    for (auto action : { qMakePair(ui->actCompressStore, (int)ZipStore), qMakePair(ui->actCompressFast, (int)ZipFastest),
+                         qMakePair(ui->actCompressNormal, (int)ZipDefaultLevel), qMakePair(ui->actCompressBest, (int)ZipBest) }) {
+        action.first->setData(action.second);
+        action.first->setActionGroup(levels);
+        action.first->setChecked(action.second == level);
     }
-    // initial default script path
-    if (settings.value("scriptpath").toString().isEmpty())
-        settings.setValue("scriptpath", QStandardPaths::writableLocation(QStandardPaths::DocumentsLocation));
+    connect(levels, SIGNAL(triggered(QAction*)), this, SLOT(compressionChanged(QAction*)));
+    basetitle = windowTitle();
+    // background compiles are for tabs nobody's looking at, so they get at most half the cores.
+    backgroundpool.setMaxThreadCount(qMax(1, QThread::idealThreadCount() / 2));
+    connect(ui->tabScripts, SIGNAL(currentChanged(int)), this, SLOT(documentChanged()));
+    connect(ui->tabScripts, &QTabWidget::tabCloseRequested, this, [this] (int index) {
+        for (Document *doc : documents)
+            if (doc->editor == ui->tabScripts->widget(index))
+                closeDocument(doc);
+    });
+    newDocument();
+    ui->actLivePreview->setChecked(settings.value("livepreview", false).toBool());
+    livetimer.setSingleShot(true);
+    livetimer.setInterval(300);
+    connect(&livetimer, SIGNAL(timeout()), this, SLOT(livePreview()));
+    ui->actShowBreadboard->setChecked(settings.value("showbreadboard", true).toBool());
+    ui->actShowSchematic->setChecked(settings.value("showschematic", true).toBool());
+    ui->actShowPCB->setChecked(settings.value("showpcb", true).toBool());
+    for (QAction *action : { ui->actShowBreadboard, ui->actShowSchematic, ui->actShowPCB })
+        connect(action, SIGNAL(toggled(bool)), this, SLOT(previewVisibilityChanged()));
+    previewVisibilityChanged();
+    idletimer.setSingleShot(true);
+    idletimer.setInterval(2000);
+    connect(&idletimer, SIGNAL(timeout()), this, SLOT(generateDeferredPreviews()));
+    connect(&deferring, SIGNAL(finished()), this, SLOT(previewsDeferred()));
+    connect(&compiling, SIGNAL(finished()), this, SLOT(buildCompiled()));
+    connect(&archiving, SIGNAL(finished()), this, SLOT(buildArchived()));
+    // minizip is looked for the first time it's needed, the script path default is
+    // filled in when a file dialog first needs it, and the previews and help window are
+    // created the first time they're shown; all of that can be slow with a network
+    // home directory and none of it is needed to show the window.
 }
 
 MainWindow::~MainWindow()
 {
+    // the build workers post back to this window; let them finish first.
+    buildcancel.storeRelaxed(1);
+    compiling.waitForFinished();
+    archiving.waitForFinished();
+    backgroundpool.clear();
+    backgroundpool.waitForDone();
+    deferring.waitForFinished();
+    qDeleteAll(documents);
     delete ui;
 }
 
 void MainWindow::on_actLocateMinizip_triggered()
 {
     QString minizip = settings.value("minizip").toString();
+    if (minizip == "")
+        minizip = findMinizip();
     minizip = QFileDialog::getOpenFileName(this, "Locate minizip", minizip);
     if (minizip == "")
         return;
@@ -94,6 +135,17 @@ void MainWindow::on_actLocateMinizip_triggered()
     settings.setValue("minizip", minizip);
 }
 
+void MainWindow::on_actUseMinizip_triggered(bool checked)
+{
+    settings.setValue("useminizip", checked);
+    ui->actLocateMinizip->setEnabled(checked);
+}
+
+void MainWindow::compressionChanged(QAction *action)
+{
+    settings.setValue("ziplevel", action->data().toInt());
+}
+
 void MainWindow::on_actShowOutput_triggered(bool checked)
 {
     settings.setValue("showoutput", checked);
@@ -102,6 +154,55 @@ void MainWindow::on_actShowOutput_triggered(bool checked)
 void MainWindow::on_actBackup_triggered(bool checked)
 {
     settings.setValue("backupfzpz", checked);
+    ui->actBackupCount->setEnabled(checked);
+}
+
+void MainWindow::on_actBackupCount_triggered()
+{
+    bool ok;
+    int count = QInputDialog::getInt(this, "Backups", "Number of old versions of each fzpz to keep:",
+                                     settings.value("backupcount", 1).toInt(), 1, 99, 1, &ok);
+    if (ok)
+        settings.setValue("backupcount", count);
+}
+
+void MainWindow::on_actSyncOutput_triggered(bool checked)
+{
+    settings.setValue("syncoutput", checked);
+}
+
+void MainWindow::on_actMemStats_triggered(bool checked)
+{
+    settings.setValue("memstats", checked);
+    setMemStatsEnabled(checked);
+}
+
+void MainWindow::on_actLivePreview_triggered(bool checked)
+{
+    settings.setValue("livepreview", checked);
+    if (checked)
+        livetimer.start();
+}
+
+void MainWindow::scriptEdited () {
+    idletimer.stop();
+    if (ui->actLivePreview->isChecked())
+        livetimer.start();
+}
+
+void MainWindow::livePreview () {
+    // like on_actPreview_triggered but errors go to the status bar instead of a popup,
+    // since they're expected while you're in the middle of typing.
+    Document *doc = currentDocument();
+    try {
+        Part part = compile();
+        showPartPreviews(part);
+        statusBar()->showMessage(QString("Preview updated (%1 lines parsed).").arg(doc->compiler.lastReparsedLines()));
+    } catch (const std::exception &x) {
+        doc->tried = doc->revision;
+        doc->error = x.what();
+        statusBar()->showMessage(x.what());
+    }
 }
 
 void MainWindow::showAboutBox () {
@@ -124,9 +225,102 @@ void MainWindow::on_actHelpHelp_triggered()
     helpdlg->display();
 }
 
+QString MainWindow::scriptPath () {
+    QString path = settings.value("scriptpath").toString();
+    if (path.isEmpty()) {
+        path = QStandardPaths::writableLocation(QStandardPaths::DocumentsLocation);
+        settings.setValue("scriptpath", path);
+    }
+    return path;
+}
+
+void MainWindow::on_actGallery_triggered()
+{
+    QString dir = QFileDialog::getExistingDirectory(this, "Part Gallery", scriptPath());
+    if (dir == "")
+        return;
+    if (!gallery) {
+        gallery = new GalleryWindow(this);
+        connect(gallery, &GalleryWindow::scriptClicked, this, &MainWindow::loadFile);
+    }
+    gallery->setDirectory(dir);
+    gallery->display();
+}
+
+// the index of the library a script is in, or null if it isn't in one. the last one is
+// kept, and loaded again if the script is in another library or the index changes on disk.
+LibraryIndex * MainWindow::libraryOf (const QString &script) {
+    const QString root = LibraryIndex::findRoot(script);
+    if (root == "")
+        return nullptr;
+    const QDateTime modified = QFileInfo(LibraryIndex::indexFileName(root)).lastModified();
+    if (root != library.root() || modified != librarytime) {
+        library = LibraryIndex(root);
+        librarytime = QDateTime();
+        library.load();
+        librarytime = modified;
+    }
+    return &library;
+}
+
+void MainWindow::on_actFindInLibrary_triggered()
+{
+    try {
+
+        QString root = LibraryIndex::findRoot(currentDocument()->filename);
+        if (root == "") {
+            root = QFileDialog::getExistingDirectory(this, "Find in Library", scriptPath());
+            if (root == "")
+                return;
+            if (!QFile::exists(LibraryIndex::indexFileName(root)) &&
+                    QMessageBox::question(this, "Find in Library", QString("%1 isn't indexed yet. Index it now?")
+                                          .arg(QDir::toNativeSeparators(root))) != QMessageBox::Yes)
+                return;
+        }
+
+        // catch up with scripts edited outside of fritzpart first.
+        LibraryIndex index(root);
+        QStringList problems;
+        QApplication::setOverrideCursor(Qt::WaitCursor);
+        try {
+            index.load();
+            problems = index.refresh();
+            index.save();
+        } catch (...) {
+            QApplication::restoreOverrideCursor();
+            throw;
+        }
+        QApplication::restoreOverrideCursor();
+        if (!problems.empty())
+            statusBar()->showMessage(QString("%1 problem(s) in the library, e.g. %2").arg(problems.size()).arg(problems.first()));
+
+        bool ok;
+        const QString query = QInputDialog::getText(this, "Find in Library", "Module ID, part number, family, tag or property name=value\n"
+                                                    "(field:value looks in just that field):", QLineEdit::Normal, QString(), &ok);
+        if (!ok || query.trimmed() == "")
+            return;
+
+        const QList<LibraryEntry> found = index.search(query);
+        if (found.empty()) {
+            QMessageBox::information(this, "Find in Library", QString("Nothing in the library matches %1.").arg(query));
+            return;
+        }
+        QStringList items;
+        for (const LibraryEntry &entry : found)
+            items.append(QString("%1 (%2)").arg(entry.moduleid, QDir(root).relativeFilePath(entry.script)));
+        const QString item = QInputDialog::getItem(this, "Find in Library", QString("%1 part(s) found. Open:").arg(found.size()),
+                                                   items, 0, false, &ok);
+        if (ok)
+            loadFile(found[items.indexOf(item)].script);
+
+    } catch (const std::exception &x) {
+        QMessageBox::critical(this, "Find in Library", x.what());
+    }
+}
+
 void MainWindow::on_actOpenFile_triggered()
 {
-    QString prev = settings.value("scriptpath").toString();
+    QString prev = scriptPath();
     QString filename = QFileDialog::getOpenFileName(this, "Open File...", prev, "*.txt");
     if (filename != "")
         loadFile(filename);
@@ -134,9 +328,9 @@ void MainWindow::on_actOpenFile_triggered()
 
 void MainWindow::on_actSaveFile_triggered()
 {
-    QString prev = settings.value("scriptpath").toString();
-    if (curfilename != "")
-        prev = curfilename;
+    QString prev = scriptPath();
+    if (currentDocument()->filename != "")
+        prev = currentDocument()->filename;
     QString filename = QFileDialog::getSaveFileName(this, "Save File...", prev, "*.txt");
     if (filename != "")
         saveFile(filename);
@@ -144,23 +338,163 @@ void MainWindow::on_actSaveFile_triggered()
 
 void MainWindow::on_actNewFile_triggered()
 {
-    if (promptSaveIfModified()) {
-        //ui->txtScript->setDocument(new QTextDocument(ui->txtScript));
-        // whatever:
-        ui->txtScript->clear();
-        setCurrentFileName("");
-        clearPartPreviews();
+    newDocument();
+}
+
+void MainWindow::on_actCloseFile_triggered()
+{
+    closeDocument(currentDocument());
+}
+
+MainWindow::Document * MainWindow::newDocument () {
+
+    static int lastid = 0;
+    Document *doc = new Document;
+    doc->id = ++ lastid;
+    doc->editor = new QPlainTextEdit;
+    doc->editor->setMinimumWidth(300);
+    doc->editor->setFont(QFont("Courier New", 10));
+    doc->editor->setLineWrapMode(QPlainTextEdit::NoWrap);
+    documents.append(doc);
+
+    connect(doc->editor->document(), SIGNAL(modificationChanged(bool)), this, SLOT(updateWindowTitle()));
+    connect(doc->editor, &QPlainTextEdit::textChanged, this, [this, doc] () {
+        ++ doc->revision;
+        scriptEdited();
+    });
+    connect(doc->editor, SIGNAL(cursorPositionChanged()), this, SLOT(caretMoved()));
+    connect(&doc->background, &QFutureWatcher<BackgroundResult>::finished, this, [this, doc] () {
+        backgroundCompiled(doc);
+    });
+
+    ui->tabScripts->setCurrentIndex(ui->tabScripts->addTab(doc->editor, QString()));
+    updateWindowTitle();
+    return doc;
+
+}
+
+MainWindow::Document * MainWindow::currentDocument () const {
+    for (Document *doc : documents)
+        if (doc->editor == ui->tabScripts->currentWidget())
+            return doc;
+    return nullptr;
+}
+
+// false if it's still open (unsaved changes kept, or it's being built). there's always
+// at least one tab; closing the last one leaves a new empty one.
+bool MainWindow::closeDocument (Document *doc) {
+
+    if (building && doc == builddoc) {
+        statusBar()->showMessage("Wait for the build to finish (or cancel it) before closing the script.");
+        return false;
     }
+    if (!promptSaveIfModified(doc))
+        return false;
+
+    // a background compile still running for it just finishes with nobody listening.
+    documents.removeOne(doc);
+    if (previewdoc == doc)
+        previewdoc = nullptr;
+    ui->tabScripts->removeTab(ui->tabScripts->indexOf(doc->editor));
+    delete doc->editor;
+    delete doc;
+
+    if (documents.empty())
+        newDocument();
+    return true;
+
+}
+
+void MainWindow::setDocumentFileName (Document *doc, QString filename) {
+    doc->filename = filename;
+    doc->compiler.setScriptPath(filename);
+    updateWindowTitle();
+}
+
+void MainWindow::documentChanged () {
+
+    Document *current = currentDocument();
+    if (!current)
+        return;
+    updateWindowTitle();
+
+    // show what it compiled to last; it only needs compiling again if it was edited
+    // since then, and that's probably already happening in the background.
+    refreshPreviews();
+    if (current->tried == current->revision && current->error != "")
+        statusBar()->showMessage(current->error);
+    else
+        statusBar()->clearMessage();
+    if (current->tried != current->revision && current->revision > 0 && ui->actLivePreview->isChecked())
+        livetimer.start();
+
+    for (Document *doc : documents)
+        if (doc != current)
+            compileInBackground(doc);
+
+}
+
+// compiles a tab that isn't current and renders its previews, at low priority, so
+// they're ready when it's switched to. like builds, this compiles on a copy of the
+// document's compiler, which is adopted afterwards if the text hasn't changed since.
+void MainWindow::compileInBackground (Document *doc) {
+
+    if (doc->tried == doc->revision || doc->background.isRunning())
+        return;
+
+    PartCompiler worker = doc->compiler;
+    const QString text = doc->editor->toPlainText();
+    const int revision = doc->revision;
+    const QVector<bool> shown = previewsShown();
+    doc->background.setFuture(QtConcurrent::run(&backgroundpool, [worker, text, revision, shown] () mutable {
+        // this pool only runs background compiles, so its threads can stay at low priority.
+        QThread::currentThread()->setPriority(QThread::LowPriority);
+        BackgroundResult result;
+        result.revision = revision;
+        result.svgs.resize(PreviewCount);
+        try {
+            result.part = worker.compile(text);
+            for (int view = 0; view < PreviewCount; ++ view)
+                if (shown[view])
+                    result.svgs[view] = generatePreview(result.part, view);
+        } catch (const std::exception &x) {
+            result.error = x.what();
+        }
+        result.compiler = worker;
+        return result;
+    }));
+
+}
+
+void MainWindow::backgroundCompiled (Document *doc) {
+
+    const BackgroundResult result = doc->background.result();
+
+    // edited since (or compiled in the foreground meanwhile): try again later, or now
+    // if it's still in the background.
+    if (result.revision != doc->revision || doc->tried == doc->revision) {
+        if (doc != currentDocument())
+            compileInBackground(doc);
+        return;
+    }
+
+    doc->compiler = result.compiler;
+    doc->tried = result.revision;
+    doc->error = result.error;
+    if (result.error == "")
+        setPartPreviews(doc, result.part, result.svgs);
+
 }
 
-bool MainWindow::promptSaveIfModified() {
+bool MainWindow::promptSaveIfModified(Document *doc) {
     bool confirmed = false;
-    if (ui->txtScript->document()->isModified()) {
+    if (doc->editor->document()->isModified()) {
+        ui->tabScripts->setCurrentWidget(doc->editor);
         int action = QMessageBox::warning(this, "Confirm Action", "there are unsaved changes. do you want to save them?",
                                           QMessageBox::Save | QMessageBox::Discard | QMessageBox::Cancel, QMessageBox::Save);
         if (action == QMessageBox::Save) {
             ui->actSaveFile->trigger();
-            confirmed = !ui->txtScript->document()->isModified();
+            confirmed = !doc->editor->document()->isModified();
         } else if (action == QMessageBox::Discard) {
             confirmed = true;
         }
@@ -170,9 +504,16 @@ bool MainWindow::promptSaveIfModified() {
     return confirmed;
 }
 
+// opens the script in a new tab, or switches to it if it's already open. an untouched
+// new tab is reused.
 void MainWindow::loadFile(QString filename) {
-    if (!promptSaveIfModified())
-        return;
+    const QString path = QFileInfo(filename).absoluteFilePath();
+    for (Document *doc : documents) {
+        if (doc->filename == path) {
+            ui->tabScripts->setCurrentWidget(doc->editor);
+            return;
+        }
+    }
     try {
         QFile file(filename);
         if (!file.open(QFile::ReadOnly | QFile::Text))
@@ -180,11 +521,14 @@ void MainWindow::loadFile(QString filename) {
         QString script = QString::fromUtf8(file.readAll());
         if (script == "")
             throw std::runtime_error("File contains no text.");
-        ui->txtScript->setPlainText(script);
-        ui->txtScript->document()->setModified(false);
-        setCurrentFileName(QFileInfo(file).absoluteFilePath());
+        Document *doc = currentDocument();
+        if (doc->filename != "" || doc->revision != 0)
+            doc = newDocument();
+        doc->editor->setPlainText(script);
+        doc->editor->document()->setModified(false);
+        setDocumentFileName(doc, path);
         settings.setValue("scriptpath", QFileInfo(file).absolutePath());
-        clearPartPreviews();
+        doc->compiler.reset();
     } catch (const std::exception &x) {
         QMessageBox::critical(this, "Error Loading File", x.what());
     }
@@ -192,1223 +536,533 @@ void MainWindow::loadFile(QString filename) {
 
 
 void MainWindow::saveFile(QString filename) {
+    Document *doc = currentDocument();
     try {
         QFile file(filename);
         if (!file.open(QFile::WriteOnly | QFile::Text))
             throw std::runtime_error(file.errorString().toStdString());
-        QByteArray data = ui->txtScript->toPlainText().toUtf8();
+        QByteArray data = doc->editor->toPlainText().toUtf8();
         if (file.write(data) != data.length())
             throw std::runtime_error(file.errorString().toStdString());
-        setCurrentFileName(QFileInfo(file).absoluteFilePath());
+        setDocumentFileName(doc, QFileInfo(file).absoluteFilePath());
         settings.setValue("scriptpath", QFileInfo(file).absolutePath());
-        ui->txtScript->document()->setModified(false);
+        doc->editor->document()->setModified(false);
     } catch (const std::exception &x) {
         QMessageBox::critical(this, "Error Saving File", x.what());
     }
 }
 
 void MainWindow::closeEvent(QCloseEvent *event) {
-    if (promptSaveIfModified())
-        event->accept();
-    else
-        event->ignore();
+    for (Document *doc : documents) {
+        if (!promptSaveIfModified(doc)) {
+            event->ignore();
+            return;
+        }
+    }
+    event->accept();
 }
 
 void MainWindow::updateWindowTitle() {
-    bool mod = ui->txtScript->document()->isModified();
-    QString name = curfilename.isEmpty() ? "untitled" : QFileInfo(curfilename).fileName();
-    setWindowTitle(QString("%1%2 - %3").arg(mod ? "*" : "").arg(name, basetitle));
+    for (Document *doc : documents) {
+        const int index = ui->tabScripts->indexOf(doc->editor);
+        const QString name = doc->filename.isEmpty() ? "untitled" : QFileInfo(doc->filename).fileName();
+        ui->tabScripts->setTabText(index, QString("%1%2").arg(doc->editor->document()->isModified() ? "*" : "").arg(name));
+        ui->tabScripts->setTabToolTip(index, QDir::toNativeSeparators(doc->filename));
+    }
+    if (currentDocument())
+        setWindowTitle(QString("%1 - %2").arg(ui->tabScripts->tabText(ui->tabScripts->currentIndex()), basetitle));
 }
 
 void MainWindow::clearPartPreviews () {
-    ui->svgBreadboard->load(QByteArray());
-    ui->svgPCB->load(QByteArray());
-    ui->svgSchematic->load(QByteArray());
+    for (PreviewView *view : views)
+        if (view)
+            view->clear();
 }
 
-static bool matches (const QStringList &tokens, QString command, int minparms = -1, int maxparms = -1) {
-    if (tokens.empty() || QString::compare(tokens[0], command, Qt::CaseInsensitive))
-        return false;
-    int parms = tokens.size() - 1;
-    if (minparms < 0)
-        return true;
-    if (parms < minparms)
-        return false;
-    if (maxparms < 0)
-        maxparms = minparms;
-    if (parms > maxparms)
-        return false;
-    return true;
-}
-
-
-static bool matches (const QStringList &tokens, QStringList commands, int minparms = -1, int maxparms = -1) {
-    for (const auto &command : commands)
-        if (matches(tokens, command, minparms, maxparms))
-            return true;
-    return false;
-}
-
-
-static double parseCoord (double cur, QString coord) {
-    if (coord.startsWith("@"))
-        return cur + coord.mid(1).toDouble();
-    else
-        return coord.toDouble();
-}
-
-static bool parseBool (QString str) {
-    static QStringList trues = { "true", "yes", "on", "1" };
-    static QStringList falses = { "false", "no", "off", "0" };
-    if (trues.contains(str, Qt::CaseInsensitive))
-        return true;
-    else if (falses.contains(str, Qt::CaseInsensitive))
-        return false;
-    else
-        throw std::runtime_error(QString("invalid boolean value: %1").arg(str).toStdString());
+// the ui just has empty placeholders; the preview views go in them on first use.
+void MainWindow::createPartPreviews () {
+    if (views[0])
+        return;
+    auto create = [](QWidget *placeholder) {
+        PreviewView *view = new PreviewView(placeholder);
+        QVBoxLayout *layout = new QVBoxLayout(placeholder);
+        layout->setContentsMargins(0, 0, 0, 0);
+        layout->addWidget(view);
+        return view;
+    };
+    views[PreviewBreadboard] = create(ui->previewBreadboard);
+    views[PreviewSchematic] = create(ui->previewSchematic);
+    views[PreviewPCB] = create(ui->previewPCB);
+    // pins, pcb holes and silkscreen markings can be clicked to find their script line.
+    for (int n = 0; n < PreviewCount; ++ n) {
+        views[n]->setProbeTargets(QRegularExpression("^(connector\\d+pin|nonconn\\d+|mark\\d+)$"));
+        connect(views[n], &PreviewView::probed, this, &MainWindow::previewProbed);
+        connect(views[n], &PreviewView::activated, this, [this, n] () { recentview = n; });
+    }
 }
 
 void MainWindow::on_actCompile_triggered()
 {
-    try {
-        Part part = compile();
-        QString defpath = (curfilename == "" ? QStandardPaths::writableLocation(QStandardPaths::DocumentsLocation) : curfilename);
-        saveBasicPart(part, PartFilenames(part.filename, defpath));
-    } catch (const std::exception &x) {
-        QMessageBox::critical(this, "Error Compiling Part", x.what());
-    }
+    startBuild(false);
 }
 
 void MainWindow::on_actCompileTo_triggered()
 {
-    try {
-        Part part = compile();
-        QString defpath = (curfilename == "" ? QStandardPaths::writableLocation(QStandardPaths::DocumentsLocation) : curfilename);
-        PartFilenames names(part.filename, defpath);
-        names.fzpz = QFileDialog::getSaveFileName(this, "Compile To", names.fzpz, "Fritzing Part (*.fzpz)");
-        if (names.fzpz == "")
-            return;
-        saveBasicPart(part, names);
-    } catch (const std::exception &x) {
-        QMessageBox::critical(this, "Error Compiling Part", x.what());
-    }
+    startBuild(true);
 }
 
-void MainWindow::on_actPreview_triggered()
+void MainWindow::on_actCancelBuild_triggered()
 {
-    try {
-        Part part = compile();
-        showPartPreviews(part);
-    } catch (const std::exception &x) {
-        QMessageBox::critical(this, "Error Compiling Part", x.what());
-    }
+    buildcancel.storeRelaxed(1);
+    queuedbuild = NoBuild;
+    statusBar()->showMessage("Cancelling build...");
 }
 
-template <typename T>
-static void setDeferredPos (double width, double height, QList<T> &things) {
-    for (T &thing : things) {
-        if (!thing.origleft) {
-            thing.origleft = true;
-            thing.x = width - thing.x;
-        }
-        if (!thing.origtop) {
-            thing.origtop = true;
-            thing.y = height - thing.y;
-        }
+// builds run in two background stages: compile (on a copy of the compiler, which is
+// adopted afterwards so the next compile is still incremental, unless the script was
+// edited meanwhile), then generate and archive. both stop early on a cancel. the gui
+// thread only asks for filenames in between. asking for another build while one is
+// running just queues it; any number of requests make one more build.
+void MainWindow::startBuild (bool ask) {
+
+    if (building) {
+        queuedbuild = (ask || queuedbuild == BuildCompileTo) ? BuildCompileTo : BuildCompile;
+        statusBar()->showMessage("Build queued.");
+        return;
     }
-}
 
-template <>
-void setDeferredPos<Marking> (double width, double height, QList<Marking> &things) {
-    for (Marking &thing : things) {
-        if (!thing.origleft) {
-            thing.x1reverse = !thing.x1reverse;
-            thing.x2reverse = !thing.x2reverse;
+    building = true;
+    buildask = ask;
+    buildcancel.storeRelaxed(0);
+    buildmem = memCounters();
+    ui->actCancelBuild->setEnabled(true);
+
+    builddoc = currentDocument();
+    PartCompiler worker = builddoc->compiler;
+    const QString text = builddoc->editor->toPlainText();
+    const int revision = builddoc->revision;
+    const QAtomicInt *cancel = &buildcancel;
+    buildProgress("Compiling...");
+    compiling.setFuture(QtConcurrent::run([worker, text, revision, cancel] () mutable {
+        CompileResult result;
+        result.revision = revision;
+        try {
+            result.part = worker.compile(text);
+            if (worker.variantCount() > 1)
+                for (const PartVariant &variant : worker.compileVariants(text, cancel))
+                    result.variants.append(variant.part);
+            else if (worker.partCount() > 1)
+                result.variants = worker.compileParts(text, cancel);
+        } catch (const std::exception &x) {
+            result.error = x.what();
         }
-        if (!thing.origtop) {
-            thing.y1reverse = !thing.y1reverse;
-            thing.y2reverse = !thing.y2reverse;
-        }
-        if (thing.x1reverse) thing.x1 = width - thing.x1;
-        if (thing.x2reverse) thing.x2 = width - thing.x2;
-        if (thing.y1reverse) thing.y1 = height - thing.y1;
-        if (thing.y2reverse) thing.y2 = height - thing.y2;
-        thing.x1reverse = thing.x2reverse = false;
-        thing.y1reverse = thing.y2reverse = false;
-        thing.origleft = thing.origtop = true;
-    }
+        result.compiler = worker;
+        return result;
+    }));
+
 }
 
-Part MainWindow::compile() {
+// safe to call from any thread.
+void MainWindow::buildProgress (const QString &message) {
+    QMetaObject::invokeMethod(this, [this, message] () {
+        statusBar()->showMessage(message);
+    }, Qt::QueuedConnection);
+}
 
-    QList<QStringList> scriptlines;
-    Part part;
+void MainWindow::buildCompiled () {
 
-    // ---- tokenize
+    CompileResult result = compiling.result();
+    Document *doc = builddoc;
+    // edited while compiling: this compiler is already behind, so keep the document's.
+    if (result.revision == doc->revision)
+        doc->compiler = result.compiler;
 
-    QString text = ui->txtScript->toPlainText();
-    QTextStream script(&text, QIODevice::ReadOnly);
-    QString line;
-    bool indesc = false;
-    while (script.readLineInto(&line)) {
-        // multiline description is special case
-        QString tline = line.trimmed();
-        if (!indesc && !tline.compare("description:", Qt::CaseInsensitive)) {
-            indesc = true;
-            continue;
-        } else if (indesc && !tline.compare(":description", Qt::CaseInsensitive)) {
-            indesc = false;
-            continue;
-        } else if (indesc) {
-            scriptlines.push_back({ "description", tline == "" ? "" : line });
-            continue;
-        }
-        // end description handling
-        QStringList tokens;
-        std::wistringstream liner(line.toStdWString()); // todo: switch to utf32
-        while (!liner.eof()) {
-            std::wstring token;
-            liner >> std::quoted(token);
-            tokens.append(QString::fromStdWString(token));
-        }
-        while (!tokens.empty() && tokens.back() == "")
-            tokens.pop_back();
-        if (!tokens.empty() && !tokens[0].startsWith("#"))
-            scriptlines.append(tokens);
+    if (buildcancel.loadRelaxed()) {
+        finishBuild("Build cancelled.");
+        return;
     }
-    if (indesc)
-        throw std::runtime_error("end of file in multiline description block");
-
-    // ---- parse
-
-    QStringList metakeys = { "version", "author", "title", "label", "family", "partnumber", "variant", "url", /*"description",*/ "moduleid" };
-
-    double curhole = 0.9, curring = 0.508, curx = 0, cury = 0;
-    int curnumber = 1;
-    bool origleft = true, origtop = false, gotpcbms = false;
-    for (const QStringList &tokens : scriptlines) {
-        if (matches(tokens, "units", 1))
-            part.units = tokens[1].toLower();
-        else if (matches(tokens, "width", 1))
-            part.width = tokens[1].toDouble();
-        else if (matches(tokens, "height", 1))
-            part.height = tokens[1].toDouble();
-        else if (matches(tokens, "outline", 1))
-            part.outline = tokens[1].toDouble();
-        else if (matches(tokens, "pthhole", 1))
-            curhole = tokens[1].toDouble();
-        else if (matches(tokens, "pthring", 1))
-            curring = tokens[1].toDouble();
-        else if (matches(tokens, "pin", 2, 4)) {
-            Pin pin;
-            pin.hole = curhole;
-            pin.ring = curring;
-            pin.x = parseCoord(curx, tokens[1]);
-            pin.y = parseCoord(cury, tokens[2]);
-            pin.name = tokens.value(3).trimmed();
-            pin.square = !QString::compare(tokens.value(4), "square", Qt::CaseInsensitive);
-            pin.number = (curnumber ++);
-            pin.origleft = origleft; // have to store and then change origin later since
-            pin.origtop = origtop;   // width / height may not have been defined yet.
-            part.pins.append(pin);
-            curx = pin.x;
-            cury = pin.y;
-        } else if (matches(tokens, "pcbhole", 3)) {
-            Hole hole;
-            hole.x = parseCoord(curx, tokens[1]);
-            hole.y = parseCoord(cury, tokens[2]);
-            hole.diameter = fabs(tokens[3].toDouble());
-            //hole.ring = (tokens.size() > 4 ? fabs(tokens[4].toDouble()) : 0); // todo; maybe
-            hole.origleft = origleft; // same deal as with pins above
-            hole.origtop = origtop;
-            part.pcbholes.append(hole);
-            curx = hole.x;
-            cury = hole.y;
-        } else if (matches(tokens, "color", 1))
-            part.color = tokens[1];
-        else if (matches(tokens, "corner", 1))
-            part.corner = tokens[1].toDouble();
-        else if (matches(tokens, "schematic", 1, 2)) {
-            part.schematic = tokens[1].toLower();
-            part.schematicmod = (tokens.size() > 2 ? tokens[2].toLower() : "");
-        } else if (matches(tokens, "scminsize", 2)) {
-            part.mingrid[0] = tokens[1].toInt() - 1;
-            part.mingrid[1] = tokens[2].toInt() - 1;
-        } else if (matches(tokens, "scgrow", 2)) {
-            part.extragrid[0] = abs(tokens[1].toInt());
-            part.extragrid[1] = abs(tokens[2].toInt());
-        } else if (matches(tokens, "sctext", 1)) {
-            part.sctext = tokens[1];
-        } else if (matches(tokens, "sclabels", 1)) {
-            part.scpinlabels = parseBool(tokens[1]);
-        } else if (matches(tokens, "scnumbers", 1)) {
-            part.scpinnumbers = parseBool(tokens[1]);
-        } else if (matches(tokens, "bbtext", 1, 3)) {
-            part.bbtext = tokens[1];
-            if (tokens.size() > 2) part.bbtextcolor = tokens[2];
-            if (tokens.size() > 3) part.bbtextsize = tokens[3].toDouble();
-        } else if (matches(tokens, "bblabels", 1, 3)) {
-            part.bbpinlabels = parseBool(tokens[1]);
-            if (tokens.size() > 2) part.bbpinlabelcolor = tokens[2];
-            if (tokens.size() > 3) part.bbpinlabelsize = tokens[3].toDouble();
-        } else if (matches(tokens, "origin", 1, INT_MAX)) {
-            for (int n = 1; n < tokens.size(); ++ n) {
-                if (tokens[n].startsWith("l", Qt::CaseInsensitive))
-                    origleft = true;
-                else if (tokens[n].startsWith("r", Qt::CaseInsensitive))
-                    origleft = false;
-                else if (tokens[n].startsWith("t", Qt::CaseInsensitive))
-                    origtop = true;
-                else if (tokens[n].startsWith("b", Qt::CaseInsensitive))
-                    origtop = false;
-            }
-        } else if (matches(tokens, metakeys, 1)) {
-            part.metadata[tokens[0].toLower()] = tokens[1].trimmed();
-        } else if (matches(tokens, "description", 0, 1)) {
-            part.metadata["description"] = part.metadata["description"] + tokens.value(1) + "\n";
-        } else if (matches(tokens, "filename", 1))
-            part.filename = tokens[1];
-        else if (matches(tokens, "property", 1, 2))
-            part.metaprops[tokens[1]] = tokens.value(2);
-        else if (matches(tokens, "tag", 1, INT_MAX) || matches(tokens, "tags", 1, INT_MAX)) {
-            for (int n = 1; n < tokens.size(); ++ n)
-                part.metatags.append(tokens[n]);
-        } else if (matches(tokens, "pcbstroke", 1)) {
-            gotpcbms = true;
-            part.pcbmarkstroke = tokens[1].toDouble();
-        } else if (matches(tokens, "pcbline", 4)) {
-            double x1 = tokens[1].toDouble();
-            double y1 = tokens[2].toDouble();
-            double x2 = tokens[3].toDouble();
-            double y2 = tokens[4].toDouble();
-            part.pcbmarks.append(Marking::makeLine(x1, y1, x2, y2, origleft, origtop));
-        } else if (matches(tokens, "pcbhline", 1)) {
-            double y = tokens[1].toDouble();
-            Marking mark = Marking::makeLine(0, y, 0, y, origleft, origtop);
-            mark.capped = false;
-            mark.x2reverse = true;
-            mark.xbackoff = true;
-            part.pcbmarks.append(mark);
-        } else if (matches(tokens, "pcbvline", 1)) {
-            double x = tokens[1].toDouble();
-            Marking mark = Marking::makeLine(x, 0, x, 0, origleft, origtop);
-            mark.capped = false;
-            mark.y2reverse = true;
-            mark.ybackoff = true;
-            part.pcbmarks.append(mark);
-        } else if (matches(tokens, "pcbdot", 3)) {
-            double x = tokens[1].toDouble();
-            double y = tokens[2].toDouble();
-            double d = tokens[3].toDouble();
-            part.pcbmarks.append(Marking::makeCircle(x, y, d, origleft, origtop));
-        //} else if (matches(tokens, "pcbarrows", 3, 4)) { // arrowedge edge arrowwidth arrowlength [count=1]
-        } else
-            throw std::runtime_error(QString("unknown directive: %1").arg(tokens.join(",")).toStdString());
+    if (result.error != "") {
+        finishBuild(QString());
+        QMessageBox::critical(this, "Error Compiling Part", result.error);
+        return;
     }
 
-    // now that we probably have width/height, apply origin settings
-    setDeferredPos(part.width, part.height, part.pins);
-    setDeferredPos(part.width, part.height, part.pcbholes);
-    setDeferredPos(part.width, part.height, part.pcbmarks);
-
-    // same with hline/vline outline width correction
-    if (part.outline > 0) {
-        auto backoff = [](double &a, double &b, double off) {
-            if (a < b) { a += off; b -= off; }
-            else { a -= off; b += off; }
-        };
-        double off = part.outline; // / 2.0; // (in theory, /2 works; in practice, aisler sometimes messes it up)
-        for (Marking &m : part.pcbmarks) {
-            if (m.xbackoff) backoff(m.x1, m.x2, off);
-            if (m.ybackoff) backoff(m.y1, m.y2, off);
-            m.xbackoff = m.ybackoff = false;
+    // module ids have to be unique across the library; check before building anything.
+    try {
+        if (LibraryIndex *index = libraryOf(doc->filename)) {
+            const QStringList problems = index->collisions(doc->filename, result.variants.empty() ? QList<Part>{ result.part } : result.variants);
+            if (!problems.empty())
+                throw std::runtime_error(problems.join("\n").toStdString());
         }
+    } catch (const std::exception &x) {
+        finishBuild(QString());
+        QMessageBox::critical(this, "Error Compiling Part", x.what());
+        return;
     }
 
-    // ---- fill in some defaults
-
-    auto getany = [&part](QStringList sourcekeys, QString planb) {
-        for (const QString &s : sourcekeys)
-            if (part.metadata.value(s) != "")
-                return part.metadata[s];
-        return planb;
-    };
+    ArchiveOptions options = ArchiveOptions::fromSettings();
+    options.cancel = &buildcancel;
+    const bool backup = ui->actBackup->isChecked();
+    const QString defpath = (doc->filename == "" ? QStandardPaths::writableLocation(QStandardPaths::DocumentsLocation) : doc->filename);
+
+    if (!result.variants.empty()) {
+        QString builddir = defpath;
+        if (buildask) {
+            builddir = QFileDialog::getExistingDirectory(this, "Compile Parts To", QFileInfo(defpath).isDir() ? defpath : QFileInfo(defpath).absolutePath());
+            if (builddir == "") {
+                finishBuild(QString());
+                return;
+            }
+        }
+        const QList<Part> parts = result.variants;
+        const QVector<bool> shown = previewsShown();
+        archiving.setFuture(QtConcurrent::run([this, doc, parts, shown, builddir, options, backup] () {
+            ArchiveResult archived;
+            archived.parts = parts;
+            try {
+                buildProgress("Generating previews...");
+                postPartPreviews(doc, parts.first(), shown);
+                buildProgress(QString("Building %1 parts...").arg(parts.size()));
+                QStringList fzpzs = writePartArchives(parts, builddir, options, backup);
+                archived.outdir = QFileInfo(fzpzs.first()).absolutePath();
+                archived.message = QString("Built %1 parts.").arg(parts.size());
+            } catch (const std::exception &x) {
+                archived.error = x.what();
+            }
+            return archived;
+        }));
+    } else {
+        PartFilenames names(result.part.filename, defpath);
+        if (buildask) {
+            names.fzpz = QFileDialog::getSaveFileName(this, "Compile To", names.fzpz, "Fritzing Part (*.fzpz)");
+            if (names.fzpz == "") {
+                finishBuild(QString());
+                return;
+            }
+        }
+        const Part part = result.part;
+        archiving.setFuture(QtConcurrent::run([this, doc, part, names, options, backup] () {
+            ArchiveResult archived;
+            archived.parts = { part };
+            try {
+                buildProgress("Generating...");
+                PartDocuments docs = generatePartDocuments(part, names);
+                postPartPreviews(doc, part, docs.breadboard, docs.schematic, docs.pcb);
+                buildProgress("Archiving...");
+                writePartArchive(docs, names, options, backup);
+                archived.outdir = QFileInfo(names.fzpz).absolutePath();
+                archived.message = QString("Built %1.").arg(QFileInfo(names.fzpz).fileName());
+            } catch (const std::exception &x) {
+                archived.error = x.what();
+            }
+            return archived;
+        }));
+    }
 
-    auto setdef = [&](QString key, QStringList sourcekeys, QString planb = QString()) {
-        if (part.metadata[key] == "")
-            part.metadata[key] = getany(sourcekeys, planb);
-    };
+}
 
-    auto metaval = [&part](QString value) {
-        if (value.startsWith("$"))
-            return part.metadata.value(value.mid(1).trimmed().toLower(), "???");
-        else
-            return value;
-    };
+void MainWindow::buildArchived () {
 
-    part.metadata["description"] = part.metadata["description"].trimmed();
+    ArchiveResult result = archiving.result();
 
-    if (part.filename == "")
-        part.filename = getany({ "moduleid", "title", "partnumber", "family" }, "");
-    if (part.filename == "") {
-        throw std::runtime_error("could not determine output filename: you must specify at "
-                                 "least one of: filename, moduleid, title, partnumber, or family");
+    if (buildcancel.loadRelaxed()) {
+        finishBuild("Build cancelled.");
+    } else if (result.error != "") {
+        finishBuild(QString());
+        QMessageBox::critical(this, "Error Compiling Part", result.error);
+    } else {
+        try {
+            if (LibraryIndex *index = libraryOf(builddoc->filename)) {
+                index->update(builddoc->filename, result.parts);
+                index->save();
+                librarytime = QFileInfo(LibraryIndex::indexFileName(index->root())).lastModified();
+            }
+        } catch (const std::exception &x) {
+            qDebug() << "library index:" << x.what();
+        }
+        finishBuild(memStatsEnabled() ? result.message + " " + memStatsSummary(memCounters() - buildmem) : result.message);
+        if (ui->actShowOutput->isChecked())
+            QDesktopServices::openUrl(QUrl::fromLocalFile(result.outdir));
     }
-    setdef("partnumber", { "title", "family" }, part.filename);
-    setdef("family", { "partnumber" });
-    setdef("title", { "partnumber", "family" });
-    setdef("variant", { "partnumber" }, "variant 1");
-    setdef("description", { "title" });
-    setdef("version", { }, "1");
-    setdef("label", { }, "U");
-    setdef("moduleid", { }, part.filename);
-    // url can be left blank
-
-    part.sctext = metaval(part.sctext);
-    part.bbtext = metaval(part.bbtext);
-
-    if (part.outline > 0 && !gotpcbms)
-        part.pcbmarkstroke = part.outline * 0.75;
-
-    // ----
-
-    qDebug() << "size" << part.width << part.height << part.units;
-    qDebug() << "outline" << part.outline;
-    for (const Pin &pin : part.pins)
-        qDebug() << "  pin" << pin.number << pin.name << "@" << pin.x << pin.y << "d=" << pin.hole << "r=" << pin.ring << (pin.square ? "square" : "round");
-
-    return part;
 
 }
 
-
-static QDomElement initDocument (QDomDocument &doc, QString root) {
-    QDomProcessingInstruction dec = doc.createProcessingInstruction("xml", "version=\"1.0\" encoding=\"UTF-8\" standalone=\"no\"");
-    QDomComment info = doc.createComment("Generated by fritzpart.");
-    QDomElement node = doc.createElement(root);
-    // hack alert
-    if (root == "svg")
-        node.setAttribute("xmlns", "http://www.w3.org/2000/svg");
-    // moving on...
-    doc.appendChild(dec);
-    doc.appendChild(info);
-    doc.appendChild(node);
-    return node;
+void MainWindow::finishBuild (const QString &message) {
+    building = false;
+    ui->actCancelBuild->setEnabled(false);
+    if (message != "")
+        statusBar()->showMessage(message);
+    else
+        statusBar()->clearMessage();
+    if (queuedbuild != NoBuild) {
+        bool ask = (queuedbuild == BuildCompileTo);
+        queuedbuild = NoBuild;
+        startBuild(ask);
+    }
 }
 
-
-static QDomElement appendElement (QDomNode node, QString tag, QString id = QString()) {
-    QDomElement el = node.ownerDocument().createElement(tag);
-    if (id != "")
-        el.setAttribute("id", id);
-    node.appendChild(el);
-    return el;
+Part MainWindow::compile () {
+    Document *doc = currentDocument();
+    return doc->compiler.compile(doc->editor->toPlainText());
 }
 
-
-static QDomElement appendElement (QDomNode node, QDomElement el) {
-    node.appendChild(el);
-    return el;
+void MainWindow::on_actPreview_triggered()
+{
+    try {
+        Part part = compile();
+        showPartPreviews(part);
+    } catch (const std::exception &x) {
+        QMessageBox::critical(this, "Error Compiling Part", x.what());
+    }
 }
 
-
-template <typename T>
-static QString pretty (T p) {
-    return QString("%1").arg(p);
+bool MainWindow::previewShown (int view) const {
+    const QAction *actions[PreviewCount] = { ui->actShowBreadboard, ui->actShowSchematic, ui->actShowPCB };
+    return actions[view]->isChecked();
 }
 
-struct SVGStyle {
-    QString fill;
-    QString stroke;
-    double strokeWidth;
-};
-
-static QDomElement svgLine (QDomDocument doc, QString id, double x1, double y1, double x2, double y2, const SVGStyle &style, bool roundCaps = false) {
-    QDomElement line = doc.createElement("line");
-    if (id != "")
-        line.setAttribute("id", id);
-    line.setAttribute("x1", pretty(x1));
-    line.setAttribute("y1", pretty(y1));
-    line.setAttribute("x2", pretty(x2));
-    line.setAttribute("y2", pretty(y2));
-    line.setAttribute("fill", style.fill);
-    line.setAttribute("stroke", style.stroke);
-    line.setAttribute("stroke-width", pretty(style.strokeWidth));
-    if (roundCaps)
-        line.setAttribute("stroke-linecap", "round");
-    return line;
+QVector<bool> MainWindow::previewsShown () const {
+    QVector<bool> shown;
+    for (int view = 0; view < PreviewCount; ++ view)
+        shown.append(previewShown(view));
+    return shown;
 }
 
-static QDomElement svgRect (QDomDocument doc, QString id, double x, double y, double w, double h, const SVGStyle &style, bool borderInside = false) {
-    QDomElement rect = doc.createElement("rect");
-    if (id != "")
-        rect.setAttribute("id", id);
-    rect.setAttribute("fill", style.fill);
-    rect.setAttribute("stroke", style.stroke);
-    rect.setAttribute("stroke-width", pretty(style.strokeWidth));
-    if (borderInside) {
-        rect.setAttribute("x", pretty(x + style.strokeWidth / 2.0));
-        rect.setAttribute("y", pretty(y + style.strokeWidth / 2.0));
-        rect.setAttribute("width", pretty(w - style.strokeWidth));
-        rect.setAttribute("height", pretty(h - style.strokeWidth));
-    } else {
-        rect.setAttribute("x", pretty(x - style.strokeWidth / 2.0));
-        rect.setAttribute("y", pretty(y - style.strokeWidth / 2.0));
-        rect.setAttribute("width", pretty(w + style.strokeWidth));
-        rect.setAttribute("height", pretty(h + style.strokeWidth));
-    }
-    return rect;
-}
-
-static QDomElement svgCircle (QDomDocument doc, QString id, double cx, double cy, double r, const SVGStyle &style, bool borderInside = false) {
-    QDomElement circle = doc.createElement("circle");
-    if (id != "")
-        circle.setAttribute("id", id);
-    circle.setAttribute("fill", style.fill);
-    circle.setAttribute("stroke", style.stroke);
-    circle.setAttribute("stroke-width", pretty(style.strokeWidth));
-    circle.setAttribute("cx", pretty(cx));
-    circle.setAttribute("cy", pretty(cy));
-    if (borderInside)
-        circle.setAttribute("r", pretty(r - style.strokeWidth / 2.0));
+QByteArray MainWindow::generatePreview (const Part &part, int view) {
+    if (view == PreviewBreadboard)
+        return generateBreadboard(part).toByteArray();
+    else if (view == PreviewSchematic)
+        return generateSchematic(part).toByteArray();
     else
-        circle.setAttribute("r", pretty(r + style.strokeWidth / 2.0));
-    return circle;
+        return generatePCB(part).toByteArray();
 }
 
-enum SVGTextAlign { LeftAlign, CenterAlign, RightAlign, BottomCenterAlign, TopCenterAlign };
-
-struct SVGTextStyle {
-    QString color;
-    double size;
-};
-
-static const char * svgTextAnchor (SVGTextAlign align) {
-    switch (align) {
-    case LeftAlign: return "start";
-    case TopCenterAlign: return "middle";
-    case BottomCenterAlign: return "middle";
-    case CenterAlign: return "middle";
-    case RightAlign: return "end";
-    default: return "";
-    }
+void MainWindow::previewVisibilityChanged () {
+    settings.setValue("showbreadboard", ui->actShowBreadboard->isChecked());
+    settings.setValue("showschematic", ui->actShowSchematic->isChecked());
+    settings.setValue("showpcb", ui->actShowPCB->isChecked());
+    ui->frame_2->setVisible(previewShown(PreviewBreadboard));
+    ui->frame_4->setVisible(previewShown(PreviewSchematic));
+    ui->frame_3->setVisible(previewShown(PreviewPCB));
+    ui->frame->setVisible(previewsShown().contains(true));
+    if (views[0])
+        refreshPreviews();
 }
 
-
-static QDomElement svgText (QDomDocument doc, QString content, double x, double y, const SVGTextStyle &style, SVGTextAlign align, double rotate = 0) {
-    QDomElement text = doc.createElement("text");
-    text.setAttribute("font-family", "'Droid Sans'");
-    text.setAttribute("stroke", "none");
-    text.setAttribute("stroke-width", 0);
-    text.setAttribute("fill", style.color);
-    text.setAttribute("font-size", pretty(style.size));
-    // Droid Sans cap-height / 2 = 0.357  (also x-height / 2 = 0.268)
-    double voffset = style.size * 0.357;
-    if (align == BottomCenterAlign)
-        voffset = 0;
-    else if (align == TopCenterAlign)
-        voffset = style.size;
-    if (fabs(rotate) > 1e-5) {
-        QString voffsettr = (fabs(voffset > 1e-5) ? QString(" translate(0,%1)").arg(voffset) : "");
-        text.setAttribute("transform", QString("translate(%1,%2) rotate(%3)%4")
-                          .arg(x).arg(y).arg(rotate).arg(voffsettr));
-    } else {
-        text.setAttribute("x", pretty(x));
-        text.setAttribute("y", pretty(y + voffset));
-    }
-    text.setAttribute("text-anchor", svgTextAnchor(align));
-    //text.setAttribute("dominant-baseline", "middle"); // fritzing ignores this :(
-    //text.setAttribute("dy", "0.5ex"); // it ignores dy too
-    // ^ see https://github.com/fritzing/fritzing-app/issues/3909
-    text.appendChild(doc.createTextNode(content));
-    return text;
+void MainWindow::showPartPreviews (const Part &part) {
+    Document *doc = currentDocument();
+    doc->tried = doc->revision;
+    doc->error = QString();
+    setPartPreviews(doc, part, QVector<QByteArray>(PreviewCount));
 }
 
-
-static QDomDocument generatePCB (const Part &part) {
-
-    QDomDocument svg;
-    QDomElement root = initDocument(svg, "svg");
-    QDomElement silkscreen = appendElement(root, "g", "silkscreen");
-    QDomElement copper = appendElement(appendElement(root, "g", "copper0"), "g", "copper1");
-
-    root.setAttribute("version", "1.1");
-    root.setAttribute("x", 0);
-    root.setAttribute("y", 0);
-    root.setAttribute("width", QString("%1%2").arg(part.width).arg(part.units));
-    root.setAttribute("height", QString("%1%2").arg(part.height).arg(part.units));
-    root.setAttribute("viewBox", QString("0 0 %1 %2").arg(part.width).arg(part.height));
-    root.setAttribute("id", "svg");
-
-    if (part.outline > 0) {
-        SVGStyle stsilk = { "none", "#000000", part.outline };
-        silkscreen.appendChild(svgRect(svg, "outline", 0, 0, part.width, part.height, stsilk, true));
-    }
-
-    for (const Pin &pin : part.pins) {
-        double r = pin.hole / 2.0;
-        QString id = QString("connector%1pin").arg(pin.number - 1);
-        SVGStyle stpad = { "none", "#f7bd13", pin.ring };
-        QDomElement circle = svgCircle(svg, "", pin.x, pin.y, r, stpad);
-        QDomElement pad;
-        if (pin.square) {
-            circle.setAttribute("id", id + "_circle");
-            QDomElement square = svgRect(svg, id + "_square", pin.x - r, pin.y - r, pin.hole, pin.hole, stpad);
-            QDomElement group = svg.createElement("g");
-            group.appendChild(square);
-            group.appendChild(circle);
-            pad = group;
-        } else {
-            pad = circle;
+// keeps the part and whatever previews were made for it with the document, and shows
+// them if it's the current one. the element ids here match what partgen gives pins,
+// holes and markings.
+void MainWindow::setPartPreviews (Document *doc, const Part &part, const QVector<QByteArray> &svgs) {
+    doc->part = part;
+    ++ doc->partserial;
+    doc->svgs = svgs;
+    doc->lineids.clear();
+    doc->idlines.clear();
+    auto add = [doc] (int line, const QString &id) {
+        if (line >= 0) {
+            doc->lineids.insert(line, id);
+            doc->idlines.insert(id, line);
         }
-        pad.setAttribute("id", id);
-        copper.appendChild(pad);
-    }
-
-    for (int n = 0; n < part.pcbholes.size(); ++ n) {
-        const Hole &hole = part.pcbholes[n];
-        QString id = QString("nonconn%1").arg(n);
-        SVGStyle sthole = { "black", "black", 0 };
-        copper.appendChild(svgCircle(svg, id, hole.x, hole.y, hole.diameter / 2.0, sthole));
-    }
-
-    if (part.pcbmarkstroke > 0) {
-        for (const Marking &mark : part.pcbmarks) {
-            if (mark.shape == Marking::Circle) {
-                double stroke = qMin(part.pcbmarkstroke, mark.diam / 2.0);
-                if (stroke < 1e-6)
-                    continue;
-                SVGStyle stmark = { "none", "#000000", stroke };
-                silkscreen.appendChild(svgCircle(svg, "", mark.x1, mark.y1, mark.diam/2.0, stmark, true));
-            } else if (mark.shape == Marking::Line) {
-                SVGStyle stmark = { "none", "#000000", part.pcbmarkstroke };
-                silkscreen.appendChild(svgLine(svg, "", mark.x1, mark.y1, mark.x2, mark.y2, stmark, mark.capped));
-            }
-        }
-    }
-
-    return svg;
-
+    };
+    for (const Pin &pin : part.pins)
+        add(pin.line, QString("connector%1pin").arg(pin.number - 1));
+    for (int n = 0; n < part.pcbholes.size(); ++ n)
+        add(part.pcbholes[n].line, QString("nonconn%1").arg(n));
+    for (int n = 0; n < part.pcbmarks.size(); ++ n)
+        add(part.pcbmarks[n].line, QString("mark%1").arg(n));
+    if (doc == currentDocument())
+        refreshPreviews();
 }
 
+// shows the current document's part in the previews that are showing. the first of
+// them (the one used last, if it's showing) is made right here if it doesn't exist yet,
+// so it's ready first; the other showing ones are made in the background straight
+// away, and hidden ones once editing has been idle for a bit.
+void MainWindow::refreshPreviews () {
 
-static QDomDocument generateBreadboard (const Part &part, QString layername = "breadboard" /* for now, while we're using it for icon too */) {
-
-    QDomDocument svg;
-    QDomElement root = initDocument(svg, "svg");
-    QDomElement bboard = appendElement(root, "g", layername);
+    Document *doc = currentDocument();
+    if (!doc || doc->partserial == 0) {
+        clearPartPreviews();
+        previewdoc = nullptr;
+        return;
+    }
 
-    root.setAttribute("version", "1.1");
-    root.setAttribute("x", 0);
-    root.setAttribute("y", 0);
-    root.setAttribute("width", QString("%1%2").arg(part.width).arg(part.units));
-    root.setAttribute("height", QString("%1%2").arg(part.height).arg(part.units));
-    root.setAttribute("viewBox", QString("0 0 %1 %2").arg(part.width).arg(part.height));
-    root.setAttribute("id", "svg");
+    createPartPreviews();
+    QList<int> order = { recentview };
+    for (int view = 0; view < PreviewCount; ++ view)
+        if (view != recentview)
+            order.append(view);
 
-    if (part.outline > 0) {
-        SVGStyle st = { part.color, "#000000", part.outline };
-        QDomElement rect = appendElement(bboard, svgRect(svg, "part", 0, 0, part.width, part.height, st, true));
-        if (part.corner > 0) {
-            rect.setAttribute("rx", part.corner);
-            rect.setAttribute("ry", part.corner);
+    bool first = true, hidden = false;
+    for (int view : order) {
+        if (!previewShown(view)) {
+            hidden = hidden || doc->svgs[view].isEmpty();
+            continue;
         }
-    }
-
-    for (const Pin &pin : part.pins) {
-        QDomElement conn = appendElement(bboard, "g");
-        conn.setAttribute("transform", QString("translate(%1,%2)").arg(pin.x).arg(pin.y));
-        double r = pin.hole / 2.0;
-        QString id = QString("connector%1pin").arg(pin.number - 1);
-        SVGStyle stpad = { "#8c8c8c", "none", 0 };
-        QDomElement pad;
-        if (pin.square)
-            pad = svgRect(svg, id, -r, -r, pin.hole, pin.hole, stpad);
-        else
-            pad = svgCircle(svg, id, 0, 0, r, stpad);
-        conn.appendChild(pad);
-        if (part.bbpinlabels && pin.name != "") {
-            SVGTextStyle tstlabel = { part.bbpinlabelcolor, part.bbpinlabelsize };
-            const double inset = r + 0.35 * part.bbpinlabelsize; // i guess.
-            // sloppily find closest edge
-            struct EdgeMetrics { double e, dx, dy, rot; SVGTextAlign align; } metrics[] = {
-              { fabs(pin.x), 1, 0, 0, LeftAlign },
-              { fabs(part.width - pin.x), -1, 0, 0, RightAlign },
-              { fabs(pin.y), 0, 1, -90, RightAlign },
-              { fabs(part.height - pin.y), 0, -1, -90, LeftAlign }
-            };
-            EdgeMetrics *m = std::min_element(metrics, metrics + 4, [](auto &a, auto &b){return a.e<b.e;});
-            // well that was the weirdest code i've written in a while.
-            // todo: need a better way to control where these end up
-            conn.appendChild(svgText(svg, pin.name, m->dx*inset, m->dy*inset, tstlabel, m->align, m->rot));
+        try {
+            if (first && doc->svgs[view].isEmpty())
+                doc->svgs[view] = generatePreview(doc->part, view);
+        } catch (const std::exception &x) {
+            statusBar()->showMessage(x.what());
         }
+        first = false;
+        // one that's still coming keeps showing what it had, unless that was another script.
+        if (!doc->svgs[view].isEmpty())
+            views[view]->setContent(doc->svgs[view]);
+        else if (previewdoc != doc)
+            views[view]->clear();
     }
-
-    if (part.bbtext != "") {
-        SVGTextStyle tstpart = { part.bbtextcolor, part.bbtextsize };
-        bboard.appendChild(svgText(svg, part.bbtext, part.width / 2.0, part.height / 2.0, tstpart, CenterAlign));
-    }
-
-    return svg;
+    previewdoc = doc;
+    queueShownPreviews(doc);
+    if (hidden)
+        idletimer.start();
+    caretMoved();
 
 }
 
+// starts making the showing previews that are still missing, unless they've already
+// been tried for this part. if something else is being made, previewsDeferred() gets
+// back to them.
+void MainWindow::queueShownPreviews (Document *doc) {
 
-static QDomDocument generateIcon (const Part &part) {
-
-    // just use breadboard image for now
-    return generateBreadboard(part, "icon");
+    if (deferring.isRunning())
+        return;
+    QList<int> missing;
+    for (int view = 0; view < PreviewCount; ++ view)
+        if (previewShown(view) && doc->svgs[view].isEmpty() && doc->queued[view] != doc->partserial)
+            missing.append(view);
+    if (!missing.empty())
+        deferPreviews(doc, missing, QThreadPool::globalInstance());
 
 }
 
-enum ScEdge { NoEdge = 0, Top, Bottom, Left, Right };
-
-struct ScPin {
-    int number;
-    int gridpos;
-    ScEdge edge;
-    QString name;
-    double pinpos;
-    ScPin () : number(-1), gridpos(-1), edge(NoEdge), pinpos(0) { }
-    explicit ScPin (const Pin &pin) : number(pin.number), gridpos(-1), edge(NoEdge), name(pin.name), pinpos(0) { }
-};
-
-enum ScStyle { Box, Header };
-enum ScHeaderStyle { Terminal, Male, Female };
-enum ScEdgeMode { HEdge, VEdge, HVEdge };
-
-struct ScPart {
-    int gridw;
-    int gridh;
-    QList<ScPin> pins;
-    bool haslpins;
-    bool hasrpins;
-    bool hastpins;
-    bool hasbpins;
-    ScPart () : gridw(0), gridh(0), haslpins(false), hasrpins(false), hastpins(false), hasbpins(false) { }
-};
-
-static ScPart scPlaceEdge (const Part &part, ScEdgeMode mode) {
-
-    ScPart sc;
+void MainWindow::generateDeferredPreviews () {
 
-    // ---- figure out quadrant and edge of pins
-
-    QList<ScPin> lpins[2], rpins[2], tpins[2], bpins[2];
-    for (const Pin &pin : part.pins) {
-        ScPin scpin(pin);
-        double ldist = fabs(pin.x);
-        double rdist = fabs(part.width - pin.x);
-        double tdist = fabs(pin.y);
-        double bdist = fabs(part.height - pin.y);
-        bool h;
-        // should the pin be horizontal or vertical?
-        if (mode == HVEdge)
-            h = qMin(ldist, rdist) < qMin(tdist, bdist);
-        else
-            h = (mode == HEdge);
-        // [0] is top or left half of edge, [1] is bottom or right half
-        if (h) {
-            scpin.pinpos = pin.y;
-            (ldist < rdist ? lpins : rpins)[tdist < bdist ? 0 : 1].append(scpin);
-        } else {
-            scpin.pinpos = pin.x;
-            (tdist < bdist ? tpins : bpins)[ldist < rdist ? 0 : 1].append(scpin);
-        }
+    Document *doc = currentDocument();
+    if (!doc || doc->partserial == 0)
+        return;
+    if (deferring.isRunning()) {
+        idletimer.start();
+        return;
     }
 
-    // ---- now pack all the pins into the grid
-
-    auto addpins = [](QList<ScPin> &scpins, QList<ScPin> pins[2], int nslots, ScEdge edge) {
-        assert(nslots >= pins[0].size() + pins[1].size());
-        // stable sort so pins at same location stay sorted by number.
-        std::stable_sort(pins[0].begin(), pins[0].end(), [](auto &a,auto &b){return a.pinpos<b.pinpos;}); // ascending!
-        std::stable_sort(pins[1].begin(), pins[1].end(), [](auto &a,auto &b){return b.pinpos<a.pinpos;}); // descending!
-        int pos = 0;
-        for (ScPin pin : pins[0]) {
-            pin.edge = edge;
-            pin.gridpos = (pos ++);
-            scpins.append(pin);
-        }
-        pos = nslots;
-        for (ScPin pin : pins[1]) {
-            pin.edge = edge;
-            pin.gridpos = (-- pos);
-            scpins.append(pin);
-        }
-        return (pins[0].size() + pins[1].size()) > 0;
-    };
-
-    sc.gridw = qMax(tpins[0].size() + tpins[1].size(), bpins[0].size() + bpins[1].size()) + part.extragrid[0];
-    sc.gridh = qMax(lpins[0].size() + lpins[1].size(), rpins[0].size() + rpins[1].size()) + part.extragrid[1];
-    sc.gridw = qMax(sc.gridw, part.mingrid[0]);
-    sc.gridh = qMax(sc.gridh, part.mingrid[1]);
-    sc.hastpins = addpins(sc.pins, tpins, sc.gridw, Top);
-    sc.hasbpins = addpins(sc.pins, bpins, sc.gridw, Bottom);
-    sc.haslpins = addpins(sc.pins, lpins, sc.gridh, Left);
-    sc.hasrpins = addpins(sc.pins, rpins, sc.gridh, Right);
-    // this sort isnt necessary, it's just to keep the svg a little more readable
-    std::sort(sc.pins.begin(), sc.pins.end(), [](auto &a,auto &b){return a.number<b.number;});
-
-    return sc;
+    QList<int> missing;
+    for (int view = 0; view < PreviewCount; ++ view)
+        if (doc->svgs[view].isEmpty())
+            missing.append(view);
+    if (!missing.empty())
+        deferPreviews(doc, missing, &backgroundpool);
 
 }
 
-
-static ScPart scPlaceLinear (const Part &part) {
-
-    ScPart sc;
-
-    int curpos = 0;
-    for (const Pin &pin : part.pins) {
-        ScPin scpin(pin);
-        scpin.gridpos = (curpos ++);
-        scpin.edge = Left;
-        sc.pins.append(scpin);
-    }
-
-    sc.gridw = 0;
-    sc.gridh = curpos;
-    sc.haslpins = true;
-
-    return sc;
-
-}
-
-
-static QDomDocument generateSchematic (const Part &part) {
-
-    // ---- generate schematic
-
-    ScPart sc;
-    ScStyle style = Box;
-    ScHeaderStyle hdrstyle = Terminal;
-    if (part.schematic == "hedge")
-        sc = scPlaceEdge(part, HEdge);
-    else if (part.schematic == "vedge")
-        sc = scPlaceEdge(part, VEdge);
-    else if (part.schematic == "edge")
-        sc = scPlaceEdge(part, HVEdge);
-    else if (part.schematic == "header") {
-        sc = scPlaceLinear(part);
-        style = Header;
-        if (part.schematicmod == "male")
-            hdrstyle = Male;
-        else if (part.schematicmod == "female")
-            hdrstyle = Female;
-        else if (part.schematicmod == "terminal" || part.schematicmod == "")
-            hdrstyle = Terminal;
-        else
-            throw std::runtime_error(QString("unknown schematic header type: %1").arg(part.schematicmod).toStdString());
-    } else if (part.schematic == "block")
-        sc = scPlaceLinear(part);
-    else
-        throw std::runtime_error(QString("unknown schematic type: %1").arg(part.schematic).toStdString());
-
-    qDebug() << "schematic:" << sc.gridw << "x" << sc.gridh;
-    for (const ScPin &pin : sc.pins)
-        qDebug() << pin.number << pin.edge << pin.name << pin.pinpos << pin.gridpos;
-
-    // ---- generate svg from schematic
-#define PIN_CAPS 1
-
-    QDomDocument svg;
-    QDomElement root = initDocument(svg, "svg");
-    root.setAttribute("version", "1.1");
-    root.setAttribute("id", "svg");
-
-    const SVGStyle stline = { "none", "#000000", 0.7 / 7.2 };
-    const SVGStyle stpin = { "none", "#555555", 0.7 / 7.2 };
-    const SVGStyle stterm = { "none", "none", 0 };
-    const SVGTextStyle tstpart = { "#000000", 10.0 * 4.25 / 72.0 };
-    const SVGTextStyle tstpin = { "#555555", 10.0 * 3.5 / 72.0 };
-    const SVGTextStyle tstnum = { "#555555", 10.0 * 2.5 / 72.0 };
-    constexpr double PinLabelInset = 0.15; // not in graphics standard
-    constexpr double PinNumberOffset = 0.1; // not in graphics standard
-
-    if (style == Header) {
-
-        // ==== header style
-
-        // build viewbox as we go; todo: also do this for Box schematics below. i wrote this
-        // Header bit after the Box bit so this is a litte cleaner.
-        QRectF rcbox;
-        const double halfstr = stline.strokeWidth / 2.0;
-
-        QDomElement schem = appendElement(root, "g", "schematic");
-        QDomElement bg = appendElement(schem, "g", "background");
-        QDomElement pins = appendElement(schem, "g", "pins");
-
-        // male/female pin metrics from fritzing's generic_[fe]male_pin_headers.
-        // terminal metrics from fritzing's camdenboss connectors (roughly).
-        constexpr double PHSize = (2.0 - 9.928 / 7.2), PVSize = (3.6 - 1.643) / 7.2;
-        constexpr double TRadius = 2.9 / 7.2;
-        // the 2.9's on the next line don't need to match the one above
-        constexpr double TBoxHDist = (0.252 + 12.2 - 7.072 - 2.9) / 7.2, TBoxVDist = (4.5 - 2.9) / 7.2; // to outer edge
-
-        for (const ScPin &pin : sc.pins) {
-            QString idpref = QString("connector%1").arg(pin.number - 1);
-            QDomElement conn = appendElement(pins, "g", idpref);
-            // - - generate pins and decorations in the box (0,-.5) - (2,.5)
-            conn.appendChild(svgRect(svg, idpref + "terminal", 0, 0, 1e-5, 1e-5, stterm));
-            conn.appendChild(svgLine(svg, idpref + "pin", 0, 0, 1, 0, stpin, PIN_CAPS ? true : false));
-            if (hdrstyle == Male) {
-                conn.appendChild(svgLine(svg, "", 1.0, 0, 2.0, 0, stline));
-                conn.appendChild(svgLine(svg, "", 2.0, 0, 2.0 - PHSize, PVSize, stline, true));
-                conn.appendChild(svgLine(svg, "", 2.0, 0, 2.0 - PHSize, -PVSize, stline, true));
-            } else if (hdrstyle == Female) {
-                conn.appendChild(svgLine(svg, "", 1.0, 0, 2.0 - PHSize, 0, stline));
-                conn.appendChild(svgLine(svg, "", 2.0 - PHSize, 0, 2.0, PVSize, stline, true));
-                conn.appendChild(svgLine(svg, "", 2.0 - PHSize, 0, 2.0, -PVSize, stline, true));
-            } else if (hdrstyle == Terminal) {
-                conn.appendChild(svgLine(svg, "", 1.0, 0, 2.0 - 2.0 * TRadius, 0, stline));
-                conn.appendChild(svgCircle(svg, "", 2.0 - TRadius, 0, TRadius + 0.5*stline.strokeWidth /* bah */, stline, true));
-            }
-            if (part.scpinnumbers)
-                conn.appendChild(svgText(svg, QString("%1").arg(pin.number), 0.5, -0.5*stpin.strokeWidth - PinNumberOffset, tstnum, BottomCenterAlign));
-            // - - set position
-            conn.setAttribute("transform", QString("translate(0,%1)").arg(pin.gridpos));
-            rcbox = QRectF(0, -0.5, 2, 1)
-                    .adjusted(-halfstr, -halfstr, halfstr, halfstr)
-                    .translated(0, pin.gridpos)
-                    .united(rcbox);
-        }
-
-        if (hdrstyle == Terminal) {
-            QRectF rcblock = QRectF(QPointF(-TRadius, -TRadius), QPointF(TRadius, sc.gridh+TRadius-1))
-                    .adjusted(-TBoxHDist, -TBoxVDist, TBoxHDist, TBoxVDist)
-                    .translated(2.0 - TRadius, 0.0);
-            bg.appendChild(svgRect(svg, "block", rcblock.x(), rcblock.y(), rcblock.width(), rcblock.height(), stline, true));
-            rcbox = rcbox.united(rcblock);
+// showing previews go in the global pool, so they don't wait behind (or run at the low
+// priority of) background compiles.
+void MainWindow::deferPreviews (Document *doc, const QList<int> &missing, QThreadPool *pool) {
+
+    for (int view : missing)
+        doc->queued[view] = doc->partserial;
+    const Part part = doc->part;
+    const int id = doc->id, serial = doc->partserial;
+    deferring.setFuture(QtConcurrent::run(pool, [id, serial, part, missing] () {
+        DeferredPreviews result = { id, serial, QVector<QByteArray>(PreviewCount) };
+        try {
+            for (int view : missing)
+                result.svgs[view] = generatePreview(part, view);
+        } catch (const std::exception &x) {
+            qDebug() << "deferred previews:" << x.what();
         }
+        return result;
+    }));
 
-        root.setAttribute("x", 0);
-        root.setAttribute("y", 0);
-        root.setAttribute("width", QString("%1in").arg(rcbox.width() * 0.1));
-        root.setAttribute("height", QString("%1in").arg(rcbox.height() * 0.1));
-        root.setAttribute("viewBox", QString("%1 %2 %3 %4")
-                          .arg(rcbox.x()).arg(rcbox.y()).arg(rcbox.width()).arg(rcbox.height()));
-
-        if (!bg.hasChildNodes()) // drop the background group if we didn't use it for anything
-            bg.parentNode().removeChild(bg);
-
-        // ==== end header style
+}
 
-    } else {
+MainWindow::Document * MainWindow::documentById (int id) const {
+    for (Document *doc : documents)
+        if (doc->id == id)
+            return doc;
+    return nullptr;
+}
 
-        // ==== box style
-
-        QRect rcbox(-1, -1, qMax(1, sc.gridw) + 1, qMax(1, sc.gridh) + 1);
-        QRectF rcpart = rcbox.adjusted(sc.haslpins ? -1 : 0,
-                                       sc.hastpins ? -1 : 0,
-                                       sc.hasrpins ? 1 : 0,
-                                       sc.hasbpins ? 1 : 0);
-
-#if PIN_CAPS
-        rcpart.adjust(-stpin.strokeWidth / 2.0, -stpin.strokeWidth / 2.0,
-                      stpin.strokeWidth / 2.0, stpin.strokeWidth / 2.0);
-#endif
-
-        root.setAttribute("x", 0);
-        root.setAttribute("y", 0);
-        root.setAttribute("width", QString("%1in").arg(rcpart.width() * 0.1));
-        root.setAttribute("height", QString("%1in").arg(rcpart.height() * 0.1));
-        root.setAttribute("viewBox", QString("%1 %2 %3 %4")
-                          .arg(rcpart.x()).arg(rcpart.y())
-                          .arg(rcpart.width()).arg(rcpart.height()));
-
-        QDomElement schem = appendElement(root, "g", "schematic");
-        QDomElement pins = appendElement(schem, "g", "pins");
-        QDomElement labels = appendElement(schem, "g", "labels");
-
-        for (const ScPin &scpin : sc.pins) {
-            QPoint p1, p2, pt;
-            QPointF pl, pn;
-            SVGTextAlign la = CenterAlign;
-            double lr = 0;
-            if (scpin.edge == Top) {
-                pt = p1 = QPoint(scpin.gridpos, rcbox.top() - 1);
-                pl = p2 = QPoint(scpin.gridpos, rcbox.top());
-                la = RightAlign;
-                lr = -90;
-                pl += QPointF(0, stline.strokeWidth + PinLabelInset);
-                pn = QPointF(p1 + p2) / 2.0 - QPointF(stpin.strokeWidth / 2.0 + PinNumberOffset, 0);
-            } else if (scpin.edge == Bottom) {
-                pl = p1 = QPoint(scpin.gridpos, rcbox.bottom() + 1);
-                pt = p2 = QPoint(scpin.gridpos, rcbox.bottom() + 2);
-                la = LeftAlign;
-                lr = -90;
-                pl -= QPointF(0, stline.strokeWidth + PinLabelInset);
-                pn = QPointF(p1 + p2) / 2.0 - QPointF(stpin.strokeWidth / 2.0 + PinNumberOffset, 0);
-            } else if (scpin.edge == Left) {
-                pt = p1 = QPoint(rcbox.left() - 1, scpin.gridpos);
-                pl = p2 = QPoint(rcbox.left(), scpin.gridpos);
-                la = LeftAlign;
-                pl += QPointF(stline.strokeWidth + PinLabelInset, 0);
-                pn = QPointF(p1 + p2) / 2.0 - QPointF(0, stpin.strokeWidth / 2.0 + PinNumberOffset);
-            } else if (scpin.edge == Right) {
-                pl = p1 = QPoint(rcbox.right() + 1, scpin.gridpos);
-                pt = p2 = QPoint(rcbox.right() + 2, scpin.gridpos);
-                la = RightAlign;
-                pl -= QPointF(stline.strokeWidth + PinLabelInset, 0);
-                pn = QPointF(p1 + p2) / 2.0 - QPointF(0, stpin.strokeWidth / 2.0 + PinNumberOffset);
+// fills in what's still missing, if the document is still open and its part hasn't
+// changed meanwhile, and shows it if it's showing. then the current document's showing
+// previews are caught up.
+void MainWindow::previewsDeferred () {
+
+    const DeferredPreviews result = deferring.result();
+    Document *target = documentById(result.docid);
+    if (target && target->partserial == result.partserial) {
+        bool shown = false;
+        for (int view = 0; view < PreviewCount; ++ view) {
+            if (!target->svgs[view].isEmpty() || result.svgs[view].isEmpty())
+                continue;
+            target->svgs[view] = result.svgs[view];
+            if (target == previewdoc && target == currentDocument() && previewShown(view)) {
+                views[view]->setContent(result.svgs[view]);
+                shown = true;
             }
-            QDomElement term = appendElement(pins, svgRect(svg, QString("connector%1terminal").arg(scpin.number - 1), pt.x(), pt.y(), 1e-5, 1e-5, stterm));
-            //term.setAttribute("class", "terminal");
-            QDomElement conn = appendElement(pins, "line", QString("connector%1pin").arg(scpin.number - 1));
-            // todo: you can use svgLine now
-            conn.setAttribute("x1", p1.x());
-            conn.setAttribute("y1", p1.y());
-            conn.setAttribute("x2", p2.x());
-            conn.setAttribute("y2", p2.y());
-            conn.setAttribute("fill", stpin.fill);
-            conn.setAttribute("stroke", stpin.stroke);
-            conn.setAttribute("stroke-width", pretty(stpin.strokeWidth));
-#if PIN_CAPS
-            conn.setAttribute("stroke-linecap", "round");
-#endif
-            //conn.setAttribute("class", "pin");
-            if (part.scpinlabels && scpin.name != "")
-                labels.appendChild(svgText(svg, scpin.name, pl.x(), pl.y(), tstpin, la, lr));
-            if (part.scpinnumbers)
-                labels.appendChild(svgText(svg, QString("%1").arg(scpin.number), pn.x(), pn.y(), tstnum, BottomCenterAlign, lr));
-            // todo: utility function to generate a pin; origin at part-side point, then use
-            // transform(rotate) for vertical ones.
-        }
-
-        QDomElement outline = appendElement(schem, svgRect(svg, "outline", rcbox.x(), rcbox.y(),
-                                                           rcbox.width(), rcbox.height(), stline, true));
-        //outline.setAttribute("rx", stline.strokeWidth / 2.0);
-        //outline.setAttribute("ry", stline.strokeWidth / 2.0);
-
-        if (part.sctext != "") {
-            QPointF center = QRectF(rcbox).center();
-            if (part.schematic == "block") // todo: really need to change those QRects to QRectFs.
-                labels.appendChild(svgText(svg, part.sctext, 1 + rcbox.right() - PinLabelInset, center.y(), tstpart, TopCenterAlign, 90));
-            else
-                labels.appendChild(svgText(svg, part.sctext, center.x(), center.y(), tstpart, CenterAlign));
         }
-
-        // === end box style
-
+        if (shown)
+            caretMoved();
     }
 
-    return svg;
-
-}
-
-
-static QDomElement appendSimple (QDomNode parent, QString tag, QString text) {
-    QDomElement el = parent.ownerDocument().createElement(tag);
-    el.appendChild(parent.ownerDocument().createTextNode(text));
-    parent.appendChild(el);
-    return el;
-}
-
-
-static QDomDocument generateFZP (const Part &part, const PartFilenames &names) {
-
-    QDomDocument fzp;
-    QDomElement module = initDocument(fzp, "module");
-    module.setAttribute("referenceFile", names.fzp);
-    module.setAttribute("fritzingVersion", "0.9.9");
-    module.setAttribute("moduleId", part.metadata["moduleid"]);
-
-    appendSimple(module, "version", part.metadata["version"]);
-    appendSimple(module, "author", part.metadata["author"]);
-    appendSimple(module, "title", part.metadata["title"]);
-    appendSimple(module, "label", part.metadata["label"]);
-    appendSimple(module, "date", QDate::currentDate().toString());
-    //appendSimple(module, "taxonomy", QString("part.dip.%1.pins").arg(part.pins.size())); // todo: ???
-    appendSimple(module, "description", part.metadata["description"]);
-    appendSimple(module, "url", part.metadata["url"]);
-
-    QDomElement tags = appendElement(module, "tags");
-    for (const QString &tag : part.metatags)
-        appendSimple(tags, "tag", tag);
-
-    // todo: fix the case-sensitive weirdness lurking in here
-    PropertyMap outprops = part.metaprops;
-    outprops["family"] = part.metadata.getValue("family", outprops["family"]);
-    outprops["variant"] = part.metadata.getValue("variant", outprops["variant"]);
-    outprops["part number"] = part.metadata.getValue("partnumber", outprops["part number"]);
-
-    QDomElement props = appendElement(module, "properties");
-    /*
-    appendSimple(props, "property", part.metadata.getValue("family", prefix)).setAttribute("name", "family");
-    appendSimple(props, "property", part.metadata["variant"]).setAttribute("name", "variant");
-    appendSimple(props, "property", part.metadata.getValue("partnumber", prefix)).setAttribute("name", "part number");
-    */
-    for (auto pv = outprops.cbegin(); pv != outprops.cend(); ++ pv)
-        appendSimple(props, "property", pv.value()).setAttribute("name", pv.key());
-
-    {
-        QDomElement views = appendElement(module, "views"), view, layers;
-        view = appendElement(views, "iconView");
-        layers = appendElement(view, "layers");
-        layers.setAttribute("image", QString("icon/%1").arg(names.icon));
-        appendElement(layers, "layer").setAttribute("layerId", "icon");
-        view = appendElement(views, "breadboardView");
-        layers = appendElement(view, "layers");
-        layers.setAttribute("image", QString("breadboard/%1").arg(names.breadboard));
-        appendElement(layers, "layer").setAttribute("layerId", "breadboard");
-        view = appendElement(views, "schematicView");
-        layers = appendElement(view, "layers");
-        layers.setAttribute("image", QString("schematic/%1").arg(names.schematic));
-        appendElement(layers, "layer").setAttribute("layerId", "schematic");
-        view = appendElement(views, "pcbView");
-        layers = appendElement(view, "layers");
-        layers.setAttribute("image", QString("pcb/%1").arg(names.pcb));
-        appendElement(layers, "layer").setAttribute("layerId", "silkscreen");
-        appendElement(layers, "layer").setAttribute("layerId", "copper0");
-        appendElement(layers, "layer").setAttribute("layerId", "copper1");
-    }
-
-    auto addp = [](QDomNode view, QString layer, int number, bool terminal) {
-        QDomElement p = appendElement(view, "p");
-        p.setAttribute("layer", layer);
-        p.setAttribute("svgId", QString("connector%1pin").arg(number - 1));
-        if (terminal)
-            p.setAttribute("terminalId", QString("connector%1terminal").arg(number - 1));
-    };
-
-    QDomElement conns = appendElement(module, "connectors");
-    for (const Pin &pin : part.pins) {
-        QString name = (pin.name == "" ? QString("pin %1").arg(pin.number) : pin.name);
-        QDomElement conn = appendElement(conns, "connector");
-        conn.setAttribute("name", name);
-        conn.setAttribute("id", QString("connector%1").arg(pin.number - 1));
-        conn.setAttribute("type", "male");
-        appendSimple(conn, "description", name);
-        QDomElement views = appendElement(conn, "views"), view;
-        view = appendElement(views, "breadboardView");
-        addp(view, "breadboard", pin.number, false);
-        view = appendElement(views, "schematicView");
-        addp(view, "schematic", pin.number, true);
-        view = appendElement(views, "pcbView");
-        addp(view, "copper0", pin.number, false);
-        addp(view, "copper1", pin.number, false);
-    }
-
-    //qDebug().noquote() << fzp.toString();
-    return fzp;
+    Document *doc = currentDocument();
+    if (doc && doc->partserial != 0 && doc == previewdoc)
+        queueShownPreviews(doc);
 
 }
 
-
-static void writeXML (QDomDocument doc, QString filename) {
-    QFile file(filename);
-    if (!file.open(QFile::WriteOnly | QFile::Text))
-        throw std::runtime_error(file.errorString().toStdString());
-    QTextStream text(&file);
-    text.setCodec("utf-8");
-    doc.save(text, 2, QDomNode::EncodingFromTextStream);
-    qDebug() << "saved" << filename;
+// for build workers: the documents are serialized on the calling thread and shown on
+// the gui thread (if the script's tab is still open).
+void MainWindow::postPartPreviews (Document *doc, const Part &part, const QDomDocument &bb, const QDomDocument &sc, const QDomDocument &pcb) {
+    const QVector<QByteArray> svgs = { bb.toByteArray(), sc.toByteArray(), pcb.toByteArray() };
+    QMetaObject::invokeMethod(this, [this, doc, part, svgs] () {
+        if (documents.contains(doc))
+            setPartPreviews(doc, part, svgs);
+    }, Qt::QueuedConnection);
 }
 
-
-static QString sanitize (QString filename) {
-    // super picky, and latin chars only
-    filename = filename
-            .trimmed()
-            .replace(QRegExp("[ ]+"), " ")
-            .replace(QRegExp("[^a-zA-Z0-9_-]"), "_");
-    return (filename == "") ? "compiled" : filename;
-}
-
-PartFilenames::PartFilenames (QString prefix, QString builddir) {
-    if (prefix != "") {
-        prefix = sanitize(prefix);
-        fzpz = QString("%1.fzpz").arg(prefix);
-        if (builddir != "") {
-            if (QFileInfo(builddir).isDir())
-                fzpz = QDir(builddir).absoluteFilePath(fzpz);
-            else
-                fzpz = QFileInfo(builddir).absoluteDir().absoluteFilePath(fzpz);
-        }
-        fzp = QString("%1.fzp").arg(prefix);
-        icon = QString("%1_icon.svg").arg(prefix);
-        breadboard = QString("%1_breadboard.svg").arg(prefix);
-        schematic = QString("%1_schematic.svg").arg(prefix);
-        pcb = QString("%1_pcb.svg").arg(prefix);
-    }
+// same, but only the previews that are showing are made.
+void MainWindow::postPartPreviews (Document *doc, const Part &part, const QVector<bool> &shown) {
+    QVector<QByteArray> svgs(PreviewCount);
+    for (int view = 0; view < PreviewCount; ++ view)
+        if (shown[view])
+            svgs[view] = generatePreview(part, view);
+    QMetaObject::invokeMethod(this, [this, doc, part, svgs] () {
+        if (documents.contains(doc))
+            setPartPreviews(doc, part, svgs);
+    }, Qt::QueuedConnection);
 }
 
-
-void MainWindow::saveBasicPart(const Part &part, const PartFilenames &names) {
-
-    QDomDocument pcb = generatePCB(part);
-    QDomDocument breadboard = generateBreadboard(part);
-    QDomDocument schematic = generateSchematic(part);
-    QDomDocument icon = generateIcon(part);
-    QDomDocument fzp = generateFZP(part, names);
-
-#if 0 // debugging
-    writeXML(pcb, names.pcb);
-    writeXML(breadboard, names.breadboard);
-    writeXML(schematic, names.schematic);
-    writeXML(icon, names.icon);
-    writeXML(fzp, names.fzp);
-#endif
-
-    QList<QPair<QDomDocument,QString> > files = {
-        { pcb, QString("svg.pcb.%1").arg(names.pcb) },
-        { breadboard, QString("svg.breadboard.%1").arg(names.breadboard) },
-        { schematic, QString("svg.schematic.%1").arg(names.schematic) },
-        { icon, QString("svg.icon.%1").arg(names.icon) },
-        { fzp, QString("part.%1").arg(names.fzp) }
-    };
-
-    QTemporaryDir workdir;
-    if (!workdir.isValid())
-        throw std::runtime_error("failed to create temporary work directory");
-
-    QStringList filenames;
-    for (const auto &file : files) {
-        writeXML(file.first, workdir.filePath(file.second));
-        filenames.append(workdir.filePath(file.second));
-    }
-
-    showPartPreviews(breadboard, schematic, pcb);
-
-    if (ui->actBackup->isChecked() && QFile::exists(names.fzpz)) {
-        QString backup = names.fzpz + ".fritzpart.bak";
-        qDebug() << "backup" << names.fzpz << " -> " << backup;
-        qDebug() << "remove" << QFile::remove(backup);
-        qDebug() << "copy" << QFile::copy(names.fzpz, backup);
-    }
-
-    QString minizip = settings.value("minizip", "minizip").toString();
-    QStringList args = { "-o", names.fzpz };
-    args.append(filenames);
-    qDebug() << "minizip:" << minizip;
-    qDebug() << "minizip:" << args;
-    int result = QProcess::execute(minizip, args);
-    qDebug() << "minizip: returned " << result;
-    if (result) {
-        throw std::runtime_error("failed to execute minizip. you may have to select it "
-                                 "from the 'build -> settings -> locate minizip' menu.");
-    }
-
-    if (ui->actShowOutput->isChecked())
-        QDesktopServices::openUrl(QUrl::fromLocalFile(QFileInfo(names.fzpz).absolutePath()));
-
+// a pin, hole or marking was clicked in a preview: go to the line it came from (which
+// then highlights it in all of the views).
+void MainWindow::previewProbed (const QString &id) {
+    Document *doc = currentDocument();
+    const int line = doc->idlines.value(id, -1);
+    const QTextBlock block = doc->editor->document()->findBlockByNumber(line);
+    if (line < 0 || !block.isValid())
+        return;
+    doc->editor->setTextCursor(QTextCursor(block));
+    doc->editor->centerCursor();
+    doc->editor->setFocus();
+    statusBar()->showMessage(QString("%1: line %2%3").arg(id).arg(line + 1)
+                             .arg(doc->tried == doc->revision ? "" : " (edited since the preview)"));
 }
 
-void MainWindow::showPartPreviews (const Part &part) {
-    QDomDocument pcb = generatePCB(part);
-    QDomDocument breadboard = generateBreadboard(part);
-    QDomDocument schematic = generateSchematic(part);
-    showPartPreviews(breadboard, schematic, pcb);
-}
-
-void MainWindow::showPartPreviews(const QDomDocument &bb, const QDomDocument &sc, const QDomDocument &pcb) {
-    ui->svgPCB->load(pcb.toByteArray());
-    ui->svgPCB->renderer()->setAspectRatioMode(Qt::KeepAspectRatio);
-    ui->svgBreadboard->load(bb.toByteArray());
-    ui->svgBreadboard->renderer()->setAspectRatioMode(Qt::KeepAspectRatio);
-    ui->svgSchematic->load(sc.toByteArray());
-    ui->svgSchematic->renderer()->setAspectRatioMode(Qt::KeepAspectRatio);
+// highlights whatever the caret's line made.
+void MainWindow::caretMoved () {
+    Document *doc = currentDocument();
+    if (!doc || !views[0])
+        return;
+    const QStringList ids = doc->lineids.values(doc->editor->textCursor().blockNumber());
+    for (PreviewView *view : views)
+        view->setHighlight(ids);
 }
 
 void MainWindow::on_actOpenIssues_triggered()
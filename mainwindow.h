@@ -26,133 +26,26 @@ https://github.com/JC3/fritzpart
 
 #include <QMainWindow>
 #include <QSettings>
-#include <QMap>
+#include <QTimer>
 #include <QDomDocument>
+#include <QFutureWatcher>
+#include <QThreadPool>
+#include <QHash>
+#include <QVector>
+#include <QAtomicInt>
 #include "helpwindow.h"
+#include "gallerywindow.h"
+#include "part.h"
+#include "partcompiler.h"
+#include "memstats.h"
+#include "libraryindex.h"
 
 QT_BEGIN_NAMESPACE
 namespace Ui { class MainWindow; }
 QT_END_NAMESPACE
 
-// i feel like qt probably has something with this behavior built-in already but whatever.
-// just a string map but unlike QMap::value(), also provides a way to substitute defaults
-// for values that are present but are empty strings.
-class PropertyMap : public QMap<QString,QString> {
-public:
-    QString getValue (const QString &key, const QString &defaultValue = QString()) const {
-        QString v = value(key, defaultValue);
-        return v.isEmpty() ? defaultValue : v;
-    }
-};
-
-struct Pin {
-    double x;
-    double y;
-    QString name;
-    bool square;
-    double hole;
-    double ring;
-    int number;
-    Pin () : x(0), y(0), square(false), hole(0.9), ring(0.508), number(-1) { }
-    // temporary parsing context stuff
-    bool origleft;
-    bool origtop;
-};
-
-struct Hole { // pcb cutout holes (not pth pin holes)
-    double x;
-    double y;
-    double diameter;
-    //double ring; // todo: maybe
-    Hole () : x(0), y(0), diameter(0) /*, ring(0)*/ { }
-    // temporary parsing context stuff
-    bool origleft;
-    bool origtop;
-};
-
-struct Marking {
-    enum Shape { Invalid=0, Circle, Line };
-    Shape shape;
-    double x1, y1;
-    double x2, y2;
-    double diam;
-    bool capped;
-    explicit Marking (Shape shape = Invalid) : shape(shape), x1(0), y1(0), x2(0), y2(0), diam(0),
-        capped(true), x1reverse(false), y1reverse(false), x2reverse(false), y2reverse(false),
-        xbackoff(false), ybackoff(false) { }
-    static Marking makeCircle (double x, double y, double d, bool origleft, bool origtop) {
-        Marking m(Circle);
-        m.x1 = x;
-        m.y1 = y;
-        m.diam = d;
-        m.origleft = origleft;
-        m.origtop = origtop;
-        return m;
-    }
-    static Marking makeLine (double x1, double y1, double x2, double y2, bool origleft, bool origtop) {
-        Marking m(Line);
-        m.x1 = x1;
-        m.y1 = y1;
-        m.x2 = x2;
-        m.y2 = y2;
-        m.origleft = origleft;
-        m.origtop = origtop;
-        return m;
-    }
-    // temporary parsing context stuff
-    bool origleft;
-    bool origtop;
-    bool x1reverse, y1reverse;
-    bool x2reverse, y2reverse;
-    bool xbackoff, ybackoff;
-};
-
-// todo: a bunch of things (above) have deferred positions now,
-// need to find a cleaner way of handling that.
-
-struct Part {
-    QString units;  // todo: define a set of units instead of allowing free text. mm, in, micron, mil, thou probably
-    double width;
-    double height;
-    double outline; // todo: different default depending on units
-    QList<Pin> pins;
-    QString color;
-    double corner;
-    QString schematic;
-    QString schematicmod;
-    int mingrid[2];
-    int extragrid[2];
-    QString bbtext;
-    QString bbtextcolor;
-    double bbtextsize; // todo: different default depending on units
-    bool bbpinlabels;
-    QString bbpinlabelcolor;
-    double bbpinlabelsize; // todo: different default depending on units
-    QString sctext;
-    bool scpinlabels;
-    bool scpinnumbers;
-    QList<Hole> pcbholes;
-    QList<Marking> pcbmarks;
-    double pcbmarkstroke; // todo: different default depending on units
-    PropertyMap metadata;
-    PropertyMap metaprops;
-    QStringList metatags;
-    QString filename;
-    Part () : units("mm"), width(0), height(0), outline(0.254), color("#116b9e"), corner(0), schematic("edge"),
-        mingrid{0,0}, extragrid{0,0}, bbtext("$partnumber"), bbtextcolor("#ffffff"), bbtextsize(5.08),
-        bbpinlabels(true), bbpinlabelcolor("#c5e6f9"), bbpinlabelsize(2.54), sctext("$title"), scpinlabels(true),
-        scpinnumbers(true), pcbmarkstroke(0.254 * 0.75), metatags({"fritzpart"}) { }
-};
-
-struct PartFilenames {
-    QString fzpz;        // filename (in cwd) or full path
-    QString fzp;         // filename only!!
-    QString icon;        // filename only!!
-    QString breadboard;  // filename only!!
-    QString schematic;   // filename only!!
-    QString pcb;         // filename only!!
-    explicit PartFilenames (QString prefix = QString(), QString builddir = QString());
-};
+class PreviewView;
+class QPlainTextEdit;
 
 class MainWindow : public QMainWindow
 {
@@ -171,30 +64,137 @@ private slots:
     void on_actSaveFile_triggered();
     void on_actCompile_triggered();
     void on_actLocateMinizip_triggered();
+    void on_actUseMinizip_triggered(bool checked);
+    void compressionChanged(QAction *action);
     void on_actNewFile_triggered();
+    void on_actCloseFile_triggered();
+    void documentChanged();
     void updateWindowTitle();
     void on_actPreview_triggered();
     void on_actCompileTo_triggered();
+    void on_actCancelBuild_triggered();
+    void buildCompiled();
+    void buildArchived();
     void on_actShowOutput_triggered(bool checked);
     void on_actBackup_triggered(bool checked);
+    void on_actBackupCount_triggered();
+    void on_actSyncOutput_triggered(bool checked);
+    void on_actMemStats_triggered(bool checked);
     void on_actHelpHelp_triggered();
+    void on_actGallery_triggered();
+    void on_actFindInLibrary_triggered();
     void on_actOpenIssues_triggered();
+    void on_actLivePreview_triggered(bool checked);
+    void scriptEdited();
+    void livePreview();
+    void previewProbed(const QString &id);
+    void caretMoved();
+    void previewVisibilityChanged();
+    void generateDeferredPreviews();
+    void previewsDeferred();
 
 protected:
     void closeEvent(QCloseEvent *event);
 private:
     Ui::MainWindow *ui;
     QSettings settings;
-    QString curfilename;
     QString basetitle;
     HelpWindow *helpdlg;
-    bool promptSaveIfModified ();
-    void setCurrentFileName (QString filename) { curfilename = filename; updateWindowTitle(); }
-    void saveBasicPart (const Part &part, const PartFilenames &names);
+    GalleryWindow *gallery;
+    QTimer livetimer;
+    QTimer idletimer;  // for previews that aren't showing, see refreshPreviews()
+    enum { PreviewBreadboard, PreviewSchematic, PreviewPCB, PreviewCount };
+    // background compiles of tabs that aren't being looked at, see compileInBackground().
+    struct BackgroundResult {
+        PartCompiler compiler;
+        Part part;
+        QVector<QByteArray> svgs; // by preview; just the ones that were showing
+        QString error;
+        int revision;
+    };
+    // an open script, one per tab. each has its own compiler, so compiles stay
+    // incremental, and keeps the part and previews it last compiled to, so switching
+    // tabs doesn't compile anything. previews are only made for views that are showing;
+    // the rest are empty until they're shown or things are idle.
+    struct Document {
+        int id;             // unique for the session; a pointer can be reused by the next tab
+        QPlainTextEdit *editor;
+        QString filename;
+        PartCompiler compiler;
+        int revision;       // bumped on every edit
+        int tried;          // revision part, previews and error are from, or -1
+        Part part;
+        int partserial;     // bumped when part changes, 0 if there isn't one yet
+        QVector<QByteArray> svgs; // of part, by preview; empty if not made yet
+        QVector<int> queued;      // partserial each preview was last sent to the background for
+        QString error;
+        QMultiHash<int,QString> lineids; // script line -> preview element ids, for cross-probing
+        QHash<QString,int> idlines;
+        QFutureWatcher<BackgroundResult> background;
+        Document () : id(0), editor(nullptr), revision(0), tried(-1), partserial(0), svgs(PreviewCount), queued(PreviewCount) { }
+    };
+    QList<Document *> documents; // in the order they were opened
+    QThreadPool backgroundpool;  // shared by every tab's background compiles
+    struct DeferredPreviews {
+        int docid;
+        int partserial;
+        QVector<QByteArray> svgs;
+    };
+    QFutureWatcher<DeferredPreviews> deferring;
+    // background builds, see startBuild().
+    struct CompileResult {
+        PartCompiler compiler;
+        int revision; // of the compiled text
+        Part part;
+        QList<Part> variants; // if the script has param sweeps or part blocks
+        QString error;
+    };
+    struct ArchiveResult {
+        QList<Part> parts;
+        QString outdir;
+        QString message;
+        QString error;
+    };
+    enum { NoBuild, BuildCompile, BuildCompileTo };
+    QFutureWatcher<CompileResult> compiling;
+    QFutureWatcher<ArchiveResult> archiving;
+    QAtomicInt buildcancel;
+    Document *builddoc; // what's being built
+    bool building;
+    bool buildask;     // the running build is a compile to
+    int queuedbuild;   // what to do when it's done
+    MemCounters buildmem; // at the start of the build
+    LibraryIndex library; // of the last script built, see libraryOf()
+    QDateTime librarytime; // of its index file when loaded
+    PreviewView *views[PreviewCount]; // created on first use
+    int recentview;    // the preview last zoomed, panned or clicked; it's made first
+    Document *previewdoc; // whose previews the views are showing, if anybody's
+    Document * newDocument ();
+    Document * currentDocument () const;
+    bool closeDocument (Document *doc);
+    void setDocumentFileName (Document *doc, QString filename);
+    void compileInBackground (Document *doc);
+    void backgroundCompiled (Document *doc);
+    bool promptSaveIfModified (Document *doc);
+    QString scriptPath ();
+    LibraryIndex * libraryOf (const QString &script);
+    bool previewShown (int view) const;
+    QVector<bool> previewsShown () const;
+    static QByteArray generatePreview (const Part &part, int view);
     void showPartPreviews (const Part &part);
-    void showPartPreviews (const QDomDocument &bb, const QDomDocument &sc, const QDomDocument &pcb);
+    void setPartPreviews (Document *doc, const Part &part, const QVector<QByteArray> &svgs);
+    void refreshPreviews ();
+    void deferPreviews (Document *doc, const QList<int> &missing, QThreadPool *pool);
+    Document * documentById (int id) const;
+    void queueShownPreviews (Document *doc);
+    void postPartPreviews (Document *doc, const Part &part, const QVector<bool> &shown);
+    void postPartPreviews (Document *doc, const Part &part, const QDomDocument &bb, const QDomDocument &sc, const QDomDocument &pcb);
+    void startBuild (bool ask);
+    void buildProgress (const QString &message);
+    void finishBuild (const QString &message);
     Part compile ();
     void clearPartPreviews ();
+    void createPartPreviews ();
 };
 
 #endif // MAINWINDOW_H
@@ -0,0 +1,168 @@
+/*----------------------------------------------------------------------
+Fritzpart - Generates Fritzing parts from a part description script.
+Copyright (C) 2021, Jason Cipriani <jason.cipriani.dev@gmail.com>
+Not affiliated with Fritzing.
+
+This file is part of Fritzpart.
+
+Fritzpart is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+https://github.com/JC3/fritzpart
+----------------------------------------------------------------------*/
+
+
+#include "memstats.h"
+#include <QStringList>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#ifdef Q_OS_WIN
+#  define PSAPI_VERSION 2
+#  include <windows.h>
+#  include <psapi.h>
+#else
+#  include <sys/resource.h>
+#endif
+
+// plain globals only: operator new runs before (and during) static initialization.
+static std::atomic<bool> enabled(false);
+static std::atomic<quint64> allocs[StageCount];
+static thread_local int current = -1;
+
+static const char * const stagenames[StageCount] = {
+    "tokenize", "parse", "breadboard", "schematic", "pcb", "icon", "fzp", "serialize", "archive"
+};
+
+void * operator new (std::size_t size) {
+    const int stage = current;
+    if (stage >= 0 && enabled.load(std::memory_order_relaxed))
+        allocs[stage].fetch_add(1, std::memory_order_relaxed);
+    for (;;) {
+        if (void *p = std::malloc(size ? size : 1))
+            return p;
+        std::new_handler handler = std::get_new_handler();
+        if (!handler)
+            throw std::bad_alloc();
+        handler();
+    }
+}
+
+void * operator new[] (std::size_t size) {
+    return operator new(size);
+}
+
+void * operator new (std::size_t size, const std::nothrow_t &) noexcept {
+    try {
+        return operator new(size);
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+void * operator new[] (std::size_t size, const std::nothrow_t &) noexcept {
+    return operator new(size, std::nothrow);
+}
+
+void operator delete (void *p) noexcept { std::free(p); }
+void operator delete[] (void *p) noexcept { std::free(p); }
+void operator delete (void *p, std::size_t) noexcept { std::free(p); }
+void operator delete[] (void *p, std::size_t) noexcept { std::free(p); }
+void operator delete (void *p, const std::nothrow_t &) noexcept { std::free(p); }
+void operator delete[] (void *p, const std::nothrow_t &) noexcept { std::free(p); }
+
+MemCounters::MemCounters () : peakrss(0) {
+    for (int s = 0; s < StageCount; ++ s)
+        allocs[s] = 0;
+}
+
+MemCounters MemCounters::operator- (const MemCounters &before) const {
+    MemCounters diff = *this;
+    for (int s = 0; s < StageCount; ++ s)
+        diff.allocs[s] -= before.allocs[s];
+    return diff;
+}
+
+void setMemStatsEnabled (bool on) {
+    enabled = on;
+}
+
+bool memStatsEnabled () {
+    return enabled;
+}
+
+MemCounters memCounters () {
+    MemCounters counters;
+    for (int s = 0; s < StageCount; ++ s)
+        counters.allocs[s] = allocs[s];
+    counters.peakrss = peakResidentSize();
+    return counters;
+}
+
+quint64 peakResidentSize () {
+#ifdef Q_OS_WIN
+    PROCESS_MEMORY_COUNTERS pmc;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+        return pmc.PeakWorkingSetSize;
+    return 0;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage))
+        return 0;
+#  ifdef Q_OS_MACOS
+    return usage.ru_maxrss;          // bytes
+#  else
+    return (quint64)usage.ru_maxrss * 1024;   // kilobytes
+#  endif
+#endif
+}
+
+static QString formatBytes (quint64 n) {
+    if (n >= 1024 * 1024)
+        return QString("%1 MB").arg(n / (1024.0 * 1024.0), 0, 'f', 1);
+    if (n >= 1024)
+        return QString("%1 KB").arg(n / 1024.0, 0, 'f', 1);
+    return QString("%1 B").arg(n);
+}
+
+QString memStatsSummary (const MemCounters &counters) {
+    quint64 nallocs = 0;
+    int top = 0;
+    for (int s = 0; s < StageCount; ++ s) {
+        nallocs += counters.allocs[s];
+        if (counters.allocs[s] > counters.allocs[top])
+            top = s;
+    }
+    return QString("Memory: %1 new calls (most in %2: %3), process peak RSS %4.")
+            .arg(nallocs).arg(stagenames[top]).arg(counters.allocs[top])
+            .arg(counters.peakrss ? formatBytes(counters.peakrss) : QString("unknown"));
+}
+
+QString memStatsTable (const MemCounters &counters) {
+    QStringList lines;
+    for (int s = 0; s < StageCount; ++ s) {
+        if (!counters.allocs[s])
+            continue;
+        lines.append(QString("  %1 %2 new calls").arg(stagenames[s], -10).arg(counters.allocs[s], 9));
+    }
+    lines.append(QString("  process peak RSS %1").arg(counters.peakrss ? formatBytes(counters.peakrss) : QString("unknown")));
+    return lines.join("\n");
+}
+
+MemStageScope::MemStageScope (MemStage stage) : previous(current) {
+    current = stage;
+}
+
+MemStageScope::~MemStageScope () {
+    current = previous;
+}
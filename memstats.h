@@ -0,0 +1,70 @@
+/*----------------------------------------------------------------------
+Fritzpart - Generates Fritzing parts from a part description script.
+Copyright (C) 2021, Jason Cipriani <jason.cipriani.dev@gmail.com>
+Not affiliated with Fritzing.
+
+This file is part of Fritzpart.
+
+Fritzpart is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+https://github.com/JC3/fritzpart
+----------------------------------------------------------------------*/
+
+
+#ifndef MEMSTATS_H
+#define MEMSTATS_H
+
+#include <QString>
+#include <QtGlobal>
+
+// opt-in memory accounting by pipeline stage. while enabled, every call to operator new
+// on a thread that's inside a MemStageScope is counted against that stage. only calls
+// that reach the replaced operator new are counted: qt's container data (QString,
+// QByteArray, QList storage) is malloc'd directly and never is, and on windows neither
+// is anything new'd inside a dll (e.g. QDom nodes), since each dll has its own. so the
+// counts are only a measure of allocation churn, not of bytes. memory use is reported
+// as the process's peak resident set size, which includes everything but can't be
+// split by stage (stages run on several threads at once).
+enum MemStage {
+    StageTokenize, StageParse, StageBreadboard, StageSchematic, StagePCB, StageIcon,
+    StageFZP, StageSerialize, StageArchive, StageCount
+};
+
+struct MemCounters {
+    quint64 allocs[StageCount];
+    quint64 peakrss; // process peak (bytes) so far when the counters were read, 0 if unknown
+    MemCounters ();
+    MemCounters operator- (const MemCounters &before) const; // the peak is kept, not subtracted
+};
+
+void setMemStatsEnabled (bool enabled);
+bool memStatsEnabled ();
+MemCounters memCounters ();     // totals since startup, all threads
+quint64 peakResidentSize ();    // bytes, 0 if unknown
+
+QString memStatsSummary (const MemCounters &counters);  // one line, for the status bar
+QString memStatsTable (const MemCounters &counters);    // one line per stage, for logs
+
+// counts allocations on this thread against stage until it goes out of scope (scopes
+// nest; the previous stage is restored).
+class MemStageScope {
+public:
+    explicit MemStageScope (MemStage stage);
+    ~MemStageScope ();
+private:
+    int previous;
+    Q_DISABLE_COPY(MemStageScope)
+};
+
+#endif // MEMSTATS_H
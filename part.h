@@ -0,0 +1,227 @@
+/*----------------------------------------------------------------------
+Fritzpart - Generates Fritzing parts from a part description script.
+Copyright (C) 2021, Jason Cipriani <jason.cipriani.dev@gmail.com>
+Not affiliated with Fritzing.
+
+This file is part of Fritzpart.
+
+Fritzpart is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+https://github.com/JC3/fritzpart
+----------------------------------------------------------------------*/
+
+#ifndef PART_H
+#define PART_H
+
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QMap>
+#include <QHash>
+#include <initializer_list>
+
+// i feel like qt probably has something with this behavior built-in already but whatever.
+// just a string map but unlike QMap::value(), also provides a way to substitute defaults
+// for values that are present but are empty strings.
+class PropertyMap : public QMap<QString,QString> {
+public:
+    QString getValue (const QString &key, const QString &defaultValue = QString()) const {
+        QString v = value(key, defaultValue);
+        return v.isEmpty() ? defaultValue : v;
+    }
+};
+
+// the well known metadata fields. the order is the order they're written to scripts in.
+enum MetaKey {
+    MetaModuleId, MetaTitle, MetaPartNumber, MetaFamily, MetaVariant, MetaVersion,
+    MetaAuthor, MetaLabel, MetaUrl, MetaDescription, MetaKeyCount
+};
+
+// well known metadata, stored by MetaKey rather than by name. names (the directive
+// names, also used for $name in bbtext/sctext) only come into it when parsing.
+// freeform properties live in Part::metaprops instead.
+class Metadata {
+public:
+    const QString & operator[] (MetaKey key) const { return values[key]; }
+    QString & operator[] (MetaKey key) { return values[key]; }
+    // the value, or def if it's empty.
+    QString get (MetaKey key, const QString &def = QString()) const {
+        return values[key].isEmpty() ? def : values[key];
+    }
+    // the first of keys that isn't empty, or def.
+    QString first (std::initializer_list<MetaKey> keys, const QString &def = QString()) const {
+        for (MetaKey key : keys)
+            if (!values[key].isEmpty())
+                return values[key];
+        return def;
+    }
+    void setDefault (MetaKey key, const QString &value) {
+        if (values[key].isEmpty())
+            values[key] = value;
+    }
+    bool operator== (const Metadata &other) const {
+        for (int k = 0; k < MetaKeyCount; ++ k)
+            if (values[k] != other.values[k])
+                return false;
+        return true;
+    }
+    bool operator!= (const Metadata &other) const { return !(*this == other); }
+    static const char * name (MetaKey key) {
+        static const char * const names[MetaKeyCount] = {
+            "moduleid", "title", "partnumber", "family", "variant", "version",
+            "author", "label", "url", "description"
+        };
+        return names[key];
+    }
+    // MetaKey for a (lowercase) name, or -1.
+    static int keyOf (const QString &name) {
+        static const QHash<QString,int> keys = [] () {
+            QHash<QString,int> keys;
+            for (int k = 0; k < MetaKeyCount; ++ k)
+                keys[name((MetaKey)k)] = k;
+            return keys;
+        }();
+        return keys.value(name, -1);
+    }
+private:
+    QString values[MetaKeyCount];
+};
+
+// how many of the given svg units (as used by the units directive) make an inch, or 0
+// if they aren't physical units we know about. px is fritzing's 90 dpi, not css's 96.
+inline double unitsPerInch (const QString &units) {
+    static const QHash<QString,double> perinch = {
+        { "in", 1 }, { "mm", 25.4 }, { "cm", 2.54 }, { "pt", 72 }, { "pc", 6 }, { "px", 90 }
+    };
+    return perinch.value(units.toLower(), 0);
+}
+
+struct Pin {
+    double x;
+    double y;
+    QString name;
+    bool square;
+    double hole;
+    double ring;
+    int number;
+    int line; // script line (from 0) it came from, or -1
+    Pin () : x(0), y(0), square(false), hole(0.9), ring(0.508), number(-1), line(-1) { }
+    // temporary parsing context stuff
+    bool origleft;
+    bool origtop;
+};
+
+// for sorting pins by number.
+inline bool pinNumberLess (const Pin &a, const Pin &b) {
+    return a.number < b.number;
+}
+
+struct Hole { // pcb cutout holes (not pth pin holes)
+    double x;
+    double y;
+    double diameter;
+    //double ring; // todo: maybe
+    int line; // script line (from 0) it came from, or -1
+    Hole () : x(0), y(0), diameter(0) /*, ring(0)*/, line(-1) { }
+    // temporary parsing context stuff
+    bool origleft;
+    bool origtop;
+};
+
+struct Marking {
+    enum Shape { Invalid=0, Circle, Line };
+    Shape shape;
+    double x1, y1;
+    double x2, y2;
+    double diam;
+    bool capped;
+    int line; // script line (from 0) it came from, or -1
+    explicit Marking (Shape shape = Invalid) : shape(shape), x1(0), y1(0), x2(0), y2(0), diam(0),
+        capped(true), line(-1), x1reverse(false), y1reverse(false), x2reverse(false), y2reverse(false),
+        xbackoff(false), ybackoff(false) { }
+    static Marking makeCircle (double x, double y, double d, bool origleft, bool origtop) {
+        Marking m(Circle);
+        m.x1 = x;
+        m.y1 = y;
+        m.diam = d;
+        m.origleft = origleft;
+        m.origtop = origtop;
+        return m;
+    }
+    static Marking makeLine (double x1, double y1, double x2, double y2, bool origleft, bool origtop) {
+        Marking m(Line);
+        m.x1 = x1;
+        m.y1 = y1;
+        m.x2 = x2;
+        m.y2 = y2;
+        m.origleft = origleft;
+        m.origtop = origtop;
+        return m;
+    }
+    // temporary parsing context stuff
+    bool origleft;
+    bool origtop;
+    bool x1reverse, y1reverse;
+    bool x2reverse, y2reverse;
+    bool xbackoff, ybackoff;
+};
+
+// todo: a bunch of things (above) have deferred positions now,
+// need to find a cleaner way of handling that.
+
+struct Part {
+    QString units;  // todo: define a set of units instead of allowing free text. mm, in, micron, mil, thou probably
+    double width;
+    double height;
+    double outline; // todo: different default depending on units
+    QList<Pin> pins;
+    QString color;
+    double corner;
+    QString schematic;
+    QString schematicmod;
+    int mingrid[2];
+    int extragrid[2];
+    QString bbtext;
+    QString bbtextcolor;
+    double bbtextsize; // todo: different default depending on units
+    bool bbpinlabels;
+    QString bbpinlabelcolor;
+    double bbpinlabelsize; // todo: different default depending on units
+    QString sctext;
+    bool scpinlabels;
+    bool scpinnumbers;
+    QList<Hole> pcbholes;
+    QList<Marking> pcbmarks;
+    double pcbmarkstroke; // todo: different default depending on units
+    Metadata metadata;
+    PropertyMap metaprops;
+    QStringList metatags;
+    QString filename;
+    Part () : units("mm"), width(0), height(0), outline(0.254), color("#116b9e"), corner(0), schematic("edge"),
+        mingrid{0,0}, extragrid{0,0}, bbtext("$partnumber"), bbtextcolor("#ffffff"), bbtextsize(5.08),
+        bbpinlabels(true), bbpinlabelcolor("#c5e6f9"), bbpinlabelsize(2.54), sctext("$title"), scpinlabels(true),
+        scpinnumbers(true), pcbmarkstroke(0.254 * 0.75), metatags({"fritzpart"}) { }
+};
+
+struct PartFilenames {
+    QString fzpz;        // filename (in cwd) or full path
+    QString fzp;         // filename only!!
+    QString icon;        // filename only!!
+    QString breadboard;  // filename only!!
+    QString schematic;   // filename only!!
+    QString pcb;         // filename only!!
+    explicit PartFilenames (QString prefix = QString(), QString builddir = QString());
+};
+
+#endif // PART_H
@@ -0,0 +1,1104 @@
+/*----------------------------------------------------------------------
+Fritzpart - Generates Fritzing parts from a part description script.
+Copyright (C) 2021, Jason Cipriani <jason.cipriani.dev@gmail.com>
+Not affiliated with Fritzing.
+
+This file is part of Fritzpart.
+
+Fritzpart is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+https://github.com/JC3/fritzpart
+----------------------------------------------------------------------*/
+
+#include "partcompiler.h"
+#include "memstats.h"
+#include "pintable.h"
+#include <QBuffer>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QRegExp>
+#include <QRegularExpression>
+#include <QSet>
+#include <QTextStream>
+#include <QtConcurrent>
+#include <functional>
+#include <stdexcept>
+#include <cmath>
+#include <climits>
+
+// commands are latin1 literals so checking a line against each directive doesn't
+// allocate a string per directive.
+static bool matches (const QStringList &tokens, const char *command, int minparms = -1, int maxparms = -1) {
+    if (tokens.empty() || tokens[0].compare(QLatin1String(command), Qt::CaseInsensitive))
+        return false;
+    int parms = tokens.size() - 1;
+    if (minparms < 0)
+        return true;
+    if (parms < minparms)
+        return false;
+    if (maxparms < 0)
+        maxparms = minparms;
+    if (parms > maxparms)
+        return false;
+    return true;
+}
+
+
+static bool matches (const QStringList &tokens, std::initializer_list<const char *> commands, int minparms = -1, int maxparms = -1) {
+    for (const char *command : commands)
+        if (matches(tokens, command, minparms, maxparms))
+            return true;
+    return false;
+}
+
+
+// param values: numbers, or ranges like 2..40 (step 1) or 2.54..10.16:2.54.
+static QList<double> parseParamValues (const QStringList &tokens) {
+    QList<double> values;
+    for (const QString &token : tokens) {
+        int dots = token.indexOf("..");
+        if (dots < 0) {
+            bool ok;
+            values.append(token.toDouble(&ok));
+            if (!ok)
+                throw std::runtime_error(QString("invalid param value: %1").arg(token).toStdString());
+            continue;
+        }
+        QString last = token.mid(dots + 2), step = "1";
+        int colon = last.indexOf(':');
+        if (colon >= 0) {
+            step = last.mid(colon + 1);
+            last = last.left(colon);
+        }
+        bool ok1, ok2, ok3;
+        double a = token.left(dots).toDouble(&ok1), b = last.toDouble(&ok2), d = fabs(step.toDouble(&ok3));
+        if (!ok1 || !ok2 || !ok3 || d == 0)
+            throw std::runtime_error(QString("invalid param range: %1").arg(token).toStdString());
+        if (b < a)
+            d = -d;
+        int count = (int)floor((b - a) / d + 1e-9) + 1;
+        if (values.size() + count > PartCompiler::MaxVariants)
+            throw std::runtime_error(QString("param range too large: %1").arg(token).toStdString());
+        for (int n = 0; n < count; ++ n)
+            values.append(a + n * d);
+    }
+    return values;
+}
+
+static bool parseBool (QString str) {
+    static QStringList trues = { "true", "yes", "on", "1" };
+    static QStringList falses = { "false", "no", "off", "0" };
+    if (trues.contains(str, Qt::CaseInsensitive))
+        return true;
+    else if (falses.contains(str, Qt::CaseInsensitive))
+        return false;
+    else
+        throw std::runtime_error(QString("invalid boolean value: %1").arg(str).toStdString());
+}
+
+template <typename T>
+static void setDeferredPos (double width, double height, QList<T> &things) {
+    for (T &thing : things) {
+        if (!thing.origleft) {
+            thing.origleft = true;
+            thing.x = width - thing.x;
+        }
+        if (!thing.origtop) {
+            thing.origtop = true;
+            thing.y = height - thing.y;
+        }
+    }
+}
+
+template <>
+void setDeferredPos<Marking> (double width, double height, QList<Marking> &things) {
+    for (Marking &thing : things) {
+        if (!thing.origleft) {
+            thing.x1reverse = !thing.x1reverse;
+            thing.x2reverse = !thing.x2reverse;
+        }
+        if (!thing.origtop) {
+            thing.y1reverse = !thing.y1reverse;
+            thing.y2reverse = !thing.y2reverse;
+        }
+        if (thing.x1reverse) thing.x1 = width - thing.x1;
+        if (thing.x2reverse) thing.x2 = width - thing.x2;
+        if (thing.y1reverse) thing.y1 = height - thing.y1;
+        if (thing.y2reverse) thing.y2 = height - thing.y2;
+        thing.x1reverse = thing.x2reverse = false;
+        thing.y1reverse = thing.y2reverse = false;
+        thing.origleft = thing.origtop = true;
+    }
+}
+
+static bool sameHeader (const Part &a, const Part &b) {
+    return a.units == b.units && a.width == b.width && a.height == b.height &&
+           a.outline == b.outline && a.color == b.color && a.corner == b.corner &&
+           a.schematic == b.schematic && a.schematicmod == b.schematicmod &&
+           a.mingrid[0] == b.mingrid[0] && a.mingrid[1] == b.mingrid[1] &&
+           a.extragrid[0] == b.extragrid[0] && a.extragrid[1] == b.extragrid[1] &&
+           a.bbtext == b.bbtext && a.bbtextcolor == b.bbtextcolor && a.bbtextsize == b.bbtextsize &&
+           a.bbpinlabels == b.bbpinlabels && a.bbpinlabelcolor == b.bbpinlabelcolor &&
+           a.bbpinlabelsize == b.bbpinlabelsize && a.sctext == b.sctext &&
+           a.scpinlabels == b.scpinlabels && a.scpinnumbers == b.scpinnumbers &&
+           a.pcbmarkstroke == b.pcbmarkstroke && a.metadata == b.metadata &&
+           a.metaprops == b.metaprops && a.metatags == b.metatags && a.filename == b.filename;
+}
+
+// the same items, apart from the script lines they came from.
+static bool sameItem (const Pin &a, const Pin &b) {
+    return a.x == b.x && a.y == b.y && a.name == b.name && a.square == b.square && a.hole == b.hole &&
+           a.ring == b.ring && a.number == b.number && a.origleft == b.origleft && a.origtop == b.origtop;
+}
+
+static bool sameItem (const Hole &a, const Hole &b) {
+    return a.x == b.x && a.y == b.y && a.diameter == b.diameter && a.origleft == b.origleft && a.origtop == b.origtop;
+}
+
+static bool sameItem (const Marking &a, const Marking &b) {
+    return a.shape == b.shape && a.x1 == b.x1 && a.y1 == b.y1 && a.x2 == b.x2 && a.y2 == b.y2 &&
+           a.diam == b.diam && a.capped == b.capped && a.origleft == b.origleft && a.origtop == b.origtop &&
+           a.x1reverse == b.x1reverse && a.y1reverse == b.y1reverse && a.x2reverse == b.x2reverse &&
+           a.y2reverse == b.y2reverse && a.xbackoff == b.xbackoff && a.ybackoff == b.ybackoff;
+}
+
+template <typename T> static bool sameItems (const QList<T> &a, const QList<T> &b) {
+    if (a.size() != b.size())
+        return false;
+    for (int n = 0; n < a.size(); ++ n)
+        if (!sameItem(a[n], b[n]))
+            return false;
+    return true;
+}
+
+bool PartCompiler::State::converged (const State &other) const {
+    // pin/hole/mark lists are deliberately not compared; once everything else matches,
+    // the rest of the script appends exactly what it appended last time. what's put back
+    // at the next endpart does matter, though.
+    const bool same = curhole == other.curhole && curring == other.curring &&
+           curx == other.curx && cury == other.cury && curnumber == other.curnumber &&
+           origleft == other.origleft && origtop == other.origtop &&
+           gotpcbms == other.gotpcbms && indesc == other.indesc &&
+           inblock == other.inblock && nblocks == other.nblocks &&
+           expanded == other.expanded && vars == other.vars && sweep == other.sweep &&
+           first.isNull() == other.first.isNull() && sameHeader(part, other.part);
+    if (!same || !inblock || header == other.header)
+        return same;
+    return header && other.header && header->converged(*other.header) &&
+           sameItems(header->part.pins, other.header->part.pins) &&
+           sameItems(header->part.pcbholes, other.header->part.pcbholes) &&
+           sameItems(header->part.pcbmarks, other.header->part.pcbmarks);
+}
+
+PartCompiler::Checkpoint PartCompiler::makeCheckpoint (int line, int offset, const State &state) {
+    Checkpoint cp;
+    cp.line = line;
+    cp.offset = offset;
+    cp.npins = state.part.pins.size();
+    cp.nholes = state.part.pcbholes.size();
+    cp.nmarks = state.part.pcbmarks.size();
+    cp.state = state;
+    // outside of blocks the lists only ever grow, so the counts are enough to get them
+    // back from the end of the run. blocks start over at each endpart, so from the first
+    // part on the checkpoint keeps its own (shared until the next append).
+    if (!state.nblocks) {
+        cp.state.part.pins.clear();
+        cp.state.part.pcbholes.clear();
+        cp.state.part.pcbmarks.clear();
+    }
+    return cp;
+}
+
+void PartCompiler::reset () {
+    valid = false;
+    prevtext = QString();
+    prevfinal = State();
+    checkpoints.clear();
+    tables.clear();
+    expressions.clear();
+}
+
+// a plain number, or otherwise an expression. expressions are compiled the first time
+// they're seen and then reused, so the same text in a loop or on a later live preview
+// pass isn't parsed again.
+double PartCompiler::evaluate (const QString &token, State &state) {
+    bool ok;
+    double value = token.toDouble(&ok);
+    if (ok)
+        return value;
+    auto expr = expressions.constFind(token);
+    if (expr == expressions.constEnd()) {
+        if (expressions.size() >= MaxCachedExpressions)
+            expressions.clear();
+        expr = expressions.insert(token, Expression(token));
+    }
+    bool usedvars;
+    value = expr->evaluate(state.vars, &usedvars);
+    if (usedvars)
+        state.expanded = true;
+    return value;
+}
+
+// replaces every ${expr} in text with its value. $${ is a literal ${.
+QString PartCompiler::expand (const QString &text, State &state) {
+    QString result;
+    int pos = 0;
+    for (int start; (start = text.indexOf("${", pos)) >= 0; ) {
+        if (start > pos && text[start - 1] == '$') {
+            result += text.midRef(pos, start - pos - 1);
+            result += QLatin1String("${");
+            pos = start + 2;
+            continue;
+        }
+        int end = text.indexOf('}', start + 2);
+        if (end < 0)
+            throw std::runtime_error("missing '}' after '${'");
+        result += text.midRef(pos, start - pos);
+        result += QString::number(evaluate(text.mid(start + 2, end - start - 2).trimmed(), state), 'g', 10);
+        pos = end + 1;
+    }
+    result += text.midRef(pos);
+    return result;
+}
+
+void PartCompiler::setScriptPath (const QString &filename) {
+    QString dir = (filename == "" ? QString() : QFileInfo(filename).absolutePath());
+    if (dir != basedir)
+        reset();
+    basedir = dir;
+}
+
+bool PartCompiler::tablesChanged () const {
+    for (auto table = tables.cbegin(); table != tables.cend(); ++ table)
+        if (QFileInfo(table.key()).lastModified() != table.value())
+            return true;
+    return false;
+}
+
+Part PartCompiler::compile (const QString &text) {
+
+    MemStageScope parsing(StageParse);
+    State state;
+    QList<Checkpoint> newcps;
+    int start = 0, line = 0;
+    // old checkpoints past the edit that we might converge with, and how far they moved.
+    int cand = 0, ncand = 0, offdelta = 0, linedelta = 0;
+
+    reparsed = 0;
+
+    if (valid && tablesChanged())
+        reset();
+
+    if (valid && !checkpoints.empty()) {
+        const int oldlen = prevtext.size(), newlen = text.size(), minlen = qMin(oldlen, newlen);
+        const QChar *a = prevtext.constData(), *b = text.constData();
+        int prefix = 0, suffix = 0;
+        while (prefix < minlen && a[prefix] == b[prefix])
+            ++ prefix;
+        if (prefix == oldlen && prefix == newlen)
+            return prevfinal.first ? *prevfinal.first : finish(prevfinal.part, prevfinal.gotpcbms);
+        while (suffix < minlen - prefix && a[oldlen - 1 - suffix] == b[newlen - 1 - suffix])
+            ++ suffix;
+        // restart at the last checkpoint at or before the first changed character.
+        int k = checkpoints.size() - 1;
+        while (k > 0 && checkpoints[k].offset > prefix)
+            -- k;
+        const Checkpoint &cp = checkpoints[k];
+        state = cp.state;
+        if (!state.nblocks) {
+            state.part.pins = prevfinal.part.pins.mid(0, cp.npins);
+            state.part.pcbholes = prevfinal.part.pcbholes.mid(0, cp.nholes);
+            state.part.pcbmarks = prevfinal.part.pcbmarks.mid(0, cp.nmarks);
+        }
+        start = cp.offset;
+        line = cp.line;
+        newcps = checkpoints.mid(0, k + 1);
+        // only checkpoints whose entire preceding line break is in the unchanged suffix
+        // are still at the start of a line in the new text.
+        const int oldeditend = oldlen - suffix;
+        offdelta = newlen - oldlen;
+        linedelta = text.midRef(prefix, newlen - suffix - prefix).count('\n') -
+                prevtext.midRef(prefix, oldeditend - prefix).count('\n');
+        cand = k + 1;
+        while (cand < checkpoints.size() && checkpoints[cand].offset - 1 < oldeditend)
+            ++ cand;
+        ncand = checkpoints.size();
+    } else {
+        newcps.append(makeCheckpoint(0, 0, state));
+    }
+
+    try {
+
+        bool spliced = false;
+        while (start < text.size()) {
+            // converged with the previous run? then the rest of it is still good.
+            while (cand < ncand && checkpoints[cand].offset + offdelta < start)
+                ++ cand;
+            // the first block is kept whole, so it can't be spliced; it has to be closed
+            // by this run first (or not be there at all).
+            if (cand < ncand && checkpoints[cand].offset + offdelta == start &&
+                    (state.first || !prevfinal.first) && state.converged(checkpoints[cand].state)) {
+                const Checkpoint &old = checkpoints[cand];
+                const int dpins = state.part.pins.size() - old.npins;
+                const int dholes = state.part.pcbholes.size() - old.nholes;
+                const int dmarks = state.part.pcbmarks.size() - old.nmarks;
+                State done = prevfinal;
+                // the lists outside of blocks only ever grow: up to here they're this run's
+                // and the rest are the last run's. inside a block, this run's are the ones
+                // its header holds, which matched the last run's (see converged()).
+                const bool inside = state.inblock;
+                const Part &upto = (inside ? state.header->part : state.part);
+                done.part.pins = upto.pins + prevfinal.part.pins.mid(inside ? upto.pins.size() : old.npins);
+                done.part.pcbholes = upto.pcbholes + prevfinal.part.pcbholes.mid(inside ? upto.pcbholes.size() : old.nholes);
+                done.part.pcbmarks = upto.pcbmarks + prevfinal.part.pcbmarks.mid(inside ? upto.pcbmarks.size() : old.nmarks);
+                // what came from after the edit moved with it.
+                if (linedelta) {
+                    for (int n = upto.pins.size(); n < done.part.pins.size(); ++ n)
+                        done.part.pins[n].line += linedelta;
+                    for (int n = upto.pcbholes.size(); n < done.part.pcbholes.size(); ++ n)
+                        done.part.pcbholes[n].line += linedelta;
+                    for (int n = upto.pcbmarks.size(); n < done.part.pcbmarks.size(); ++ n)
+                        done.part.pcbmarks[n].line += linedelta;
+                }
+                for (int n = cand; n < ncand; ++ n) {
+                    Checkpoint moved = checkpoints[n];
+                    moved.line += linedelta;
+                    moved.offset += offdelta;
+                    moved.npins += dpins;
+                    moved.nholes += dholes;
+                    moved.nmarks += dmarks;
+                    newcps.append(moved);
+                }
+                done.first = state.first;
+                state = done;
+                spliced = true;
+                break;
+            }
+            if (line - newcps.last().line >= CheckpointInterval)
+                newcps.append(makeCheckpoint(line, start, state));
+            int end = text.indexOf('\n', start);
+            if (end < 0)
+                end = text.size();
+            QStringRef linetext = text.midRef(start, end - start);
+            if (linetext.endsWith('\r'))
+                linetext.chop(1);
+            parseLine(linetext, line, state);
+            ++ reparsed;
+            ++ line;
+            start = end + 1;
+        }
+
+        if (!spliced && state.indesc)
+            throw std::runtime_error("end of file in multiline description block");
+        if (!spliced && state.inblock)
+            throw std::runtime_error("end of file in part block (missing endpart?)");
+
+    } catch (...) {
+        reset();
+        throw;
+    }
+
+    prevtext = text;
+    prevfinal = state;
+    checkpoints = newcps;
+    valid = true;
+
+    // the editor shows the first part of multi-part scripts.
+    return state.first ? *state.first : finish(state.part, state.gotpcbms);
+
+}
+
+// reads a script a line at a time, so it's never all in memory. each part ... endpart
+// block is a part, starting from the state outside of the blocks (the directives before
+// the first block, plus any between blocks; see parseLine()), and goes to sink as soon
+// as it's closed. a script without blocks is one part, at the end, unless it has param
+// sweeps; those are left to the caller. no checkpoints are kept; the next compile(text)
+// starts over.
+void PartCompiler::streamParts (QIODevice *in, const std::function<void(const Part &)> &sink) {
+
+    MemStageScope parsing(StageParse);
+    State state;
+    QTextStream stream(in);
+    stream.setCodec("UTF-8");
+    QString line;
+
+    reset();
+    reparsed = 0;
+
+    try {
+        while (stream.readLineInto(&line)) {
+            const bool inblock = state.inblock;
+            parseLine(QStringRef(&line), reparsed, state);
+            ++ reparsed;
+            if (inblock && !state.inblock) {
+                sink(*state.block);
+                state.block.reset();
+            }
+        }
+        if (state.indesc)
+            throw std::runtime_error("end of file in multiline description block");
+        if (state.inblock)
+            throw std::runtime_error("end of file in part block (missing endpart?)");
+        if (!state.nblocks && state.sweep.isEmpty())
+            sink(finish(state.part, state.gotpcbms));
+    } catch (...) {
+        reset();
+        throw;
+    }
+
+    prevfinal = state;
+
+}
+
+// every part of a multi-part script, e.g. for building one opened in the editor.
+QList<Part> PartCompiler::compileParts (const QString &text, const QAtomicInt *cancel) const {
+    PartCompiler blocks;
+    blocks.basedir = basedir;
+    blocks.expressions = expressions;
+    QByteArray bytes = text.toUtf8();
+    QBuffer buffer(&bytes);
+    buffer.open(QBuffer::ReadOnly);
+    QList<Part> parts;
+    blocks.streamParts(&buffer, [&parts, cancel](const Part &part) {
+        if (cancel && cancel->loadRelaxed())
+            throw std::runtime_error("cancelled");
+        parts.append(part);
+    });
+    return parts;
+}
+
+// parts are handed to sink as they come out of streamParts(). sweeps need the whole
+// text, so for those it's read back in from the start. a sequential device can't be
+// read twice, so it's read whole and goes through compileVariants(text), which makes
+// a part of each part block as well.
+void PartCompiler::compileVariants (QIODevice *in, const std::function<void(const PartVariant &)> &sink) {
+    if (in->isSequential()) {
+        for (const PartVariant &variant : compileVariants(QString::fromUtf8(in->readAll())))
+            sink(variant);
+        return;
+    }
+    const qint64 origin = in->pos();
+    streamParts(in, [&sink](const Part &part) { sink(PartVariant{ Variables(), part }); });
+    if (prevfinal.sweep.isEmpty())
+        return;
+    if (!in->seek(origin))
+        throw std::runtime_error(in->errorString().toStdString());
+    for (const PartVariant &variant : compileVariants(QString::fromUtf8(in->readAll())))
+        sink(variant);
+}
+
+QList<PartVariant> PartCompiler::compileVariants (QIODevice *in) {
+    QList<PartVariant> variants;
+    compileVariants(in, [&variants](const PartVariant &variant) { variants.append(variant); });
+    return variants;
+}
+
+int PartCompiler::partCount () const {
+    return qMax(prevfinal.nblocks, 1);
+}
+
+int PartCompiler::variantCount () const {
+    int count = 1;
+    for (const QList<double> &values : prevfinal.sweep)
+        count *= values.size();
+    return count;
+}
+
+QList<PartVariant> PartCompiler::compileVariants (const QString &text, const QAtomicInt *cancel) const {
+
+    QVector<QStringRef> lines = text.splitRef('\n');
+    for (QStringRef &line : lines)
+        if (line.endsWith('\r'))
+            line.chop(1);
+
+    PartCompiler shared;
+    shared.basedir = basedir;
+
+    // everything up to the first line that uses a variable is the same for every variant,
+    // so parse that once and start each variant from there. the line that turns out to
+    // use one is taken back out again. lines only ever append to the pin/hole/mark lists
+    // (endpart, which doesn't, can't use a variable), so they're undone by count; the
+    // rest of the state is saved without them, since a copy sharing them would have
+    // them copied again on every append.
+    State prefix;
+    QList<Part> prefixblocks;
+    int first = 0;
+    for (; first < lines.size(); ++ first) {
+        const int npins = prefix.part.pins.size(), nholes = prefix.part.pcbholes.size(), nmarks = prefix.part.pcbmarks.size();
+        QList<Pin> pins;
+        QList<Hole> holes;
+        QList<Marking> marks;
+        pins.swap(prefix.part.pins);
+        holes.swap(prefix.part.pcbholes);
+        marks.swap(prefix.part.pcbmarks);
+        State saved = prefix;
+        prefix.part.pins.swap(pins);
+        prefix.part.pcbholes.swap(holes);
+        prefix.part.pcbmarks.swap(marks);
+        shared.parseLine(lines[first], first, prefix);
+        if (prefix.expanded) {
+            saved.part.pins = prefix.part.pins.mid(0, npins);
+            saved.part.pcbholes = prefix.part.pcbholes.mid(0, nholes);
+            saved.part.pcbmarks = prefix.part.pcbmarks.mid(0, nmarks);
+            prefix = saved;
+            break;
+        }
+        if (prefix.block) {
+            prefixblocks.append(*prefix.block);
+            prefix.block.reset();
+        }
+    }
+
+    QList<Variables> combos = { Variables() };
+    for (auto param = prefix.sweep.cbegin(); param != prefix.sweep.cend(); ++ param) {
+        QList<Variables> next;
+        for (const Variables &combo : combos) {
+            for (double value : param.value()) {
+                next.append(combo);
+                next.last()[param.key()] = value;
+            }
+        }
+        if (next.size() > MaxVariants)
+            throw std::runtime_error(QString("too many variants (max %1)").arg((int)MaxVariants).toStdString());
+        combos = next;
+    }
+
+    struct Result {
+        PartVariant variant;
+        QString error;
+        QList<Part> blocks;
+    };
+
+    // exceptions don't make it out of qtconcurrent intact, so they're passed back as text.
+    std::function<Result(const Variables &)> compileOne = [&](const Variables &params) {
+        Result result;
+        result.variant.params = params;
+        result.blocks = prefixblocks;
+        try {
+            if (cancel && cancel->loadRelaxed())
+                throw std::runtime_error("cancelled");
+            PartCompiler worker;
+            worker.basedir = basedir;
+            worker.expressions = shared.expressions;
+            State state = prefix;
+            for (auto param = params.cbegin(); param != params.cend(); ++ param)
+                state.vars[param.key()] = param.value();
+            for (int n = first; n < lines.size(); ++ n) {
+                worker.parseLine(lines[n], n, state);
+                if (state.block) {
+                    if (cancel && cancel->loadRelaxed())
+                        throw std::runtime_error("cancelled");
+                    result.blocks.append(*state.block);
+                    state.block.reset();
+                }
+            }
+            if (state.indesc)
+                throw std::runtime_error("end of file in multiline description block");
+            if (state.inblock)
+                throw std::runtime_error("end of file in part block (missing endpart?)");
+            if (!state.nblocks)
+                result.variant.part = finish(state.part, state.gotpcbms);
+        } catch (const std::exception &x) {
+            QStringList values;
+            for (auto param = params.cbegin(); param != params.cend(); ++ param)
+                values.append(QString("%1=%2").arg(param.key()).arg(param.value()));
+            result.error = QString("%1 (%2)").arg(x.what(), values.join(", "));
+        }
+        return result;
+    };
+
+    QList<Result> results = QtConcurrent::blockingMapped<QList<Result> >(combos, compileOne);
+
+    QList<PartVariant> variants;
+    for (const Result &result : results) {
+        if (result.error != "")
+            throw std::runtime_error(result.error.toStdString());
+        if (!result.blocks.isEmpty() && !result.variant.params.isEmpty())
+            throw std::runtime_error("param sweeps can't be used in scripts with part blocks");
+        // a script with part blocks makes one part per block instead of its own.
+        if (result.blocks.isEmpty())
+            variants.append(result.variant);
+        for (const Part &part : result.blocks)
+            variants.append(PartVariant{ Variables(), part });
+    }
+    return variants;
+
+}
+
+// pin tables are .txt files too, so a directory of scripts can hold them. this drops
+// the ones any of the files names in a pintable directive. it's only a scan, not a
+// compile, so a table named with ${...} isn't caught.
+QStringList PartCompiler::withoutPinTables (const QStringList &files) {
+
+    PartCompiler scanner;
+    QSet<QString> tables;
+    QString line;
+    for (const QString &filename : files) {
+        QFile file(filename);
+        if (!file.open(QFile::ReadOnly | QFile::Text))
+            continue;
+        const QDir dir = QFileInfo(filename).absoluteDir();
+        QTextStream stream(&file);
+        stream.setCodec("UTF-8");
+        while (stream.readLineInto(&line)) {
+            if (!line.contains(QLatin1String("pintable"), Qt::CaseInsensitive))
+                continue;
+            scanner.tokenize(QStringRef(&line));
+            if (matches(scanner.tokens, "pintable", 1, INT_MAX))
+                tables.insert(QDir::cleanPath(dir.absoluteFilePath(scanner.tokens[1])));
+        }
+    }
+
+    QStringList scripts;
+    for (const QString &filename : files)
+        if (!tables.contains(QDir::cleanPath(QFileInfo(filename).absoluteFilePath())))
+            scripts.append(filename);
+    return scripts;
+
+}
+
+// splits a line into whitespace separated tokens, with the same rules as std::quoted:
+// a token starting with " runs to the next unescaped ", and \ escapes the character
+// after it. the strings in tokens are written over in place so their buffers are
+// reused from line to line, and leftovers are parked in sparetokens for later.
+void PartCompiler::tokenize (const QStringRef &line) {
+
+    auto blank = [](QChar ch) {
+        return ch == ' ' || ch == '\t' || ch == '\n' || ch == '\v' || ch == '\f' || ch == '\r';
+    };
+
+    const QChar *p = line.constData(), *end = p + line.size();
+    int count = 0;
+    while (true) {
+        while (p < end && blank(*p))
+            ++ p;
+        if (p == end)
+            break;
+        if (count == tokens.size())
+            tokens.append(sparetokens.isEmpty() ? QString() : sparetokens.takeLast());
+        QString &token = tokens[count ++];
+        token.resize(0); // keeps capacity
+        if (*p == '"') {
+            for (++ p; p < end && *p != '"'; ++ p) {
+                if (*p == '\\' && ++ p == end)
+                    break;
+                token += *p;
+            }
+            if (p < end)
+                ++ p;
+        } else {
+            const QChar *word = p;
+            while (p < end && !blank(*p))
+                ++ p;
+            token.append(word, p - word);
+        }
+    }
+
+    while (tokens.size() > count)
+        sparetokens.append(tokens.takeLast());
+    while (!tokens.empty() && tokens.back().isEmpty())
+        sparetokens.append(tokens.takeLast());
+
+}
+
+// lineno is stamped on the pins, holes and markings the line adds.
+void PartCompiler::parseLine (const QStringRef &rawline, int lineno, State &state) {
+
+    QStringRef line = rawline;
+    QString expanded;
+    if (line.contains(QLatin1String("${")) && (state.indesc || !line.trimmed().startsWith(QLatin1Char('#')))) {
+        expanded = expand(line.toString(), state);
+        line = QStringRef(&expanded);
+    }
+
+    // ---- tokenize
+
+    {
+        MemStageScope tokenizing(StageTokenize);
+        // multiline description is special case; its lines go straight into the text.
+        const QStringRef tline = line.trimmed();
+        if (!state.indesc && !tline.compare(QLatin1String("description:"), Qt::CaseInsensitive)) {
+            state.indesc = true;
+            return;
+        } else if (state.indesc && !tline.compare(QLatin1String(":description"), Qt::CaseInsensitive)) {
+            state.indesc = false;
+            return;
+        } else if (state.indesc) {
+            QString &description = state.part.metadata[MetaDescription];
+            if (!tline.isEmpty())
+                description += line;
+            description += '\n';
+            return;
+        } else {
+            tokenize(line);
+            if (tokens.empty() || tokens[0].startsWith('#'))
+                return;
+        }
+    }
+
+    // ---- parse
+
+    Part &part = state.part;
+    double &curhole = state.curhole, &curring = state.curring, &curx = state.curx, &cury = state.cury;
+    int &curnumber = state.curnumber;
+    bool &origleft = state.origleft, &origtop = state.origtop, &gotpcbms = state.gotpcbms;
+    const int metakey = Metadata::keyOf(tokens[0].toLower());
+    const int npins = part.pins.size(), nholes = part.pcbholes.size(), nmarks = part.pcbmarks.size();
+
+    auto num = [&](const QString &token) { return evaluate(token, state); };
+    auto integer = [&](const QString &token) { return (int)lround(evaluate(token, state)); };
+    auto coord = [&](double cur, const QString &token) {
+        return token.startsWith("@") ? cur + num(token.mid(1)) : num(token);
+    };
+
+    if (matches(tokens, "units", 1))
+        part.units = tokens[1].toLower();
+    else if (matches(tokens, "width", 1))
+        part.width = num(tokens[1]);
+    else if (matches(tokens, "height", 1))
+        part.height = num(tokens[1]);
+    else if (matches(tokens, "outline", 1))
+        part.outline = num(tokens[1]);
+    else if (matches(tokens, "pthhole", 1))
+        curhole = num(tokens[1]);
+    else if (matches(tokens, "pthring", 1))
+        curring = num(tokens[1]);
+    else if (matches(tokens, "pin", 2, 4) || matches(tokens, "pins", 3, 5)) {
+        // "pins count ..." is the same as count pin directives; with @ offsets that makes a row.
+        int count = 1, arg = 1;
+        if (!tokens[0].compare("pins", Qt::CaseInsensitive)) {
+            count = integer(tokens[arg ++]);
+            if (count < 0)
+                throw std::runtime_error(QString("invalid pin count: %1").arg(tokens[1]).toStdString());
+        }
+        for (int n = 0; n < count; ++ n) {
+            Pin pin;
+            pin.hole = curhole;
+            pin.ring = curring;
+            pin.x = coord(curx, tokens[arg]);
+            pin.y = coord(cury, tokens[arg + 1]);
+            pin.name = tokens.value(arg + 2).trimmed();
+            pin.square = !QString::compare(tokens.value(arg + 3), "square", Qt::CaseInsensitive);
+            pin.number = (curnumber ++);
+            pin.origleft = origleft; // have to store and then change origin later since
+            pin.origtop = origtop;   // width / height may not have been defined yet.
+            part.pins.append(pin);
+            curx = pin.x;
+            cury = pin.y;
+        }
+    } else if (matches(tokens, "pcbhole", 3)) {
+        Hole hole;
+        hole.x = coord(curx, tokens[1]);
+        hole.y = coord(cury, tokens[2]);
+        hole.diameter = fabs(num(tokens[3]));
+        //hole.ring = (tokens.size() > 4 ? fabs(tokens[4].toDouble()) : 0); // todo; maybe
+        hole.origleft = origleft; // same deal as with pins above
+        hole.origtop = origtop;
+        part.pcbholes.append(hole);
+        curx = hole.x;
+        cury = hole.y;
+    } else if (matches(tokens, "param", 2, INT_MAX)) {
+        if (state.expanded)
+            throw std::runtime_error("param directives must come before anything that uses a variable");
+        if (!QRegExp("[A-Za-z_][A-Za-z0-9_]*").exactMatch(tokens[1]) || Expression::isReservedName(tokens[1]))
+            throw std::runtime_error(QString("invalid param name: %1").arg(tokens[1]).toStdString());
+        QList<double> values = parseParamValues(tokens.mid(2));
+        state.sweep[tokens[1]] = values;
+        state.vars[tokens[1]] = values.first();
+    } else if (matches(tokens, "var", 2)) {
+        if (!QRegExp("[A-Za-z_][A-Za-z0-9_]*").exactMatch(tokens[1]) || Expression::isReservedName(tokens[1]))
+            throw std::runtime_error(QString("invalid variable name: %1").arg(tokens[1]).toStdString());
+        if (state.sweep.contains(tokens[1]))
+            throw std::runtime_error(QString("%1 is a param").arg(tokens[1]).toStdString());
+        state.vars[tokens[1]] = num(tokens[2]);
+    } else if (matches(tokens, "pintable", 1, INT_MAX)) {
+        readPinTable(tokens[1], tokens.mid(2), state);
+    } else if (matches(tokens, "color", 1))
+        part.color = tokens[1];
+    else if (matches(tokens, "corner", 1))
+        part.corner = num(tokens[1]);
+    else if (matches(tokens, "schematic", 1, 2)) {
+        part.schematic = tokens[1].toLower();
+        part.schematicmod = (tokens.size() > 2 ? tokens[2].toLower() : "");
+    } else if (matches(tokens, "scminsize", 2)) {
+        part.mingrid[0] = integer(tokens[1]) - 1;
+        part.mingrid[1] = integer(tokens[2]) - 1;
+    } else if (matches(tokens, "scgrow", 2)) {
+        part.extragrid[0] = abs(integer(tokens[1]));
+        part.extragrid[1] = abs(integer(tokens[2]));
+    } else if (matches(tokens, "sctext", 1)) {
+        part.sctext = tokens[1];
+    } else if (matches(tokens, "sclabels", 1)) {
+        part.scpinlabels = parseBool(tokens[1]);
+    } else if (matches(tokens, "scnumbers", 1)) {
+        part.scpinnumbers = parseBool(tokens[1]);
+    } else if (matches(tokens, "bbtext", 1, 3)) {
+        part.bbtext = tokens[1];
+        if (tokens.size() > 2) part.bbtextcolor = tokens[2];
+        if (tokens.size() > 3) part.bbtextsize = num(tokens[3]);
+    } else if (matches(tokens, "bblabels", 1, 3)) {
+        part.bbpinlabels = parseBool(tokens[1]);
+        if (tokens.size() > 2) part.bbpinlabelcolor = tokens[2];
+        if (tokens.size() > 3) part.bbpinlabelsize = num(tokens[3]);
+    } else if (matches(tokens, "origin", 1, INT_MAX)) {
+        for (int n = 1; n < tokens.size(); ++ n) {
+            if (tokens[n].startsWith("l", Qt::CaseInsensitive))
+                origleft = true;
+            else if (tokens[n].startsWith("r", Qt::CaseInsensitive))
+                origleft = false;
+            else if (tokens[n].startsWith("t", Qt::CaseInsensitive))
+                origtop = true;
+            else if (tokens[n].startsWith("b", Qt::CaseInsensitive))
+                origtop = false;
+        }
+    } else if (metakey >= 0 && metakey != MetaDescription && tokens.size() == 2) {
+        part.metadata[(MetaKey)metakey] = tokens[1].trimmed();
+    } else if (matches(tokens, "description", 0, 1)) {
+        QString &description = part.metadata[MetaDescription];
+        description += tokens.value(1);
+        description += '\n';
+    } else if (matches(tokens, "part", 0, 1)) {
+        // a block starts from everything outside of the blocks so far, which is put back
+        // at its endpart. a filename is optional shorthand.
+        if (state.inblock)
+            throw std::runtime_error("part block inside another part block (missing endpart?)");
+        if (!state.sweep.isEmpty())
+            throw std::runtime_error("param sweeps can't be used in scripts with part blocks");
+        State *header = new State(state);
+        header->header.reset();
+        header->first.reset();
+        header->block.reset();
+        state.header = QSharedPointer<const State>(header);
+        state.inblock = true;
+        ++ state.nblocks;
+        if (tokens.size() > 1)
+            part.filename = tokens[1];
+    } else if (matches(tokens, "endpart", 0)) {
+        if (!state.inblock)
+            throw std::runtime_error("endpart without part");
+        if (state.indesc)
+            throw std::runtime_error("endpart in multiline description block");
+        if (!state.sweep.isEmpty())
+            throw std::runtime_error("param sweeps can't be used in scripts with part blocks");
+        const QSharedPointer<const Part> block(new Part(finish(state.part, state.gotpcbms)));
+        const QSharedPointer<const Part> first = (state.first ? state.first : block);
+        const int nblocks = state.nblocks;
+        const QSharedPointer<const State> header = state.header;
+        state = *header;
+        state.nblocks = nblocks;
+        state.first = first;
+        state.block = block;
+        return;
+    } else if (matches(tokens, "filename", 1))
+        part.filename = tokens[1];
+    else if (matches(tokens, "property", 1, 2))
+        part.metaprops[tokens[1]] = tokens.value(2);
+    else if (matches(tokens, "tag", 1, INT_MAX) || matches(tokens, "tags", 1, INT_MAX)) {
+        for (int n = 1; n < tokens.size(); ++ n)
+            part.metatags.append(tokens[n]);
+    } else if (matches(tokens, "pcbstroke", 1)) {
+        gotpcbms = true;
+        part.pcbmarkstroke = num(tokens[1]);
+    } else if (matches(tokens, "pcbline", 4, 5)) {
+        double x1 = num(tokens[1]);
+        double y1 = num(tokens[2]);
+        double x2 = num(tokens[3]);
+        double y2 = num(tokens[4]);
+        Marking mark = Marking::makeLine(x1, y1, x2, y2, origleft, origtop);
+        if (tokens.size() > 5) {
+            if (tokens[5].compare("flat", Qt::CaseInsensitive))
+                throw std::runtime_error(QString("invalid line end: %1").arg(tokens[5]).toStdString());
+            mark.capped = false;
+        }
+        part.pcbmarks.append(mark);
+    } else if (matches(tokens, "pcbhline", 1)) {
+        double y = num(tokens[1]);
+        Marking mark = Marking::makeLine(0, y, 0, y, origleft, origtop);
+        mark.capped = false;
+        mark.x2reverse = true;
+        mark.xbackoff = true;
+        part.pcbmarks.append(mark);
+    } else if (matches(tokens, "pcbvline", 1)) {
+        double x = num(tokens[1]);
+        Marking mark = Marking::makeLine(x, 0, x, 0, origleft, origtop);
+        mark.capped = false;
+        mark.y2reverse = true;
+        mark.ybackoff = true;
+        part.pcbmarks.append(mark);
+    } else if (matches(tokens, "pcbdot", 3)) {
+        double x = num(tokens[1]);
+        double y = num(tokens[2]);
+        double d = num(tokens[3]);
+        part.pcbmarks.append(Marking::makeCircle(x, y, d, origleft, origtop));
+    //} else if (matches(tokens, "pcbarrows", 3, 4)) { // arrowedge edge arrowwidth arrowlength [count=1]
+    } else
+        throw std::runtime_error(QString("unknown directive: %1").arg(tokens.join(",")).toStdString());
+
+    for (int n = npins; n < part.pins.size(); ++ n)
+        part.pins[n].line = lineno;
+    for (int n = nholes; n < part.pcbholes.size(); ++ n)
+        part.pcbholes[n].line = lineno;
+    for (int n = nmarks; n < part.pcbmarks.size(); ++ n)
+        part.pcbmarks[n].line = lineno;
+
+}
+
+// adds a pin for every row of a pin table, exactly as if it were a pin directive (so
+// the current pthhole/pthring, origin and @ position all apply), but without going
+// through the script tokenizer.
+void PartCompiler::readPinTable (const QString &filename, const QStringList &options, State &state) {
+
+    const QString path = QDir(basedir).absoluteFilePath(filename);
+    tables[path] = QFileInfo(path).lastModified();
+
+    PinTableReader reader(path, options);
+
+    double scale = 1;
+    if (reader.units() != "" && reader.units() != state.part.units) {
+        double from = unitsPerInch(reader.units()), to = unitsPerInch(state.part.units);
+        if (from <= 0 || to <= 0)
+            throw std::runtime_error(QString("pintable: can't convert %1 to %2").arg(reader.units(), state.part.units).toStdString());
+        scale = to / from;
+    }
+
+    QSet<int> used;
+    for (const Pin &pin : state.part.pins)
+        used.insert(pin.number);
+
+    PinTableRow row;
+    auto rowError = [&](const QString &message) {
+        return std::runtime_error(QString("%1:%2: %3").arg(QFileInfo(path).fileName()).arg(row.line).arg(message).toStdString());
+    };
+    auto value = [&](int column, double cur, bool relative) {
+        const QString &text = row.values[column];
+        bool rel = relative && text.startsWith("@"), ok;
+        double v = (rel ? text.mid(1) : text).toDouble(&ok) * scale;
+        if (!ok)
+            throw rowError(QString("invalid number: %1").arg(text));
+        return rel ? cur + v : v;
+    };
+
+    while (reader.next(&row)) {
+        Pin pin;
+        pin.x = value(PinXColumn, state.curx, true);
+        pin.y = value(PinYColumn, state.cury, true);
+        pin.hole = (row.values[PinHoleColumn] == "" ? state.curhole : fabs(value(PinHoleColumn, 0, false)));
+        pin.ring = (row.values[PinRingColumn] == "" ? state.curring : fabs(value(PinRingColumn, 0, false)));
+        pin.name = row.values[PinNameColumn];
+        pin.square = QStringList({ "square", "rect", "rectangle" }).contains(row.values[PinShapeColumn], Qt::CaseInsensitive);
+        if (row.values[PinNumberColumn] != "") {
+            bool ok;
+            pin.number = row.values[PinNumberColumn].toInt(&ok);
+            if (!ok || pin.number < 1)
+                throw rowError(QString("invalid pin number: %1").arg(row.values[PinNumberColumn]));
+            if (used.contains(pin.number))
+                throw rowError(QString("pin number %1 used more than once").arg(pin.number));
+            state.curnumber = qMax(state.curnumber, pin.number + 1);
+        } else {
+            while (used.contains(state.curnumber))
+                ++ state.curnumber;
+            pin.number = (state.curnumber ++);
+        }
+        used.insert(pin.number);
+        pin.origleft = state.origleft;
+        pin.origtop = state.origtop;
+        state.part.pins.append(pin);
+        state.curx = pin.x;
+        state.cury = pin.y;
+    }
+
+}
+
+Part PartCompiler::finish (Part part, bool gotpcbms) {
+
+    // now that we probably have width/height, apply origin settings
+    setDeferredPos(part.width, part.height, part.pins);
+    setDeferredPos(part.width, part.height, part.pcbholes);
+    setDeferredPos(part.width, part.height, part.pcbmarks);
+
+    // same with hline/vline outline width correction
+    if (part.outline > 0) {
+        auto backoff = [](double &a, double &b, double off) {
+            if (a < b) { a += off; b -= off; }
+            else { a -= off; b += off; }
+        };
+        double off = part.outline; // / 2.0; // (in theory, /2 works; in practice, aisler sometimes messes it up)
+        for (Marking &m : part.pcbmarks) {
+            if (m.xbackoff) backoff(m.x1, m.x2, off);
+            if (m.ybackoff) backoff(m.y1, m.y2, off);
+            m.xbackoff = m.ybackoff = false;
+        }
+    }
+
+    // ---- fill in some defaults
+
+    Metadata &meta = part.metadata;
+
+    // $name is replaced with that metadata value (??? if there's no such thing), $$ is a $.
+    auto metaval = [&part](const QString &value) {
+        static const QRegularExpression re("\\$(\\$|[A-Za-z_][A-Za-z0-9_]*)");
+        QString result;
+        int pos = 0;
+        for (auto it = re.globalMatch(value); it.hasNext(); ) {
+            QRegularExpressionMatch m = it.next();
+            result += value.midRef(pos, m.capturedStart() - pos);
+            const QString name = m.captured(1);
+            const int key = Metadata::keyOf(name.toLower());
+            result += (name == "$" ? QString("$") : key < 0 ? QString("???") : part.metadata[(MetaKey)key]);
+            pos = m.capturedEnd();
+        }
+        result += value.midRef(pos);
+        return result;
+    };
+
+    meta[MetaDescription] = meta[MetaDescription].trimmed();
+
+    // one pass, in dependency order.
+    if (part.filename == "")
+        part.filename = meta.first({ MetaModuleId, MetaTitle, MetaPartNumber, MetaFamily });
+    if (part.filename == "") {
+        throw std::runtime_error("could not determine output filename: you must specify at "
+                                 "least one of: filename, moduleid, title, partnumber, or family");
+    }
+    meta.setDefault(MetaPartNumber, meta.first({ MetaTitle, MetaFamily }, part.filename));
+    meta.setDefault(MetaFamily, meta[MetaPartNumber]);
+    meta.setDefault(MetaTitle, meta.first({ MetaPartNumber, MetaFamily }));
+    meta.setDefault(MetaVariant, meta.get(MetaPartNumber, "variant 1"));
+    meta.setDefault(MetaDescription, meta[MetaTitle]);
+    meta.setDefault(MetaVersion, "1");
+    meta.setDefault(MetaLabel, "U");
+    meta.setDefault(MetaModuleId, part.filename);
+    // url can be left blank
+
+    part.sctext = metaval(part.sctext);
+    part.bbtext = metaval(part.bbtext);
+
+    if (part.outline > 0 && !gotpcbms)
+        part.pcbmarkstroke = part.outline * 0.75;
+
+    // ----
+
+    qDebug() << "size" << part.width << part.height << part.units;
+    qDebug() << "outline" << part.outline;
+    for (const Pin &pin : part.pins)
+        qDebug() << "  pin" << pin.number << pin.name << "@" << pin.x << pin.y << "d=" << pin.hole << "r=" << pin.ring << (pin.square ? "square" : "round");
+
+    return part;
+
+}
+
+
+
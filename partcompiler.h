@@ -0,0 +1,119 @@
+/*----------------------------------------------------------------------
+Fritzpart - Generates Fritzing parts from a part description script.
+Copyright (C) 2021, Jason Cipriani <jason.cipriani.dev@gmail.com>
+Not affiliated with Fritzing.
+
+This file is part of Fritzpart.
+
+Fritzpart is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+https://github.com/JC3/fritzpart
+----------------------------------------------------------------------*/
+
+#ifndef PARTCOMPILER_H
+#define PARTCOMPILER_H
+
+#include <QString>
+#include <QSharedPointer>
+#include <QAtomicInt>
+#include <QStringList>
+#include <QList>
+#include <QHash>
+#include <QDateTime>
+#include <QIODevice>
+#include <functional>
+#include "part.h"
+#include "expression.h"
+
+struct PartVariant {
+    Variables params;
+    Part part;
+};
+
+// turns script text into a Part. the parser has carried state (current @ position,
+// pth hole/ring, pin number, origin, ...), so every CheckpointInterval lines we save a
+// copy of it. when compile() is called again with edited text we restart from the
+// last checkpoint before the edit, and as soon as the state after the edit matches
+// a checkpoint from the previous run we splice the rest of the old result back in.
+// pin tables read by the script are remembered too; if one of them changes on disk
+// everything is parsed again from scratch.
+//
+// scripts with param sweeps are compiled with their first value of each param by
+// compile(); compileVariants() builds every combination. scripts can also hold many
+// parts in part ... endpart blocks; compile() gives the first of them, and
+// compileParts() or compileVariants() all of them. those two give up (throw) between
+// variants or blocks once cancel, if given, becomes nonzero.
+class PartCompiler {
+public:
+    enum { CheckpointInterval = 256, MaxVariants = 10000, MaxCachedExpressions = 4096 };
+    PartCompiler () : valid(false), reparsed(0) { }
+    Part compile (const QString &text);
+    void reset ();
+    void setScriptPath (const QString &filename); // relative pintable paths are relative to this
+    int lastReparsedLines () const { return reparsed; }
+    int variantCount () const; // of the last compiled script
+    int partCount () const;    // part blocks in the last compiled script (1 if none)
+    QHash<QString,QDateTime> pinTables () const { return tables; } // read by the last compile, path -> mtime
+    QList<PartVariant> compileVariants (const QString &text, const QAtomicInt *cancel = nullptr) const;
+    QList<PartVariant> compileVariants (QIODevice *in);
+    void compileVariants (QIODevice *in, const std::function<void(const PartVariant &)> &sink);
+    QList<Part> compileParts (const QString &text, const QAtomicInt *cancel = nullptr) const;
+    static QStringList withoutPinTables (const QStringList &files);
+private:
+    struct State {
+        double curhole, curring, curx, cury;
+        int curnumber;
+        bool origleft, origtop, gotpcbms;
+        bool indesc;
+        bool inblock;  // between part and endpart
+        int nblocks;   // part blocks so far
+        bool expanded; // used a variable yet
+        Variables vars;
+        QMap<QString,QList<double> > sweep;
+        Part part; // in checkpoints before any block, pins/pcbholes/pcbmarks are empty; see counts below.
+        QSharedPointer<const State> header; // outside of blocks, restored at endpart
+        QSharedPointer<const Part> first;   // the first block, finished, once it's closed
+        QSharedPointer<const Part> block;   // the block the last endpart closed, finished
+        State () : curhole(0.9), curring(0.508), curx(0), cury(0), curnumber(1),
+            origleft(true), origtop(false), gotpcbms(false), indesc(false), inblock(false), nblocks(0),
+            expanded(false) { }
+        bool converged (const State &other) const;
+    };
+    struct Checkpoint {
+        int line;       // line number
+        int offset;     // character offset of start of line
+        int npins, nholes, nmarks;
+        State state;
+    };
+    void parseLine (const QStringRef &line, int lineno, State &state);
+    void streamParts (QIODevice *in, const std::function<void(const Part &)> &sink);
+    void tokenize (const QStringRef &line);
+    void readPinTable (const QString &filename, const QStringList &options, State &state);
+    bool tablesChanged () const;
+    double evaluate (const QString &token, State &state);
+    QString expand (const QString &text, State &state);
+    static Checkpoint makeCheckpoint (int line, int offset, const State &state);
+    static Part finish (Part part, bool gotpcbms);
+    bool valid;
+    int reparsed;
+    QString prevtext;
+    State prevfinal; // state at end of last run, i.e. before deferred positions and defaults
+    QList<Checkpoint> checkpoints;
+    QString basedir;
+    QHash<QString,QDateTime> tables; // pin table path -> modification time when read
+    QHash<QString,Expression> expressions; // compiled, by source text
+    QStringList tokens, sparetokens; // current line; reused from line to line
+};
+
+#endif // PARTCOMPILER_H
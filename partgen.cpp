@@ -0,0 +1,1047 @@
+/*----------------------------------------------------------------------
+Fritzpart - Generates Fritzing parts from a part description script.
+Copyright (C) 2021, Jason Cipriani <jason.cipriani.dev@gmail.com>
+Not affiliated with Fritzing.
+
+This file is part of Fritzpart.
+
+Fritzpart is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+https://github.com/JC3/fritzpart
+----------------------------------------------------------------------*/
+
+#include "partgen.h"
+#include "atomicfile.h"
+#include "memstats.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QTextStream>
+#include <QTemporaryDir>
+#include <QProcess>
+#include <QDate>
+#include <QRegExp>
+#include <QRectF>
+#include <QDebug>
+#include <QSettings>
+#include <QCoreApplication>
+#include <QtConcurrent>
+#include <functional>
+#include <stdexcept>
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+static QDomElement initDocument (QDomDocument &doc, QString root) {
+    QDomProcessingInstruction dec = doc.createProcessingInstruction("xml", "version=\"1.0\" encoding=\"UTF-8\" standalone=\"no\"");
+    QDomComment info = doc.createComment("Generated by fritzpart.");
+    QDomElement node = doc.createElement(root);
+    // hack alert
+    if (root == "svg")
+        node.setAttribute("xmlns", "http://www.w3.org/2000/svg");
+    // moving on...
+    doc.appendChild(dec);
+    doc.appendChild(info);
+    doc.appendChild(node);
+    return node;
+}
+
+
+static QDomElement appendElement (QDomNode node, QString tag, QString id = QString()) {
+    QDomElement el = node.ownerDocument().createElement(tag);
+    if (id != "")
+        el.setAttribute("id", id);
+    node.appendChild(el);
+    return el;
+}
+
+
+static QDomElement appendElement (QDomNode node, QDomElement el) {
+    node.appendChild(el);
+    return el;
+}
+
+
+template <typename T>
+static QString pretty (T p) {
+    return QString("%1").arg(p);
+}
+
+struct SVGStyle {
+    QString fill;
+    QString stroke;
+    double strokeWidth;
+};
+
+static QDomElement svgLine (QDomDocument doc, QString id, double x1, double y1, double x2, double y2, const SVGStyle &style, bool roundCaps = false) {
+    QDomElement line = doc.createElement("line");
+    if (id != "")
+        line.setAttribute("id", id);
+    line.setAttribute("x1", pretty(x1));
+    line.setAttribute("y1", pretty(y1));
+    line.setAttribute("x2", pretty(x2));
+    line.setAttribute("y2", pretty(y2));
+    line.setAttribute("fill", style.fill);
+    line.setAttribute("stroke", style.stroke);
+    line.setAttribute("stroke-width", pretty(style.strokeWidth));
+    if (roundCaps)
+        line.setAttribute("stroke-linecap", "round");
+    return line;
+}
+
+static QDomElement svgRect (QDomDocument doc, QString id, double x, double y, double w, double h, const SVGStyle &style, bool borderInside = false) {
+    QDomElement rect = doc.createElement("rect");
+    if (id != "")
+        rect.setAttribute("id", id);
+    rect.setAttribute("fill", style.fill);
+    rect.setAttribute("stroke", style.stroke);
+    rect.setAttribute("stroke-width", pretty(style.strokeWidth));
+    if (borderInside) {
+        rect.setAttribute("x", pretty(x + style.strokeWidth / 2.0));
+        rect.setAttribute("y", pretty(y + style.strokeWidth / 2.0));
+        rect.setAttribute("width", pretty(w - style.strokeWidth));
+        rect.setAttribute("height", pretty(h - style.strokeWidth));
+    } else {
+        rect.setAttribute("x", pretty(x - style.strokeWidth / 2.0));
+        rect.setAttribute("y", pretty(y - style.strokeWidth / 2.0));
+        rect.setAttribute("width", pretty(w + style.strokeWidth));
+        rect.setAttribute("height", pretty(h + style.strokeWidth));
+    }
+    return rect;
+}
+
+static QDomElement svgCircle (QDomDocument doc, QString id, double cx, double cy, double r, const SVGStyle &style, bool borderInside = false) {
+    QDomElement circle = doc.createElement("circle");
+    if (id != "")
+        circle.setAttribute("id", id);
+    circle.setAttribute("fill", style.fill);
+    circle.setAttribute("stroke", style.stroke);
+    circle.setAttribute("stroke-width", pretty(style.strokeWidth));
+    circle.setAttribute("cx", pretty(cx));
+    circle.setAttribute("cy", pretty(cy));
+    if (borderInside)
+        circle.setAttribute("r", pretty(r - style.strokeWidth / 2.0));
+    else
+        circle.setAttribute("r", pretty(r + style.strokeWidth / 2.0));
+    return circle;
+}
+
+enum SVGTextAlign { LeftAlign, CenterAlign, RightAlign, BottomCenterAlign, TopCenterAlign };
+
+struct SVGTextStyle {
+    QString color;
+    double size;
+};
+
+static const char * svgTextAnchor (SVGTextAlign align) {
+    switch (align) {
+    case LeftAlign: return "start";
+    case TopCenterAlign: return "middle";
+    case BottomCenterAlign: return "middle";
+    case CenterAlign: return "middle";
+    case RightAlign: return "end";
+    default: return "";
+    }
+}
+
+
+static QDomElement svgText (QDomDocument doc, QString content, double x, double y, const SVGTextStyle &style, SVGTextAlign align, double rotate = 0) {
+    QDomElement text = doc.createElement("text");
+    text.setAttribute("font-family", "'Droid Sans'");
+    text.setAttribute("stroke", "none");
+    text.setAttribute("stroke-width", 0);
+    text.setAttribute("fill", style.color);
+    text.setAttribute("font-size", pretty(style.size));
+    // Droid Sans cap-height / 2 = 0.357  (also x-height / 2 = 0.268)
+    double voffset = style.size * 0.357;
+    if (align == BottomCenterAlign)
+        voffset = 0;
+    else if (align == TopCenterAlign)
+        voffset = style.size;
+    if (fabs(rotate) > 1e-5) {
+        QString voffsettr = (fabs(voffset > 1e-5) ? QString(" translate(0,%1)").arg(voffset) : "");
+        text.setAttribute("transform", QString("translate(%1,%2) rotate(%3)%4")
+                          .arg(x).arg(y).arg(rotate).arg(voffsettr));
+    } else {
+        text.setAttribute("x", pretty(x));
+        text.setAttribute("y", pretty(y + voffset));
+    }
+    text.setAttribute("text-anchor", svgTextAnchor(align));
+    //text.setAttribute("dominant-baseline", "middle"); // fritzing ignores this :(
+    //text.setAttribute("dy", "0.5ex"); // it ignores dy too
+    // ^ see https://github.com/fritzing/fritzing-app/issues/3909
+    text.appendChild(doc.createTextNode(content));
+    return text;
+}
+
+
+QDomDocument generatePCB (const Part &part) {
+
+    QDomDocument svg;
+    QDomElement root = initDocument(svg, "svg");
+    QDomElement silkscreen = appendElement(root, "g", "silkscreen");
+    QDomElement copper = appendElement(appendElement(root, "g", "copper0"), "g", "copper1");
+
+    root.setAttribute("version", "1.1");
+    root.setAttribute("x", 0);
+    root.setAttribute("y", 0);
+    root.setAttribute("width", QString("%1%2").arg(part.width).arg(part.units));
+    root.setAttribute("height", QString("%1%2").arg(part.height).arg(part.units));
+    root.setAttribute("viewBox", QString("0 0 %1 %2").arg(part.width).arg(part.height));
+    root.setAttribute("id", "svg");
+
+    if (part.outline > 0) {
+        SVGStyle stsilk = { "none", "#000000", part.outline };
+        silkscreen.appendChild(svgRect(svg, "outline", 0, 0, part.width, part.height, stsilk, true));
+    }
+
+    for (const Pin &pin : part.pins) {
+        double r = pin.hole / 2.0;
+        QString id = QString("connector%1pin").arg(pin.number - 1);
+        SVGStyle stpad = { "none", "#f7bd13", pin.ring };
+        QDomElement circle = svgCircle(svg, "", pin.x, pin.y, r, stpad);
+        QDomElement pad;
+        if (pin.square) {
+            circle.setAttribute("id", id + "_circle");
+            QDomElement square = svgRect(svg, id + "_square", pin.x - r, pin.y - r, pin.hole, pin.hole, stpad);
+            QDomElement group = svg.createElement("g");
+            group.appendChild(square);
+            group.appendChild(circle);
+            pad = group;
+        } else {
+            pad = circle;
+        }
+        pad.setAttribute("id", id);
+        copper.appendChild(pad);
+    }
+
+    for (int n = 0; n < part.pcbholes.size(); ++ n) {
+        const Hole &hole = part.pcbholes[n];
+        QString id = QString("nonconn%1").arg(n);
+        SVGStyle sthole = { "black", "black", 0 };
+        copper.appendChild(svgCircle(svg, id, hole.x, hole.y, hole.diameter / 2.0, sthole));
+    }
+
+    if (part.pcbmarkstroke > 0) {
+        for (int n = 0; n < part.pcbmarks.size(); ++ n) {
+            const Marking &mark = part.pcbmarks[n];
+            QString id = QString("mark%1").arg(n);
+            if (mark.shape == Marking::Circle) {
+                double stroke = qMin(part.pcbmarkstroke, mark.diam / 2.0);
+                if (stroke < 1e-6)
+                    continue;
+                SVGStyle stmark = { "none", "#000000", stroke };
+                silkscreen.appendChild(svgCircle(svg, id, mark.x1, mark.y1, mark.diam/2.0, stmark, true));
+            } else if (mark.shape == Marking::Line) {
+                SVGStyle stmark = { "none", "#000000", part.pcbmarkstroke };
+                silkscreen.appendChild(svgLine(svg, id, mark.x1, mark.y1, mark.x2, mark.y2, stmark, mark.capped));
+            }
+        }
+    }
+
+    return svg;
+
+}
+
+
+QDomDocument generateBreadboard (const Part &part, QString layername) {
+
+    QDomDocument svg;
+    QDomElement root = initDocument(svg, "svg");
+    QDomElement bboard = appendElement(root, "g", layername);
+
+    root.setAttribute("version", "1.1");
+    root.setAttribute("x", 0);
+    root.setAttribute("y", 0);
+    root.setAttribute("width", QString("%1%2").arg(part.width).arg(part.units));
+    root.setAttribute("height", QString("%1%2").arg(part.height).arg(part.units));
+    root.setAttribute("viewBox", QString("0 0 %1 %2").arg(part.width).arg(part.height));
+    root.setAttribute("id", "svg");
+
+    if (part.outline > 0) {
+        SVGStyle st = { part.color, "#000000", part.outline };
+        QDomElement rect = appendElement(bboard, svgRect(svg, "part", 0, 0, part.width, part.height, st, true));
+        if (part.corner > 0) {
+            rect.setAttribute("rx", part.corner);
+            rect.setAttribute("ry", part.corner);
+        }
+    }
+
+    for (const Pin &pin : part.pins) {
+        QDomElement conn = appendElement(bboard, "g");
+        conn.setAttribute("transform", QString("translate(%1,%2)").arg(pin.x).arg(pin.y));
+        double r = pin.hole / 2.0;
+        QString id = QString("connector%1pin").arg(pin.number - 1);
+        SVGStyle stpad = { "#8c8c8c", "none", 0 };
+        QDomElement pad;
+        if (pin.square)
+            pad = svgRect(svg, id, -r, -r, pin.hole, pin.hole, stpad);
+        else
+            pad = svgCircle(svg, id, 0, 0, r, stpad);
+        conn.appendChild(pad);
+        if (part.bbpinlabels && pin.name != "") {
+            SVGTextStyle tstlabel = { part.bbpinlabelcolor, part.bbpinlabelsize };
+            const double inset = r + 0.35 * part.bbpinlabelsize; // i guess.
+            // sloppily find closest edge
+            struct EdgeMetrics { double e, dx, dy, rot; SVGTextAlign align; } metrics[] = {
+              { fabs(pin.x), 1, 0, 0, LeftAlign },
+              { fabs(part.width - pin.x), -1, 0, 0, RightAlign },
+              { fabs(pin.y), 0, 1, -90, RightAlign },
+              { fabs(part.height - pin.y), 0, -1, -90, LeftAlign }
+            };
+            EdgeMetrics *m = std::min_element(metrics, metrics + 4, [](auto &a, auto &b){return a.e<b.e;});
+            // well that was the weirdest code i've written in a while.
+            // todo: need a better way to control where these end up
+            conn.appendChild(svgText(svg, pin.name, m->dx*inset, m->dy*inset, tstlabel, m->align, m->rot));
+        }
+    }
+
+    if (part.bbtext != "") {
+        SVGTextStyle tstpart = { part.bbtextcolor, part.bbtextsize };
+        bboard.appendChild(svgText(svg, part.bbtext, part.width / 2.0, part.height / 2.0, tstpart, CenterAlign));
+    }
+
+    return svg;
+
+}
+
+
+QDomDocument generateIcon (const Part &part) {
+
+    // just use breadboard image for now
+    return generateBreadboard(part, "icon");
+
+}
+
+enum ScEdge { NoEdge = 0, Top, Bottom, Left, Right };
+
+struct ScPin {
+    int number;
+    int gridpos;
+    ScEdge edge;
+    QString name;
+    double pinpos;
+    ScPin () : number(-1), gridpos(-1), edge(NoEdge), pinpos(0) { }
+    explicit ScPin (const Pin &pin) : number(pin.number), gridpos(-1), edge(NoEdge), name(pin.name), pinpos(0) { }
+};
+
+enum ScStyle { Box, Header };
+enum ScHeaderStyle { Terminal, Male, Female };
+enum ScEdgeMode { HEdge, VEdge, HVEdge };
+
+struct ScPart {
+    int gridw;
+    int gridh;
+    QList<ScPin> pins;
+    bool haslpins;
+    bool hasrpins;
+    bool hastpins;
+    bool hasbpins;
+    ScPart () : gridw(0), gridh(0), haslpins(false), hasrpins(false), hastpins(false), hasbpins(false) { }
+};
+
+static ScPart scPlaceEdge (const Part &part, ScEdgeMode mode) {
+
+    ScPart sc;
+
+    // ---- figure out quadrant and edge of pins
+
+    QList<ScPin> lpins[2], rpins[2], tpins[2], bpins[2];
+    for (const Pin &pin : part.pins) {
+        ScPin scpin(pin);
+        double ldist = fabs(pin.x);
+        double rdist = fabs(part.width - pin.x);
+        double tdist = fabs(pin.y);
+        double bdist = fabs(part.height - pin.y);
+        bool h;
+        // should the pin be horizontal or vertical?
+        if (mode == HVEdge)
+            h = qMin(ldist, rdist) < qMin(tdist, bdist);
+        else
+            h = (mode == HEdge);
+        // [0] is top or left half of edge, [1] is bottom or right half
+        if (h) {
+            scpin.pinpos = pin.y;
+            (ldist < rdist ? lpins : rpins)[tdist < bdist ? 0 : 1].append(scpin);
+        } else {
+            scpin.pinpos = pin.x;
+            (tdist < bdist ? tpins : bpins)[ldist < rdist ? 0 : 1].append(scpin);
+        }
+    }
+
+    // ---- now pack all the pins into the grid
+
+    auto addpins = [](QList<ScPin> &scpins, QList<ScPin> pins[2], int nslots, ScEdge edge) {
+        assert(nslots >= pins[0].size() + pins[1].size());
+        // stable sort so pins at same location stay sorted by number.
+        std::stable_sort(pins[0].begin(), pins[0].end(), [](auto &a,auto &b){return a.pinpos<b.pinpos;}); // ascending!
+        std::stable_sort(pins[1].begin(), pins[1].end(), [](auto &a,auto &b){return b.pinpos<a.pinpos;}); // descending!
+        int pos = 0;
+        for (ScPin pin : pins[0]) {
+            pin.edge = edge;
+            pin.gridpos = (pos ++);
+            scpins.append(pin);
+        }
+        pos = nslots;
+        for (ScPin pin : pins[1]) {
+            pin.edge = edge;
+            pin.gridpos = (-- pos);
+            scpins.append(pin);
+        }
+        return (pins[0].size() + pins[1].size()) > 0;
+    };
+
+    sc.gridw = qMax(tpins[0].size() + tpins[1].size(), bpins[0].size() + bpins[1].size()) + part.extragrid[0];
+    sc.gridh = qMax(lpins[0].size() + lpins[1].size(), rpins[0].size() + rpins[1].size()) + part.extragrid[1];
+    sc.gridw = qMax(sc.gridw, part.mingrid[0]);
+    sc.gridh = qMax(sc.gridh, part.mingrid[1]);
+    sc.hastpins = addpins(sc.pins, tpins, sc.gridw, Top);
+    sc.hasbpins = addpins(sc.pins, bpins, sc.gridw, Bottom);
+    sc.haslpins = addpins(sc.pins, lpins, sc.gridh, Left);
+    sc.hasrpins = addpins(sc.pins, rpins, sc.gridh, Right);
+    // this sort isnt necessary, it's just to keep the svg a little more readable
+    std::sort(sc.pins.begin(), sc.pins.end(), pinNumberLess);
+
+    return sc;
+
+}
+
+
+static ScPart scPlaceLinear (const Part &part) {
+
+    ScPart sc;
+
+    int curpos = 0;
+    for (const Pin &pin : part.pins) {
+        ScPin scpin(pin);
+        scpin.gridpos = (curpos ++);
+        scpin.edge = Left;
+        sc.pins.append(scpin);
+    }
+
+    sc.gridw = 0;
+    sc.gridh = curpos;
+    sc.haslpins = true;
+
+    return sc;
+
+}
+
+
+QDomDocument generateSchematic (const Part &part) {
+
+    // ---- generate schematic
+
+    ScPart sc;
+    ScStyle style = Box;
+    ScHeaderStyle hdrstyle = Terminal;
+    if (part.schematic == "hedge")
+        sc = scPlaceEdge(part, HEdge);
+    else if (part.schematic == "vedge")
+        sc = scPlaceEdge(part, VEdge);
+    else if (part.schematic == "edge")
+        sc = scPlaceEdge(part, HVEdge);
+    else if (part.schematic == "header") {
+        sc = scPlaceLinear(part);
+        style = Header;
+        if (part.schematicmod == "male")
+            hdrstyle = Male;
+        else if (part.schematicmod == "female")
+            hdrstyle = Female;
+        else if (part.schematicmod == "terminal" || part.schematicmod == "")
+            hdrstyle = Terminal;
+        else
+            throw std::runtime_error(QString("unknown schematic header type: %1").arg(part.schematicmod).toStdString());
+    } else if (part.schematic == "block")
+        sc = scPlaceLinear(part);
+    else
+        throw std::runtime_error(QString("unknown schematic type: %1").arg(part.schematic).toStdString());
+
+    qDebug() << "schematic:" << sc.gridw << "x" << sc.gridh;
+    for (const ScPin &pin : sc.pins)
+        qDebug() << pin.number << pin.edge << pin.name << pin.pinpos << pin.gridpos;
+
+    // ---- generate svg from schematic
+#define PIN_CAPS 1
+
+    QDomDocument svg;
+    QDomElement root = initDocument(svg, "svg");
+    root.setAttribute("version", "1.1");
+    root.setAttribute("id", "svg");
+
+    const SVGStyle stline = { "none", "#000000", 0.7 / 7.2 };
+    const SVGStyle stpin = { "none", "#555555", 0.7 / 7.2 };
+    const SVGStyle stterm = { "none", "none", 0 };
+    const SVGTextStyle tstpart = { "#000000", 10.0 * 4.25 / 72.0 };
+    const SVGTextStyle tstpin = { "#555555", 10.0 * 3.5 / 72.0 };
+    const SVGTextStyle tstnum = { "#555555", 10.0 * 2.5 / 72.0 };
+    constexpr double PinLabelInset = 0.15; // not in graphics standard
+    constexpr double PinNumberOffset = 0.1; // not in graphics standard
+
+    if (style == Header) {
+
+        // ==== header style
+
+        // build viewbox as we go; todo: also do this for Box schematics below. i wrote this
+        // Header bit after the Box bit so this is a litte cleaner.
+        QRectF rcbox;
+        const double halfstr = stline.strokeWidth / 2.0;
+
+        QDomElement schem = appendElement(root, "g", "schematic");
+        QDomElement bg = appendElement(schem, "g", "background");
+        QDomElement pins = appendElement(schem, "g", "pins");
+
+        // male/female pin metrics from fritzing's generic_[fe]male_pin_headers.
+        // terminal metrics from fritzing's camdenboss connectors (roughly).
+        constexpr double PHSize = (2.0 - 9.928 / 7.2), PVSize = (3.6 - 1.643) / 7.2;
+        constexpr double TRadius = 2.9 / 7.2;
+        // the 2.9's on the next line don't need to match the one above
+        constexpr double TBoxHDist = (0.252 + 12.2 - 7.072 - 2.9) / 7.2, TBoxVDist = (4.5 - 2.9) / 7.2; // to outer edge
+
+        for (const ScPin &pin : sc.pins) {
+            QString idpref = QString("connector%1").arg(pin.number - 1);
+            QDomElement conn = appendElement(pins, "g", idpref);
+            // - - generate pins and decorations in the box (0,-.5) - (2,.5)
+            conn.appendChild(svgRect(svg, idpref + "terminal", 0, 0, 1e-5, 1e-5, stterm));
+            conn.appendChild(svgLine(svg, idpref + "pin", 0, 0, 1, 0, stpin, PIN_CAPS ? true : false));
+            if (hdrstyle == Male) {
+                conn.appendChild(svgLine(svg, "", 1.0, 0, 2.0, 0, stline));
+                conn.appendChild(svgLine(svg, "", 2.0, 0, 2.0 - PHSize, PVSize, stline, true));
+                conn.appendChild(svgLine(svg, "", 2.0, 0, 2.0 - PHSize, -PVSize, stline, true));
+            } else if (hdrstyle == Female) {
+                conn.appendChild(svgLine(svg, "", 1.0, 0, 2.0 - PHSize, 0, stline));
+                conn.appendChild(svgLine(svg, "", 2.0 - PHSize, 0, 2.0, PVSize, stline, true));
+                conn.appendChild(svgLine(svg, "", 2.0 - PHSize, 0, 2.0, -PVSize, stline, true));
+            } else if (hdrstyle == Terminal) {
+                conn.appendChild(svgLine(svg, "", 1.0, 0, 2.0 - 2.0 * TRadius, 0, stline));
+                conn.appendChild(svgCircle(svg, "", 2.0 - TRadius, 0, TRadius + 0.5*stline.strokeWidth /* bah */, stline, true));
+            }
+            if (part.scpinnumbers)
+                conn.appendChild(svgText(svg, QString("%1").arg(pin.number), 0.5, -0.5*stpin.strokeWidth - PinNumberOffset, tstnum, BottomCenterAlign));
+            // - - set position
+            conn.setAttribute("transform", QString("translate(0,%1)").arg(pin.gridpos));
+            rcbox = QRectF(0, -0.5, 2, 1)
+                    .adjusted(-halfstr, -halfstr, halfstr, halfstr)
+                    .translated(0, pin.gridpos)
+                    .united(rcbox);
+        }
+
+        if (hdrstyle == Terminal) {
+            QRectF rcblock = QRectF(QPointF(-TRadius, -TRadius), QPointF(TRadius, sc.gridh+TRadius-1))
+                    .adjusted(-TBoxHDist, -TBoxVDist, TBoxHDist, TBoxVDist)
+                    .translated(2.0 - TRadius, 0.0);
+            bg.appendChild(svgRect(svg, "block", rcblock.x(), rcblock.y(), rcblock.width(), rcblock.height(), stline, true));
+            rcbox = rcbox.united(rcblock);
+        }
+
+        root.setAttribute("x", 0);
+        root.setAttribute("y", 0);
+        root.setAttribute("width", QString("%1in").arg(rcbox.width() * 0.1));
+        root.setAttribute("height", QString("%1in").arg(rcbox.height() * 0.1));
+        root.setAttribute("viewBox", QString("%1 %2 %3 %4")
+                          .arg(rcbox.x()).arg(rcbox.y()).arg(rcbox.width()).arg(rcbox.height()));
+
+        if (!bg.hasChildNodes()) // drop the background group if we didn't use it for anything
+            bg.parentNode().removeChild(bg);
+
+        // ==== end header style
+
+    } else {
+
+        // ==== box style
+
+        QRect rcbox(-1, -1, qMax(1, sc.gridw) + 1, qMax(1, sc.gridh) + 1);
+        QRectF rcpart = rcbox.adjusted(sc.haslpins ? -1 : 0,
+                                       sc.hastpins ? -1 : 0,
+                                       sc.hasrpins ? 1 : 0,
+                                       sc.hasbpins ? 1 : 0);
+
+#if PIN_CAPS
+        rcpart.adjust(-stpin.strokeWidth / 2.0, -stpin.strokeWidth / 2.0,
+                      stpin.strokeWidth / 2.0, stpin.strokeWidth / 2.0);
+#endif
+
+        root.setAttribute("x", 0);
+        root.setAttribute("y", 0);
+        root.setAttribute("width", QString("%1in").arg(rcpart.width() * 0.1));
+        root.setAttribute("height", QString("%1in").arg(rcpart.height() * 0.1));
+        root.setAttribute("viewBox", QString("%1 %2 %3 %4")
+                          .arg(rcpart.x()).arg(rcpart.y())
+                          .arg(rcpart.width()).arg(rcpart.height()));
+
+        QDomElement schem = appendElement(root, "g", "schematic");
+        QDomElement pins = appendElement(schem, "g", "pins");
+        QDomElement labels = appendElement(schem, "g", "labels");
+
+        for (const ScPin &scpin : sc.pins) {
+            QPoint p1, p2, pt;
+            QPointF pl, pn;
+            SVGTextAlign la = CenterAlign;
+            double lr = 0;
+            if (scpin.edge == Top) {
+                pt = p1 = QPoint(scpin.gridpos, rcbox.top() - 1);
+                pl = p2 = QPoint(scpin.gridpos, rcbox.top());
+                la = RightAlign;
+                lr = -90;
+                pl += QPointF(0, stline.strokeWidth + PinLabelInset);
+                pn = QPointF(p1 + p2) / 2.0 - QPointF(stpin.strokeWidth / 2.0 + PinNumberOffset, 0);
+            } else if (scpin.edge == Bottom) {
+                pl = p1 = QPoint(scpin.gridpos, rcbox.bottom() + 1);
+                pt = p2 = QPoint(scpin.gridpos, rcbox.bottom() + 2);
+                la = LeftAlign;
+                lr = -90;
+                pl -= QPointF(0, stline.strokeWidth + PinLabelInset);
+                pn = QPointF(p1 + p2) / 2.0 - QPointF(stpin.strokeWidth / 2.0 + PinNumberOffset, 0);
+            } else if (scpin.edge == Left) {
+                pt = p1 = QPoint(rcbox.left() - 1, scpin.gridpos);
+                pl = p2 = QPoint(rcbox.left(), scpin.gridpos);
+                la = LeftAlign;
+                pl += QPointF(stline.strokeWidth + PinLabelInset, 0);
+                pn = QPointF(p1 + p2) / 2.0 - QPointF(0, stpin.strokeWidth / 2.0 + PinNumberOffset);
+            } else if (scpin.edge == Right) {
+                pl = p1 = QPoint(rcbox.right() + 1, scpin.gridpos);
+                pt = p2 = QPoint(rcbox.right() + 2, scpin.gridpos);
+                la = RightAlign;
+                pl -= QPointF(stline.strokeWidth + PinLabelInset, 0);
+                pn = QPointF(p1 + p2) / 2.0 - QPointF(0, stpin.strokeWidth / 2.0 + PinNumberOffset);
+            }
+            QDomElement term = appendElement(pins, svgRect(svg, QString("connector%1terminal").arg(scpin.number - 1), pt.x(), pt.y(), 1e-5, 1e-5, stterm));
+            //term.setAttribute("class", "terminal");
+            QDomElement conn = appendElement(pins, "line", QString("connector%1pin").arg(scpin.number - 1));
+            // todo: you can use svgLine now
+            conn.setAttribute("x1", p1.x());
+            conn.setAttribute("y1", p1.y());
+            conn.setAttribute("x2", p2.x());
+            conn.setAttribute("y2", p2.y());
+            conn.setAttribute("fill", stpin.fill);
+            conn.setAttribute("stroke", stpin.stroke);
+            conn.setAttribute("stroke-width", pretty(stpin.strokeWidth));
+#if PIN_CAPS
+            conn.setAttribute("stroke-linecap", "round");
+#endif
+            //conn.setAttribute("class", "pin");
+            if (part.scpinlabels && scpin.name != "")
+                labels.appendChild(svgText(svg, scpin.name, pl.x(), pl.y(), tstpin, la, lr));
+            if (part.scpinnumbers)
+                labels.appendChild(svgText(svg, QString("%1").arg(scpin.number), pn.x(), pn.y(), tstnum, BottomCenterAlign, lr));
+            // todo: utility function to generate a pin; origin at part-side point, then use
+            // transform(rotate) for vertical ones.
+        }
+
+        QDomElement outline = appendElement(schem, svgRect(svg, "outline", rcbox.x(), rcbox.y(),
+                                                           rcbox.width(), rcbox.height(), stline, true));
+        //outline.setAttribute("rx", stline.strokeWidth / 2.0);
+        //outline.setAttribute("ry", stline.strokeWidth / 2.0);
+
+        if (part.sctext != "") {
+            QPointF center = QRectF(rcbox).center();
+            if (part.schematic == "block") // todo: really need to change those QRects to QRectFs.
+                labels.appendChild(svgText(svg, part.sctext, 1 + rcbox.right() - PinLabelInset, center.y(), tstpart, TopCenterAlign, 90));
+            else
+                labels.appendChild(svgText(svg, part.sctext, center.x(), center.y(), tstpart, CenterAlign));
+        }
+
+        // === end box style
+
+    }
+
+    return svg;
+
+}
+
+
+static QDomElement appendSimple (QDomNode parent, QString tag, QString text) {
+    QDomElement el = parent.ownerDocument().createElement(tag);
+    el.appendChild(parent.ownerDocument().createTextNode(text));
+    parent.appendChild(el);
+    return el;
+}
+
+
+QDomDocument generateFZP (const Part &part, const PartFilenames &names) {
+
+    QDomDocument fzp;
+    QDomElement module = initDocument(fzp, "module");
+    module.setAttribute("referenceFile", names.fzp);
+    module.setAttribute("fritzingVersion", "0.9.9");
+    module.setAttribute("moduleId", part.metadata[MetaModuleId]);
+
+    appendSimple(module, "version", part.metadata[MetaVersion]);
+    appendSimple(module, "author", part.metadata[MetaAuthor]);
+    appendSimple(module, "title", part.metadata[MetaTitle]);
+    appendSimple(module, "label", part.metadata[MetaLabel]);
+    appendSimple(module, "date", QDate::currentDate().toString());
+    //appendSimple(module, "taxonomy", QString("part.dip.%1.pins").arg(part.pins.size())); // todo: ???
+    appendSimple(module, "description", part.metadata[MetaDescription]);
+    appendSimple(module, "url", part.metadata[MetaUrl]);
+
+    QDomElement tags = appendElement(module, "tags");
+    for (const QString &tag : part.metatags)
+        appendSimple(tags, "tag", tag);
+
+    // todo: fix the case-sensitive weirdness lurking in here
+    PropertyMap outprops = part.metaprops;
+    outprops["family"] = part.metadata.get(MetaFamily, outprops.value("family"));
+    outprops["variant"] = part.metadata.get(MetaVariant, outprops.value("variant"));
+    outprops["part number"] = part.metadata.get(MetaPartNumber, outprops.value("part number"));
+
+    QDomElement props = appendElement(module, "properties");
+    /*
+    appendSimple(props, "property", part.metadata.getValue("family", prefix)).setAttribute("name", "family");
+    appendSimple(props, "property", part.metadata["variant"]).setAttribute("name", "variant");
+    appendSimple(props, "property", part.metadata.getValue("partnumber", prefix)).setAttribute("name", "part number");
+    */
+    for (auto pv = outprops.cbegin(); pv != outprops.cend(); ++ pv)
+        appendSimple(props, "property", pv.value()).setAttribute("name", pv.key());
+
+    {
+        QDomElement views = appendElement(module, "views"), view, layers;
+        view = appendElement(views, "iconView");
+        layers = appendElement(view, "layers");
+        layers.setAttribute("image", QString("icon/%1").arg(names.icon));
+        appendElement(layers, "layer").setAttribute("layerId", "icon");
+        view = appendElement(views, "breadboardView");
+        layers = appendElement(view, "layers");
+        layers.setAttribute("image", QString("breadboard/%1").arg(names.breadboard));
+        appendElement(layers, "layer").setAttribute("layerId", "breadboard");
+        view = appendElement(views, "schematicView");
+        layers = appendElement(view, "layers");
+        layers.setAttribute("image", QString("schematic/%1").arg(names.schematic));
+        appendElement(layers, "layer").setAttribute("layerId", "schematic");
+        view = appendElement(views, "pcbView");
+        layers = appendElement(view, "layers");
+        layers.setAttribute("image", QString("pcb/%1").arg(names.pcb));
+        appendElement(layers, "layer").setAttribute("layerId", "silkscreen");
+        appendElement(layers, "layer").setAttribute("layerId", "copper0");
+        appendElement(layers, "layer").setAttribute("layerId", "copper1");
+    }
+
+    auto addp = [](QDomNode view, QString layer, int number, bool terminal) {
+        QDomElement p = appendElement(view, "p");
+        p.setAttribute("layer", layer);
+        p.setAttribute("svgId", QString("connector%1pin").arg(number - 1));
+        if (terminal)
+            p.setAttribute("terminalId", QString("connector%1terminal").arg(number - 1));
+    };
+
+    QDomElement conns = appendElement(module, "connectors");
+    for (const Pin &pin : part.pins) {
+        QString name = (pin.name == "" ? QString("pin %1").arg(pin.number) : pin.name);
+        QDomElement conn = appendElement(conns, "connector");
+        conn.setAttribute("name", name);
+        conn.setAttribute("id", QString("connector%1").arg(pin.number - 1));
+        conn.setAttribute("type", "male");
+        appendSimple(conn, "description", name);
+        QDomElement views = appendElement(conn, "views"), view;
+        view = appendElement(views, "breadboardView");
+        addp(view, "breadboard", pin.number, false);
+        view = appendElement(views, "schematicView");
+        addp(view, "schematic", pin.number, true);
+        view = appendElement(views, "pcbView");
+        addp(view, "copper0", pin.number, false);
+        addp(view, "copper1", pin.number, false);
+    }
+
+    //qDebug().noquote() << fzp.toString();
+    return fzp;
+
+}
+
+
+static void writeXML (QDomDocument doc, QString filename) {
+    QFile file(filename);
+    if (!file.open(QFile::WriteOnly | QFile::Text))
+        throw std::runtime_error(file.errorString().toStdString());
+    QTextStream text(&file);
+    text.setCodec("utf-8");
+    doc.save(text, 2, QDomNode::EncodingFromTextStream);
+    qDebug() << "saved" << filename;
+}
+
+
+static QString sanitize (QString filename) {
+    // super picky, and latin chars only
+    filename = filename
+            .trimmed()
+            .replace(QRegExp("[ ]+"), " ")
+            .replace(QRegExp("[^a-zA-Z0-9_-]"), "_");
+    return (filename == "") ? "compiled" : filename;
+}
+
+PartFilenames::PartFilenames (QString prefix, QString builddir) {
+    if (prefix != "") {
+        prefix = sanitize(prefix);
+        fzpz = QString("%1.fzpz").arg(prefix);
+        if (builddir != "") {
+            if (QFileInfo(builddir).isDir())
+                fzpz = QDir(builddir).absoluteFilePath(fzpz);
+            else
+                fzpz = QFileInfo(builddir).absoluteDir().absoluteFilePath(fzpz);
+        }
+        fzp = QString("%1.fzp").arg(prefix);
+        icon = QString("%1_icon.svg").arg(prefix);
+        breadboard = QString("%1_breadboard.svg").arg(prefix);
+        schematic = QString("%1_schematic.svg").arg(prefix);
+        pcb = QString("%1_pcb.svg").arg(prefix);
+    }
+}
+
+
+PartDocuments generatePartDocuments (const Part &part, const PartFilenames &names) {
+
+    PartDocuments docs;
+    {
+        MemStageScope scope(StagePCB);
+        docs.pcb = generatePCB(part);
+    }
+    {
+        MemStageScope scope(StageBreadboard);
+        docs.breadboard = generateBreadboard(part);
+    }
+    {
+        MemStageScope scope(StageSchematic);
+        docs.schematic = generateSchematic(part);
+    }
+    {
+        MemStageScope scope(StageIcon);
+        docs.icon = generateIcon(part);
+    }
+    {
+        MemStageScope scope(StageFZP);
+        docs.fzp = generateFZP(part, names);
+    }
+
+#if 0 // debugging
+    writeXML(docs.pcb, names.pcb);
+    writeXML(docs.breadboard, names.breadboard);
+    writeXML(docs.schematic, names.schematic);
+    writeXML(docs.icon, names.icon);
+    writeXML(docs.fzp, names.fzp);
+#endif
+
+    return docs;
+
+}
+
+
+QList<ArchiveMember> partArchiveMembers (const PartDocuments &docs, const PartFilenames &names) {
+    MemStageScope scope(StageSerialize);
+    return {
+        { QString("svg.pcb.%1").arg(names.pcb), docs.pcb.toByteArray(2) },
+        { QString("svg.breadboard.%1").arg(names.breadboard), docs.breadboard.toByteArray(2) },
+        { QString("svg.schematic.%1").arg(names.schematic), docs.schematic.toByteArray(2) },
+        { QString("svg.icon.%1").arg(names.icon), docs.icon.toByteArray(2) },
+        { QString("part.%1").arg(names.fzp), docs.fzp.toByteArray(2) }
+    };
+}
+
+ArchiveOptions ArchiveOptions::fromSettings () {
+    QSettings settings;
+    ArchiveOptions options;
+    options.level = qBound((int)ZipStore, settings.value("ziplevel", (int)ZipDefaultLevel).toInt(), (int)ZipBest);
+    options.backups = qMax(1, settings.value("backupcount", 1).toInt());
+    options.sync = settings.value("syncoutput", false).toBool();
+    if (settings.value("useminizip", false).toBool()) {
+        options.minizip = settings.value("minizip").toString();
+        // first use: look for it, so on first install the user doesn't have to find it
+        // themselves. otherwise just hope it's on the path.
+        if (options.minizip.isEmpty()) {
+            options.minizip = findMinizip();
+            if (options.minizip.isEmpty())
+                options.minizip = "minizip";
+            else
+                settings.setValue("minizip", options.minizip);
+        }
+    }
+    return options;
+}
+
+QString findMinizip () {
+    const QStringList places = {
+        QDir(QCoreApplication::applicationDirPath()).absoluteFilePath("contrib"),
+        QDir::current().absoluteFilePath("contrib"),
+        QCoreApplication::applicationDirPath(),
+        QDir::currentPath()
+    };
+    qDebug() << "looking for minizip...";
+    for (const QString &place : places) {
+        QString path = QDir(place).absoluteFilePath("minizip.exe");
+        if (QFile::exists(path)) {
+            qDebug() << "found" << path;
+            return path;
+        }
+    }
+    return QString();
+}
+
+QList<ZipEntry> compressArchiveMembers (const QList<ArchiveMember> &members, int level) {
+    std::function<ZipEntry(const ArchiveMember &)> compress = [level](const ArchiveMember &member) {
+        return compressZipEntry(member.name, member.data, level);
+    };
+    return QtConcurrent::blockingMapped<QList<ZipEntry> >(members, compress);
+}
+
+void writeZipArchive (QIODevice *out, const QList<ZipEntry> &entries) {
+    MemStageScope scope(StageArchive);
+    ZipWriter zip(out);
+    for (const ZipEntry &entry : entries)
+        zip.add(entry);
+    zip.close();
+}
+
+// the old way, kept for people who'd rather have minizip make their archives.
+static void writeMinizipArchive (const QList<ArchiveMember> &members, const QString &fzpz, const ArchiveOptions &options) {
+
+    QTemporaryDir workdir;
+    if (!workdir.isValid())
+        throw std::runtime_error("failed to create temporary work directory");
+
+    QStringList filenames;
+    for (const ArchiveMember &member : members) {
+        QFile file(workdir.filePath(member.name));
+        if (!file.open(QFile::WriteOnly) || file.write(member.data) != member.data.size())
+            throw std::runtime_error(file.errorString().toStdString());
+        filenames.append(file.fileName());
+    }
+
+    QStringList args = { "-o", QString("-%1").arg(options.level), fzpz };
+    args.append(filenames);
+    qDebug() << "minizip:" << options.minizip;
+    qDebug() << "minizip:" << args;
+    // waited for in slices, so a cancelled build (or a hung minizip) can be killed.
+    QProcess minizip;
+    minizip.setProcessChannelMode(QProcess::ForwardedChannels);
+    minizip.start(options.minizip, args);
+    int result = -1;
+    if (minizip.waitForStarted()) {
+        while (!minizip.waitForFinished(100) && minizip.state() != QProcess::NotRunning) {
+            if (options.cancelled()) {
+                minizip.kill();
+                minizip.waitForFinished();
+                throw std::runtime_error("cancelled");
+            }
+        }
+        if (minizip.exitStatus() == QProcess::NormalExit)
+            result = minizip.exitCode();
+    }
+    qDebug() << "minizip: returned " << result;
+    if (result) {
+        throw std::runtime_error("failed to execute minizip. you may have to select it "
+                                 "from the 'build -> settings -> locate minizip' menu.");
+    }
+
+}
+
+void writePartArchive (const PartDocuments &docs, const PartFilenames &names, const ArchiveOptions &options, bool backup) {
+
+    if (options.cancelled())
+        throw std::runtime_error("cancelled");
+
+    QList<ArchiveMember> members = partArchiveMembers(docs, names);
+
+    // built next to the target and renamed over it, so a failed or interrupted build
+    // never leaves a truncated fzpz behind.
+    AtomicFile output(names.fzpz, backup ? options.backups : 0, options.sync);
+    if (options.minizip != "") {
+        output.file()->close();
+        writeMinizipArchive(members, output.tempFileName(), options);
+    } else {
+        QList<ZipEntry> entries = compressArchiveMembers(members, options.level);
+        if (options.cancelled())
+            throw std::runtime_error("cancelled");
+        writeZipArchive(output.file(), entries);
+    }
+    output.commit();
+
+}
+
+QStringList writePartArchives (const QList<Part> &parts, const QString &builddir, const ArchiveOptions &options, bool backup) {
+
+    QList<PartFilenames> names;
+    QStringList fzpzs;
+    for (const Part &part : parts) {
+        names.append(PartFilenames(part.filename, builddir));
+        if (fzpzs.contains(names.last().fzpz))
+            throw std::runtime_error(QString("more than one part would be saved as %1; use a param in the filename").arg(names.last().fzpz).toStdString());
+        fzpzs.append(names.last().fzpz);
+    }
+
+    QList<int> indices;
+    for (int n = 0; n < parts.size(); ++ n)
+        indices.append(n);
+    std::function<QString(int)> build = [&](int n) {
+        try {
+            writePartArchive(generatePartDocuments(parts[n], names[n]), names[n], options, backup);
+            return QString();
+        } catch (const std::exception &x) {
+            return QString("%1: %2").arg(QFileInfo(names[n].fzpz).fileName(), x.what());
+        }
+    };
+    QStringList errors = QtConcurrent::blockingMapped<QStringList>(indices, build);
+    errors.removeAll(QString());
+    if (!errors.empty())
+        throw std::runtime_error(errors.join("\n").toStdString());
+
+    return fzpzs;
+
+}
+
+PartArchiveQueue::PartArchiveQueue (const QString &builddir, const ArchiveOptions &options, bool backup, int limit) :
+    builddir(builddir), options(options), backup(backup), limit(limit > 0 ? limit : 2 * QThread::idealThreadCount())
+{
+}
+
+PartArchiveQueue::~PartArchiveQueue () {
+    for (QFuture<QString> &future : running)
+        future.waitForFinished();
+}
+
+void PartArchiveQueue::add (const Part &part) {
+
+    const PartFilenames names(part.filename, builddir);
+    if (used.contains(names.fzpz))
+        throw std::runtime_error(QString("more than one part would be saved as %1").arg(names.fzpz).toStdString());
+    used.insert(names.fzpz);
+    fzpzs.append(names.fzpz);
+
+    while (running.size() >= limit)
+        collect();
+
+    const ArchiveOptions options = this->options;
+    const bool backup = this->backup;
+    running.append(QtConcurrent::run([part, names, options, backup] () {
+        try {
+            writePartArchive(generatePartDocuments(part, names), names, options, backup);
+            return QString();
+        } catch (const std::exception &x) {
+            return QString("%1: %2").arg(QFileInfo(names.fzpz).fileName(), x.what());
+        }
+    }));
+
+}
+
+// waits for the oldest part.
+void PartArchiveQueue::collect () {
+    const QString error = running.takeFirst().result();
+    if (error != "")
+        errors.append(error);
+}
+
+QStringList PartArchiveQueue::finish () {
+    while (!running.empty())
+        collect();
+    if (!errors.empty())
+        throw std::runtime_error(errors.join("\n").toStdString());
+    return fzpzs;
+}
@@ -0,0 +1,111 @@
+/*----------------------------------------------------------------------
+Fritzpart - Generates Fritzing parts from a part description script.
+Copyright (C) 2021, Jason Cipriani <jason.cipriani.dev@gmail.com>
+Not affiliated with Fritzing.
+
+This file is part of Fritzpart.
+
+Fritzpart is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+https://github.com/JC3/fritzpart
+----------------------------------------------------------------------*/
+
+#ifndef PARTGEN_H
+#define PARTGEN_H
+
+#include <QDomDocument>
+#include <QString>
+#include <QAtomicInt>
+#include <QFuture>
+#include <QSet>
+#include "part.h"
+#include "zipwriter.h"
+
+QDomDocument generatePCB (const Part &part);
+QDomDocument generateBreadboard (const Part &part, QString layername = "breadboard" /* for now, while we're using it for icon too */);
+QDomDocument generateIcon (const Part &part);
+QDomDocument generateSchematic (const Part &part);
+QDomDocument generateFZP (const Part &part, const PartFilenames &names);
+
+struct PartDocuments {
+    QDomDocument pcb;
+    QDomDocument breadboard;
+    QDomDocument schematic;
+    QDomDocument icon;
+    QDomDocument fzp;
+};
+
+PartDocuments generatePartDocuments (const Part &part, const PartFilenames &names);
+
+struct ArchiveMember {
+    QString name;    // e.g. svg.pcb.foo_pcb.svg
+    QByteArray data;
+};
+
+// the files that go into a part's fzpz (or a bundle), named the way fritzing expects.
+QList<ArchiveMember> partArchiveMembers (const PartDocuments &docs, const PartFilenames &names);
+
+struct ArchiveOptions {
+    int level;          // ZipStore .. ZipBest
+    QString minizip;    // if set, this external minizip makes the archive instead
+    int backups;        // how many old versions to keep when backups are on
+    bool sync;          // flush archives to disk before renaming them into place
+    const QAtomicInt *cancel; // if set, archiving gives up (throws) once it becomes nonzero
+    ArchiveOptions () : level(ZipDefaultLevel), backups(1), sync(false), cancel(nullptr) { }
+    bool cancelled () const { return cancel && cancel->loadRelaxed(); }
+    static ArchiveOptions fromSettings (); // "ziplevel", "useminizip", "minizip", "backupcount", "syncoutput"
+};
+
+// looks for minizip.exe next to the application and in the current directory (and
+// contrib/ under either). returns an empty string if it isn't in any of them.
+QString findMinizip ();
+
+// compresses members in parallel, keeping their order.
+QList<ZipEntry> compressArchiveMembers (const QList<ArchiveMember> &members, int level);
+
+void writeZipArchive (QIODevice *out, const QList<ZipEntry> &entries);
+
+// zips everything up into names.fzpz, atomically (see AtomicFile). if backup is set,
+// the existing fzpz becomes *.fritzpart.bak (rotating up to options.backups deep).
+void writePartArchive (const PartDocuments &docs, const PartFilenames &names, const ArchiveOptions &options, bool backup);
+
+// generates and archives a batch of parts (e.g. param sweep variants) in parallel into
+// builddir, returning the fzpz filenames. throws up front if two parts would have the
+// same filename, and after the whole batch if any of them failed.
+QStringList writePartArchives (const QList<Part> &parts, const QString &builddir, const ArchiveOptions &options, bool backup);
+
+// the same, but for parts that arrive one at a time (e.g. the blocks of a multi-part
+// script): each is generated and archived in the background as soon as it's added, so
+// that overlaps with compiling the next. at most limit parts (default: twice the thread
+// count) are in flight; add() waits past that. finish() waits for the rest, returns the
+// fzpz filenames, and throws with every failure.
+class PartArchiveQueue {
+public:
+    PartArchiveQueue (const QString &builddir, const ArchiveOptions &options, bool backup, int limit = 0);
+    ~PartArchiveQueue ();
+    void add (const Part &part);
+    QStringList finish ();
+private:
+    void collect ();
+    QString builddir;
+    ArchiveOptions options;
+    bool backup;
+    int limit;
+    QList<QFuture<QString> > running; // oldest first
+    QStringList fzpzs;
+    QSet<QString> used;
+    QStringList errors;
+};
+
+#endif // PARTGEN_H
@@ -0,0 +1,157 @@
+/*----------------------------------------------------------------------
+Fritzpart - Generates Fritzing parts from a part description script.
+Copyright (C) 2021, Jason Cipriani <jason.cipriani.dev@gmail.com>
+Not affiliated with Fritzing.
+
+This file is part of Fritzpart.
+
+Fritzpart is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+https://github.com/JC3/fritzpart
+----------------------------------------------------------------------*/
+
+#include "partscript.h"
+#include <QTextStream>
+#include <algorithm>
+
+QString scriptQuote (const QString &token) {
+    bool plain = (token != "" && !token.startsWith('"'));
+    for (int n = 0; plain && n < token.size(); ++ n)
+        plain = !token[n].isSpace();
+    if (plain)
+        return token;
+    QString quoted = "\"";
+    for (QChar ch : token) {
+        if (ch == '"' || ch == '\\')
+            quoted += '\\';
+        quoted += ch;
+    }
+    return quoted + "\"";
+}
+
+// values are ${...} expanded when the script is read back in, so literal ones are escaped.
+static QString literal (const QString &text) {
+    QString escaped = text;
+    return escaped.replace("${", "$${");
+}
+
+static QString num (double value) {
+    return QString::number(value, 'g', 10);
+}
+
+QString writePartScript (const Part &part, const QStringList &comments) {
+
+    const Part defaults;
+    QString script;
+    QTextStream out(&script);
+
+    auto put = [&](const QString &directive, const QStringList &args = QStringList()) {
+        out << directive;
+        for (const QString &arg : args)
+            out << " " << scriptQuote(literal(arg));
+        out << "\n";
+    };
+
+    for (const QString &comment : comments)
+        out << "# " << comment << "\n";
+    if (!comments.empty())
+        out << "\n";
+
+    // ---- metadata
+
+    if (part.filename != "")
+        put("filename", { part.filename });
+    for (int key = 0; key < MetaDescription; ++ key)
+        if (part.metadata[(MetaKey)key] != "")
+            put(Metadata::name((MetaKey)key), { part.metadata[(MetaKey)key] });
+
+    QString description = part.metadata[MetaDescription].trimmed();
+    if (description.contains('\n')) {
+        out << "description:\n" << literal(description) << "\n:description\n";
+    } else if (description != "") {
+        put("description", { description });
+    }
+
+    for (auto prop = part.metaprops.cbegin(); prop != part.metaprops.cend(); ++ prop)
+        put("property", { prop.key(), prop.value() });
+
+    QStringList tags;
+    for (const QString &tag : part.metatags)
+        if (!defaults.metatags.contains(tag))
+            tags.append(tag);
+    if (!tags.empty())
+        put("tags", tags);
+
+    // ---- appearance
+
+    out << "\n";
+    put("units", { part.units });
+    put("width", { num(part.width) });
+    put("height", { num(part.height) });
+    put("origin", { "top", "left" });
+    if (part.outline != defaults.outline)
+        put("outline", { num(part.outline) });
+    if (part.color != defaults.color)
+        put("color", { part.color });
+    if (part.corner != defaults.corner)
+        put("corner", { num(part.corner) });
+    if (part.schematic != defaults.schematic || part.schematicmod != defaults.schematicmod)
+        put("schematic", part.schematicmod == "" ? QStringList({ part.schematic }) : QStringList({ part.schematic, part.schematicmod }));
+    if (part.bbtext != defaults.bbtext || part.bbtextcolor != defaults.bbtextcolor || part.bbtextsize != defaults.bbtextsize)
+        put("bbtext", { part.bbtext, part.bbtextcolor, num(part.bbtextsize) });
+    if (part.sctext != defaults.sctext)
+        put("sctext", { part.sctext });
+
+    // ---- pins and pcb
+
+    if (!part.pins.empty()) {
+        QList<Pin> pins = part.pins;
+        std::stable_sort(pins.begin(), pins.end(), pinNumberLess);
+        double curhole = Pin().hole, curring = Pin().ring;
+        out << "\n";
+        for (const Pin &pin : pins) {
+            if (pin.hole != curhole)
+                put("pthhole", { num(curhole = pin.hole) });
+            if (pin.ring != curring)
+                put("pthring", { num(curring = pin.ring) });
+            QStringList args = { num(pin.x), num(pin.y), pin.name };
+            if (pin.square)
+                args.append("square");
+            put("pin", args);
+        }
+    }
+
+    if (!part.pcbholes.empty()) {
+        out << "\n";
+        for (const Hole &hole : part.pcbholes)
+            put("pcbhole", { num(hole.x), num(hole.y), num(hole.diameter) });
+    }
+
+    if (!part.pcbmarks.empty()) {
+        out << "\n";
+        put("pcbstroke", { num(part.pcbmarkstroke) });
+        for (const Marking &mark : part.pcbmarks) {
+            if (mark.shape == Marking::Line && mark.capped)
+                put("pcbline", { num(mark.x1), num(mark.y1), num(mark.x2), num(mark.y2) });
+            else if (mark.shape == Marking::Line)
+                put("pcbline", { num(mark.x1), num(mark.y1), num(mark.x2), num(mark.y2), "flat" });
+            else if (mark.shape == Marking::Circle)
+                put("pcbdot", { num(mark.x1), num(mark.y1), num(mark.diam) });
+        }
+    }
+
+    out.flush();
+    return script;
+
+}
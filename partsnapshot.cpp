@@ -0,0 +1,439 @@
+/*----------------------------------------------------------------------
+Fritzpart - Generates Fritzing parts from a part description script.
+Copyright (C) 2021, Jason Cipriani <jason.cipriani.dev@gmail.com>
+Not affiliated with Fritzing.
+
+This file is part of Fritzpart.
+
+Fritzpart is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+https://github.com/JC3/fritzpart
+----------------------------------------------------------------------*/
+
+
+#include "partsnapshot.h"
+#include "atomicfile.h"
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFileInfo>
+#include <QStandardPaths>
+#include <QVector>
+#include <QDebug>
+#include <cstring>
+#include <stdexcept>
+
+static_assert(sizeof(SnapshotHeader) == 64, "snapshot header layout changed");
+static_assert(sizeof(SnapshotTable) == 16, "snapshot table layout changed");
+static_assert(sizeof(SnapshotString) == 8, "snapshot string layout changed");
+static_assert(sizeof(SnapshotParam) == 16, "snapshot param layout changed");
+static_assert(sizeof(SnapshotPin) == 48, "snapshot pin layout changed");
+static_assert(sizeof(SnapshotHole) == 24, "snapshot hole layout changed");
+static_assert(sizeof(SnapshotMarking) == 48, "snapshot marking layout changed");
+static_assert(sizeof(SnapshotPair) == 8, "snapshot pair layout changed");
+static_assert(sizeof(SnapshotPart) == 200, "snapshot part layout changed; bump SnapshotVersion");
+
+static const quint16 SnapshotByteOrder = 0x0102;
+
+namespace {
+
+// appends 8 byte aligned arrays to the file image, and collects strings (each distinct
+// one is stored once).
+class SnapshotBuilder {
+public:
+    QByteArray data;
+    QStringList strings;
+    template <typename T> quint32 add (const QVector<T> &records) {
+        return add(records.constData(), records.size() * sizeof(T));
+    }
+    quint32 add (const void *bytes, int count) {
+        while (data.size() % 8)
+            data.append('\0');
+        const quint32 offset = data.size();
+        data.append(reinterpret_cast<const char *>(bytes), count);
+        return offset;
+    }
+    quint32 string (const QString &text) {
+        auto id = ids.constFind(text);
+        if (id != ids.cend())
+            return id.value();
+        ids.insert(text, strings.size());
+        strings.append(text);
+        return strings.size() - 1;
+    }
+private:
+    QHash<QString,quint32> ids;
+};
+
+}
+
+QByteArray PartSnapshot::serialize (const QList<PartVariant> &variants, const QByteArray &source,
+                                    const QHash<QString,QDateTime> &tables) {
+
+    SnapshotBuilder b;
+    SnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    b.add(&header, sizeof(header));
+
+    QVector<SnapshotTable> tablerecs;
+    for (auto table = tables.cbegin(); table != tables.cend(); ++ table)
+        tablerecs.append({ table.value().toMSecsSinceEpoch(), b.string(table.key()), 0 });
+    header.ntables = tablerecs.size();
+    header.tables = b.add(tablerecs);
+
+    QVector<SnapshotPart> parts;
+    for (const PartVariant &variant : variants) {
+
+        const Part &part = variant.part;
+        SnapshotPart p;
+        memset(&p, 0, sizeof(p));
+        p.width = part.width;
+        p.height = part.height;
+        p.outline = part.outline;
+        p.corner = part.corner;
+        p.bbtextsize = part.bbtextsize;
+        p.bbpinlabelsize = part.bbpinlabelsize;
+        p.pcbmarkstroke = part.pcbmarkstroke;
+        for (int n = 0; n < 2; ++ n) {
+            p.mingrid[n] = part.mingrid[n];
+            p.extragrid[n] = part.extragrid[n];
+        }
+        p.units = b.string(part.units);
+        p.color = b.string(part.color);
+        p.schematic = b.string(part.schematic);
+        p.schematicmod = b.string(part.schematicmod);
+        p.bbtext = b.string(part.bbtext);
+        p.bbtextcolor = b.string(part.bbtextcolor);
+        p.bbpinlabelcolor = b.string(part.bbpinlabelcolor);
+        p.sctext = b.string(part.sctext);
+        p.filename = b.string(part.filename);
+        for (int k = 0; k < MetaKeyCount; ++ k)
+            p.metadata[k] = b.string(part.metadata[(MetaKey)k]);
+        p.bbpinlabels = part.bbpinlabels;
+        p.scpinlabels = part.scpinlabels;
+        p.scpinnumbers = part.scpinnumbers;
+
+        QVector<SnapshotPin> pins;
+        for (const Pin &pin : part.pins) {
+            SnapshotPin r;
+            memset(&r, 0, sizeof(r));
+            r.x = pin.x;
+            r.y = pin.y;
+            r.hole = pin.hole;
+            r.ring = pin.ring;
+            r.number = pin.number;
+            r.name = b.string(pin.name);
+            r.square = pin.square;
+            pins.append(r);
+        }
+        p.npins = pins.size();
+        p.pins = b.add(pins);
+
+        QVector<SnapshotHole> holes;
+        for (const Hole &hole : part.pcbholes)
+            holes.append({ hole.x, hole.y, hole.diameter });
+        p.nholes = holes.size();
+        p.holes = b.add(holes);
+
+        QVector<SnapshotMarking> marks;
+        for (const Marking &mark : part.pcbmarks) {
+            SnapshotMarking r;
+            memset(&r, 0, sizeof(r));
+            r.x1 = mark.x1;
+            r.y1 = mark.y1;
+            r.x2 = mark.x2;
+            r.y2 = mark.y2;
+            r.diam = mark.diam;
+            r.shape = mark.shape;
+            r.capped = mark.capped;
+            marks.append(r);
+        }
+        p.nmarks = marks.size();
+        p.marks = b.add(marks);
+
+        QVector<SnapshotPair> props;
+        for (auto prop = part.metaprops.cbegin(); prop != part.metaprops.cend(); ++ prop)
+            props.append({ b.string(prop.key()), b.string(prop.value()) });
+        p.nprops = props.size();
+        p.props = b.add(props);
+
+        QVector<quint32> tags;
+        for (const QString &tag : part.metatags)
+            tags.append(b.string(tag));
+        p.ntags = tags.size();
+        p.tags = b.add(tags);
+
+        QVector<SnapshotParam> params;
+        for (auto param = variant.params.cbegin(); param != variant.params.cend(); ++ param)
+            params.append({ param.value(), b.string(param.key()), 0 });
+        p.nparams = params.size();
+        p.params = b.add(params);
+
+        parts.append(p);
+
+    }
+    header.nparts = parts.size();
+    header.parts = b.add(parts);
+
+    QVector<SnapshotString> index;
+    QString chars;
+    for (const QString &text : b.strings) {
+        index.append({ (quint32)chars.size(), (quint32)text.size() });
+        chars += text;
+    }
+    header.nstrings = index.size();
+    header.strings = b.add(index);
+    header.chars = b.add(chars.constData(), chars.size() * sizeof(QChar));
+
+    memcpy(header.magic, "FZPS", 4);
+    header.version = SnapshotVersion;
+    header.byteorder = SnapshotByteOrder;
+    header.size = b.data.size();
+    memcpy(header.source, source.constData(), qMin(source.size(), (int)sizeof(header.source)));
+    memcpy(b.data.data(), &header, sizeof(header));
+
+    return b.data;
+
+}
+
+// checks every offset and count up front, so the accessors can trust them.
+bool PartSnapshot::validate () const {
+
+    auto fits = [this](quint32 offset, quint32 count, size_t recsize) {
+        return offset % 8 == 0 && offset <= size && count <= (size - offset) / recsize;
+    };
+
+    if (size < (qint64)sizeof(SnapshotHeader))
+        return false;
+    const SnapshotHeader &h = header();
+    if (memcmp(h.magic, "FZPS", 4) || h.version != SnapshotVersion || h.byteorder != SnapshotByteOrder || h.size != size)
+        return false;
+    if (!fits(h.parts, h.nparts, sizeof(SnapshotPart)) || !fits(h.tables, h.ntables, sizeof(SnapshotTable)) ||
+            !fits(h.strings, h.nstrings, sizeof(SnapshotString)) || !fits(h.chars, 0, sizeof(QChar)))
+        return false;
+
+    const quint64 nchars = (size - h.chars) / sizeof(QChar);
+    const SnapshotString *strings = array<SnapshotString>(h.strings);
+    for (quint32 n = 0; n < h.nstrings; ++ n)
+        if ((quint64)strings[n].offset + strings[n].length > nchars)
+            return false;
+
+    for (int n = 0; n < partCount(); ++ n) {
+        const SnapshotPart &p = partRecord(n);
+        if (!fits(p.pins, p.npins, sizeof(SnapshotPin)) || !fits(p.holes, p.nholes, sizeof(SnapshotHole)) ||
+                !fits(p.marks, p.nmarks, sizeof(SnapshotMarking)) || !fits(p.props, p.nprops, sizeof(SnapshotPair)) ||
+                !fits(p.tags, p.ntags, sizeof(quint32)) || !fits(p.params, p.nparams, sizeof(SnapshotParam)))
+            return false;
+    }
+
+    return true;
+
+}
+
+bool PartSnapshot::open (const QString &filename) {
+    close();
+    file.setFileName(filename);
+    if (!file.open(QFile::ReadOnly))
+        return false;
+    size = file.size();
+    data = file.map(0, size);
+    if (data && validate())
+        return true;
+    close();
+    return false;
+}
+
+void PartSnapshot::close () {
+    if (data)
+        file.unmap(const_cast<uchar *>(data));
+    file.close();
+    data = nullptr;
+    size = 0;
+}
+
+QByteArray PartSnapshot::source () const {
+    return QByteArray(reinterpret_cast<const char *>(header().source), sizeof(header().source));
+}
+
+bool PartSnapshot::tablesUnchanged () const {
+    const SnapshotTable *tables = array<SnapshotTable>(header().tables);
+    for (quint32 n = 0; n < header().ntables; ++ n)
+        if (QFileInfo(string(tables[n].path)).lastModified().toMSecsSinceEpoch() != tables[n].mtime)
+            return false;
+    return true;
+}
+
+QString PartSnapshot::string (quint32 id) const {
+    if (id >= header().nstrings)
+        return QString();
+    const SnapshotString &s = array<SnapshotString>(header().strings)[id];
+    return QString(array<QChar>(header().chars) + s.offset, s.length);
+}
+
+PartVariant PartSnapshot::variant (int n) const {
+
+    const SnapshotPart &p = partRecord(n);
+    PartVariant variant;
+    Part &part = variant.part;
+
+    part.width = p.width;
+    part.height = p.height;
+    part.outline = p.outline;
+    part.corner = p.corner;
+    part.bbtextsize = p.bbtextsize;
+    part.bbpinlabelsize = p.bbpinlabelsize;
+    part.pcbmarkstroke = p.pcbmarkstroke;
+    for (int k = 0; k < 2; ++ k) {
+        part.mingrid[k] = p.mingrid[k];
+        part.extragrid[k] = p.extragrid[k];
+    }
+    part.units = string(p.units);
+    part.color = string(p.color);
+    part.schematic = string(p.schematic);
+    part.schematicmod = string(p.schematicmod);
+    part.bbtext = string(p.bbtext);
+    part.bbtextcolor = string(p.bbtextcolor);
+    part.bbpinlabelcolor = string(p.bbpinlabelcolor);
+    part.sctext = string(p.sctext);
+    part.filename = string(p.filename);
+    for (int k = 0; k < MetaKeyCount; ++ k)
+        part.metadata[(MetaKey)k] = string(p.metadata[k]);
+    part.bbpinlabels = p.bbpinlabels;
+    part.scpinlabels = p.scpinlabels;
+    part.scpinnumbers = p.scpinnumbers;
+
+    // positions are already final, so the origin flags no longer mean anything.
+    part.pins.reserve(p.npins);
+    for (const SnapshotPin *r = array<SnapshotPin>(p.pins), *end = r + p.npins; r != end; ++ r) {
+        Pin pin;
+        pin.x = r->x;
+        pin.y = r->y;
+        pin.hole = r->hole;
+        pin.ring = r->ring;
+        pin.number = r->number;
+        pin.name = string(r->name);
+        pin.square = r->square;
+        pin.origleft = pin.origtop = true;
+        part.pins.append(pin);
+    }
+
+    part.pcbholes.reserve(p.nholes);
+    for (const SnapshotHole *r = array<SnapshotHole>(p.holes), *end = r + p.nholes; r != end; ++ r) {
+        Hole hole;
+        hole.x = r->x;
+        hole.y = r->y;
+        hole.diameter = r->diameter;
+        hole.origleft = hole.origtop = true;
+        part.pcbholes.append(hole);
+    }
+
+    part.pcbmarks.reserve(p.nmarks);
+    for (const SnapshotMarking *r = array<SnapshotMarking>(p.marks), *end = r + p.nmarks; r != end; ++ r) {
+        Marking mark((Marking::Shape)r->shape);
+        mark.x1 = r->x1;
+        mark.y1 = r->y1;
+        mark.x2 = r->x2;
+        mark.y2 = r->y2;
+        mark.diam = r->diam;
+        mark.capped = r->capped;
+        mark.origleft = mark.origtop = true;
+        part.pcbmarks.append(mark);
+    }
+
+    for (const SnapshotPair *r = array<SnapshotPair>(p.props), *end = r + p.nprops; r != end; ++ r)
+        part.metaprops[string(r->key)] = string(r->value);
+
+    part.metatags.clear();
+    for (const quint32 *r = array<quint32>(p.tags), *end = r + p.ntags; r != end; ++ r)
+        part.metatags.append(string(*r));
+
+    for (const SnapshotParam *r = array<SnapshotParam>(p.params), *end = r + p.nparams; r != end; ++ r)
+        variant.params[string(r->name)] = r->value;
+
+    return variant;
+
+}
+
+QList<PartVariant> PartSnapshot::variants () const {
+    QList<PartVariant> variants;
+    for (int n = 0; n < partCount(); ++ n)
+        variants.append(variant(n));
+    return variants;
+}
+
+QString snapshotCacheDir () {
+    return QDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation)).absoluteFilePath("snapshots");
+}
+
+void compileScriptCached (const QString &script, const QString &cachedir, const PartSink &sink, bool *cached) {
+
+    if (cached)
+        *cached = false;
+
+    QFile file(script);
+    if (!file.open(QFile::ReadOnly | QFile::Text))
+        throw std::runtime_error(file.errorString().toStdString());
+
+    PartCompiler compiler;
+    compiler.setScriptPath(script);
+    if (cachedir == "") {
+        compiler.compileVariants(&file, sink);
+        return;
+    }
+
+    // the script's directory counts too, since relative pin tables would be other files.
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(APPLICATION_VERSION "\n");
+    hash.addData(QByteArray::number(SnapshotVersion) + "\n");
+    hash.addData(QFileInfo(script).absolutePath().toUtf8() + "\n");
+    hash.addData(&file);
+    const QByteArray source = hash.result();
+    const QString filename = QDir(cachedir).absoluteFilePath(QString::fromLatin1(source.toHex()) + ".fzps");
+
+    PartSnapshot snapshot;
+    if (snapshot.open(filename) && snapshot.source() == source && snapshot.tablesUnchanged()) {
+        if (cached)
+            *cached = true;
+        for (int n = 0; n < snapshot.partCount(); ++ n)
+            sink(snapshot.variant(n));
+        return;
+    }
+    snapshot.close();
+
+    // the snapshot needs all of them, but they still go to sink as they're compiled.
+    if (!file.seek(0))
+        throw std::runtime_error(file.errorString().toStdString());
+    QList<PartVariant> variants;
+    compiler.compileVariants(&file, [&](const PartVariant &variant) {
+        variants.append(variant);
+        sink(variant);
+    });
+
+    // a cache that can't be written just means compiling again next time.
+    try {
+        QDir().mkpath(cachedir);
+        const QByteArray bytes = PartSnapshot::serialize(variants, source, compiler.pinTables());
+        AtomicFile out(filename);
+        if (out.file()->write(bytes) == bytes.size())
+            out.commit();
+    } catch (const std::exception &x) {
+        qDebug() << "snapshot cache:" << x.what();
+    }
+
+}
+
+QList<PartVariant> compileScriptCached (const QString &script, const QString &cachedir, bool *cached) {
+    QList<PartVariant> variants;
+    compileScriptCached(script, cachedir, [&variants](const PartVariant &variant) { variants.append(variant); }, cached);
+    return variants;
+}
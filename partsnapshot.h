@@ -0,0 +1,157 @@
+/*----------------------------------------------------------------------
+Fritzpart - Generates Fritzing parts from a part description script.
+Copyright (C) 2021, Jason Cipriani <jason.cipriani.dev@gmail.com>
+Not affiliated with Fritzing.
+
+This file is part of Fritzpart.
+
+Fritzpart is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+https://github.com/JC3/fritzpart
+----------------------------------------------------------------------*/
+
+
+#ifndef PARTSNAPSHOT_H
+#define PARTSNAPSHOT_H
+
+#include <QString>
+#include <QByteArray>
+#include <QDateTime>
+#include <QHash>
+#include <QFile>
+#include "part.h"
+#include "partcompiler.h"
+#include <functional>
+
+// a compiled script saved in a compact binary form: the finished parts of every variant
+// (deferred positions and backoffs applied, defaults filled in) plus what's needed to
+// tell whether it's still current. it's all fixed size records and offsets in one block,
+// so a snapshot is used straight from a memory mapped file: records are read in place
+// and strings are only copied out when a Part is built.
+//
+// layout: SnapshotHeader, then the arrays it and each SnapshotPart point to, then the
+// string index and the utf-16 string data. offsets are in bytes from the start of the
+// file and every array starts on an 8 byte boundary. numbers are in the writer's byte
+// order; a snapshot from a machine of the other endianness is just rejected (and gets
+// rebuilt). any change to these records needs a new SnapshotVersion.
+
+enum { SnapshotVersion = 1 };
+
+struct SnapshotHeader {
+    char magic[4];              // "FZPS"
+    quint16 version;            // SnapshotVersion
+    quint16 byteorder;          // 0x0102
+    quint32 size;               // of the whole file
+    quint32 nparts, parts;      // SnapshotPart, one per variant
+    quint32 ntables, tables;    // SnapshotTable
+    quint32 nstrings, strings;  // SnapshotString
+    quint32 chars;              // string data
+    quint8 source[20];          // sha1 of what it was compiled from
+    quint32 reserved;
+};
+
+struct SnapshotTable {          // pin table read by the script
+    qint64 mtime;               // ms since epoch
+    quint32 path;
+    quint32 reserved;
+};
+
+struct SnapshotString {
+    quint32 offset, length;     // in chars, from SnapshotHeader::chars
+};
+
+struct SnapshotParam {
+    double value;
+    quint32 name;
+    quint32 reserved;
+};
+
+struct SnapshotPin {
+    double x, y, hole, ring;
+    qint32 number;
+    quint32 name;
+    quint8 square;
+    quint8 reserved[7];
+};
+
+struct SnapshotHole {
+    double x, y, diameter;
+};
+
+struct SnapshotMarking {
+    double x1, y1, x2, y2, diam;
+    quint8 shape, capped;
+    quint8 reserved[6];
+};
+
+struct SnapshotPair {
+    quint32 key, value;
+};
+
+// strings are ids into the string index; arrays are a count and an offset.
+struct SnapshotPart {
+    double width, height, outline, corner, bbtextsize, bbpinlabelsize, pcbmarkstroke;
+    qint32 mingrid[2], extragrid[2];
+    quint32 units, color, schematic, schematicmod, bbtext, bbtextcolor, bbpinlabelcolor, sctext, filename;
+    quint32 metadata[MetaKeyCount];
+    quint8 bbpinlabels, scpinlabels, scpinnumbers, reserved;
+    quint32 npins, pins;        // SnapshotPin
+    quint32 nholes, holes;      // SnapshotHole
+    quint32 nmarks, marks;      // SnapshotMarking
+    quint32 nprops, props;      // SnapshotPair, metaprops
+    quint32 ntags, tags;        // quint32 string ids
+    quint32 nparams, params;    // SnapshotParam, the variant's param values
+};
+
+class PartSnapshot {
+public:
+    PartSnapshot () : data(nullptr), size(0) { }
+    bool open (const QString &filename); // false if it's missing or isn't a usable snapshot
+    void close ();
+    bool isOpen () const { return data != nullptr; }
+    QByteArray source () const;
+    bool tablesUnchanged () const;
+    int partCount () const { return header().nparts; }
+    // in place access to the mapped records.
+    const SnapshotHeader & header () const { return *array<SnapshotHeader>(0); }
+    const SnapshotPart & partRecord (int n) const { return array<SnapshotPart>(header().parts)[n]; }
+    template <typename T> const T * array (quint32 offset) const { return reinterpret_cast<const T *>(data + offset); }
+    QString string (quint32 id) const;
+    // copied out into the usual types.
+    PartVariant variant (int n) const;
+    QList<PartVariant> variants () const;
+    static QByteArray serialize (const QList<PartVariant> &variants, const QByteArray &source,
+                                 const QHash<QString,QDateTime> &tables);
+private:
+    bool validate () const;
+    QFile file;
+    const uchar *data;
+    qint64 size;
+    Q_DISABLE_COPY(PartSnapshot)
+};
+
+QString snapshotCacheDir ();
+
+// compiles a script (every variant of param sweeps), or if cachedir has a current
+// snapshot of it, loads that instead. otherwise a new snapshot is written there. with
+// no cachedir it's always just compiled.
+// compile errors throw std::runtime_error; a cache that can't be written is ignored.
+QList<PartVariant> compileScriptCached (const QString &script, const QString &cachedir, bool *cached = nullptr);
+
+// the same, but each part goes to sink as soon as it's ready (with multi-part scripts,
+// as each block is parsed) instead of all of them coming back at the end.
+typedef std::function<void(const PartVariant &)> PartSink;
+void compileScriptCached (const QString &script, const QString &cachedir, const PartSink &sink, bool *cached = nullptr);
+
+#endif // PARTSNAPSHOT_H
@@ -0,0 +1,196 @@
+/*----------------------------------------------------------------------
+Fritzpart - Generates Fritzing parts from a part description script.
+Copyright (C) 2021, Jason Cipriani <jason.cipriani.dev@gmail.com>
+Not affiliated with Fritzing.
+
+This file is part of Fritzpart.
+
+Fritzpart is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+https://github.com/JC3/fritzpart
+----------------------------------------------------------------------*/
+
+#include "partverifier.h"
+#include <QtGui/private/qzipreader_p.h>
+#include <QXmlStreamReader>
+#include <QHash>
+#include <QSet>
+#include <QtConcurrent>
+
+// every id attribute in an svg. we don't care about anything else in there.
+static QSet<QString> svgIds (const QByteArray &svg, QString *error) {
+    QSet<QString> ids;
+    QXmlStreamReader xml(svg);
+    while (!xml.atEnd()) {
+        if (xml.readNext() == QXmlStreamReader::StartElement) {
+            QStringRef id = xml.attributes().value("id");
+            if (!id.isEmpty())
+                ids.insert(id.toString());
+        }
+    }
+    if (xml.hasError())
+        *error = xml.errorString();
+    return ids;
+}
+
+// fzp image paths look like "pcb/foo_pcb.svg" but are stored in the fzpz as "svg.pcb.foo_pcb.svg".
+static QString archiveName (QString image) {
+    return "svg." + image.replace('/', '.');
+}
+
+VerifyResult verifyPartArchive (const QString &fzpz) {
+
+    VerifyResult result;
+    result.filename = fzpz;
+    QStringList &errors = result.errors;
+
+    QZipReader zip(fzpz);
+    if (!zip.isReadable() || zip.status() != QZipReader::NoError) {
+        errors.append("could not open archive");
+        return result;
+    }
+
+    QSet<QString> members;
+    QString fzpname;
+    for (const QZipReader::FileInfo &info : zip.fileInfoList()) {
+        members.insert(info.filePath);
+        if (info.filePath.endsWith(".fzp", Qt::CaseInsensitive)) {
+            if (fzpname != "")
+                errors.append(QString("more than one fzp in archive (%1, %2)").arg(fzpname, info.filePath));
+            fzpname = info.filePath;
+        }
+    }
+    if (fzpname == "") {
+        errors.append("no fzp in archive");
+        return result;
+    }
+
+    // ---- read the fzp
+
+    struct View { QString image; QStringList layers; };
+    struct Ref { QString view; QString connector; QString layer; QString id; };
+    QHash<QString,View> views; // by view element name, e.g. "pcbView"
+    QList<Ref> refs;
+    QSet<QString> connectors;
+
+    {
+        QXmlStreamReader xml(zip.fileData(fzpname));
+        QStringList path;
+        QString connector;
+        while (!xml.atEnd()) {
+            QXmlStreamReader::TokenType token = xml.readNext();
+            if (token == QXmlStreamReader::StartElement) {
+                const QString name = xml.name().toString();
+                const QXmlStreamAttributes attrs = xml.attributes();
+                const bool inconnector = path.contains("connector");
+                const int depth = path.size();
+                if (name == "module" && depth == 0) {
+                    result.moduleid = attrs.value("moduleId").toString();
+                } else if (name == "connector") {
+                    connector = attrs.value("id").toString();
+                    if (connectors.contains(connector))
+                        errors.append(QString("duplicate connector id %1").arg(connector));
+                    connectors.insert(connector);
+                } else if (inconnector && name == "p" && depth >= 1) {
+                    const QString view = path.last(), layer = attrs.value("layer").toString();
+                    refs.append({ view, connector, layer, attrs.value("svgId").toString() });
+                    if (attrs.hasAttribute("terminalId"))
+                        refs.append({ view, connector, layer, attrs.value("terminalId").toString() });
+                } else if (!inconnector && name == "layers" && depth >= 2 && path[depth - 2] == "views") {
+                    views[path.last()].image = attrs.value("image").toString();
+                } else if (!inconnector && name == "layer" && depth >= 3 && path[depth - 3] == "views") {
+                    views[path[depth - 2]].layers.append(attrs.value("layerId").toString());
+                }
+                path.append(name);
+            } else if (token == QXmlStreamReader::EndElement) {
+                path.removeLast();
+            }
+        }
+        if (xml.hasError()) {
+            errors.append(QString("%1: %2").arg(fzpname, xml.errorString()));
+            return result;
+        }
+    }
+
+    if (result.moduleid == "")
+        errors.append("no moduleId");
+
+    // these are the ones generateFZP() always writes.
+    static const QList<QPair<QString,QStringList> > required = {
+        { "iconView", { "icon" } },
+        { "breadboardView", { "breadboard" } },
+        { "schematicView", { "schematic" } },
+        { "pcbView", { "silkscreen", "copper0", "copper1" } }
+    };
+    for (const auto &req : required)
+        for (const QString &layer : req.second)
+            if (!views.value(req.first).layers.contains(layer))
+                errors.append(QString("%1 does not have layer %2").arg(req.first, layer));
+
+    // ---- read the svgs and check that everything the fzp refers to is there
+
+    QHash<QString,QSet<QString> > ids; // by view element name; missing if svg was unusable
+    for (auto view = views.cbegin(); view != views.cend(); ++ view) {
+        const QString member = archiveName(view->image);
+        if (view->image == "") {
+            errors.append(QString("%1 has no image").arg(view.key()));
+        } else if (!members.contains(member)) {
+            errors.append(QString("%1 image %2 is not in archive").arg(view.key(), view->image));
+        } else {
+            QString error;
+            QSet<QString> svgids = svgIds(zip.fileData(member), &error);
+            if (error != "") {
+                errors.append(QString("%1: %2").arg(view->image, error));
+                continue;
+            }
+            for (const QString &layer : view->layers)
+                if (!svgids.contains(layer))
+                    errors.append(QString("%1: layer %2 not found").arg(view->image, layer));
+            ids.insert(view.key(), svgids);
+        }
+    }
+
+    for (const Ref &ref : refs) {
+        auto svgids = ids.constFind(ref.view);
+        if (svgids == ids.cend()) {
+            if (!views.contains(ref.view))
+                errors.append(QString("%1: %2 has no image").arg(ref.connector, ref.view));
+        } else if (!svgids->contains(ref.id)) {
+            errors.append(QString("%1: %2 not found in %3 (layer %4)")
+                          .arg(ref.connector, ref.id, views[ref.view].image, ref.layer));
+        }
+    }
+
+    return result;
+
+}
+
+QList<VerifyResult> verifyPartArchives (const QStringList &fzpzs) {
+
+    QList<VerifyResult> results = QtConcurrent::blockingMapped<QList<VerifyResult> >(fzpzs, verifyPartArchive);
+
+    QHash<QString,QString> owners;
+    for (VerifyResult &result : results) {
+        if (result.moduleid == "")
+            continue;
+        auto owner = owners.constFind(result.moduleid);
+        if (owner != owners.cend())
+            result.errors.append(QString("module id %1 is also used by %2").arg(result.moduleid, *owner));
+        else
+            owners.insert(result.moduleid, result.filename);
+    }
+
+    return results;
+
+}
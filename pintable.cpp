@@ -0,0 +1,229 @@
+/*----------------------------------------------------------------------
+Fritzpart - Generates Fritzing parts from a part description script.
+Copyright (C) 2021, Jason Cipriani <jason.cipriani.dev@gmail.com>
+Not affiliated with Fritzing.
+
+This file is part of Fritzpart.
+
+Fritzpart is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+https://github.com/JC3/fritzpart
+----------------------------------------------------------------------*/
+
+#include "pintable.h"
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QRegExp>
+#include <stdexcept>
+
+static QString jsonString (const QJsonValue &value) {
+    if (value.isDouble())
+        return QString::number(value.toDouble(), 'g', 17);
+    else if (value.isBool())
+        return value.toBool() ? "true" : "false";
+    else
+        return value.toString();
+}
+
+PinTableReader::PinTableReader (const QString &filename, const QStringList &options) :
+    file(filename), header(true), line(0), objects(false), jsonpos(0)
+{
+
+    static const QStringList names = { "number", "name", "x", "y", "shape", "hole", "ring" };
+    QString spec[PinTableColumns];
+    bool given[PinTableColumns];
+    for (int c = 0; c < PinTableColumns; ++ c) {
+        spec[c] = names[c];
+        given[c] = false;
+        index[c] = -1;
+    }
+
+    // ---- options
+
+    format = QFileInfo(filename).suffix().toLower();
+    for (const QString &option : options) {
+        int eq = option.indexOf('=');
+        if (eq <= 0)
+            throw std::runtime_error(QString("pintable: expected key=value, got: %1").arg(option).toStdString());
+        QString key = option.left(eq).toLower(), value = option.mid(eq + 1);
+        int c = names.indexOf(key);
+        if (c >= 0) {
+            spec[c] = value;
+            given[c] = true;
+        } else if (key == "format") {
+            format = value.toLower();
+        } else if (key == "header") {
+            header = QStringList({ "yes", "true", "on", "1" }).contains(value, Qt::CaseInsensitive);
+        } else if (key == "units") {
+            tableunits = value.toLower();
+        } else {
+            throw std::runtime_error(QString("pintable: unknown option: %1").arg(key).toStdString());
+        }
+    }
+    if (format == "txt")
+        format = "tsv";
+    if (format != "csv" && format != "tsv" && format != "json")
+        throw std::runtime_error(QString("pintable: unknown format: %1 (use csv, tsv or json)").arg(format).toStdString());
+
+    // ---- open
+
+    if (!file.open(QFile::ReadOnly))
+        throw std::runtime_error(QString("pintable: %1: %2").arg(filename, file.errorString()).toStdString());
+
+    if (format == "json") {
+        if (file.size() > MaxJsonSize)
+            throw std::runtime_error(error(QString("json tables can't be over %1 MB; use csv or tsv").arg(MaxJsonSize / (1024 * 1024))).toStdString());
+        QJsonParseError jerr;
+        QJsonDocument doc = QJsonDocument::fromJson(file.readAll(), &jerr);
+        file.close();
+        if (doc.isNull())
+            throw std::runtime_error(error(QString("offset %1: %2").arg(jerr.offset).arg(jerr.errorString())).toStdString());
+        if (!doc.isArray())
+            throw std::runtime_error(error("expected an array of rows").toStdString());
+        rows = doc.array();
+        objects = (!rows.empty() && rows[0].isObject());
+    }
+
+    // ---- map columns
+
+    QStringList headings;
+    if (header && !objects) {
+        if (!record(&headings))
+            throw std::runtime_error(error("no header row").toStdString());
+        for (QString &heading : headings)
+            heading = heading.trimmed();
+    }
+
+    for (int c = 0; c < PinTableColumns; ++ c) {
+        bool numeric;
+        int n = spec[c].toInt(&numeric);
+        if (given[c] && numeric) {
+            if (n < 1)
+                throw std::runtime_error(QString("pintable: %1: column numbers start at 1").arg(names[c]).toStdString());
+            index[c] = n - 1;
+        } else if (objects) {
+            key[c] = spec[c];
+        } else if (header) {
+            index[c] = headings.indexOf(QRegExp(QRegExp::escape(spec[c]), Qt::CaseInsensitive));
+            if (index[c] < 0 && given[c])
+                throw std::runtime_error(error(QString("no column named '%1'").arg(spec[c])).toStdString());
+        } else if (given[c]) {
+            throw std::runtime_error(QString("pintable: %1: columns must be numbers when header=no").arg(names[c]).toStdString());
+        }
+    }
+
+    for (int c : { PinXColumn, PinYColumn })
+        if (index[c] < 0 && key[c] == "")
+            throw std::runtime_error(QString("pintable: no %1 column").arg(names[c]).toStdString());
+
+}
+
+QString PinTableReader::error (const QString &message) const {
+    QString name = QFileInfo(file.fileName()).fileName();
+    return line ? QString("%1:%2: %3").arg(name).arg(line).arg(message) : QString("%1: %2").arg(name, message);
+}
+
+// reads the next raw record; false at the end of the file.
+bool PinTableReader::record (QStringList *fields) {
+
+    fields->clear();
+
+    if (format == "json") {
+        if (jsonpos >= rows.size())
+            return false;
+        line = ++ jsonpos;
+        const QJsonValue value = rows[jsonpos - 1];
+        if (!value.isArray())
+            throw std::runtime_error(error("expected an array").toStdString());
+        for (const QJsonValue &item : value.toArray())
+            fields->append(jsonString(item));
+        return true;
+    }
+
+    if (file.atEnd())
+        return false;
+
+    // rfc 4180-ish: quoted fields may contain separators, doubled quotes and line breaks.
+    const QChar sep = (format == "tsv" ? '\t' : ',');
+    QString text = QString::fromUtf8(file.readLine());
+    if (line == 0 && text.startsWith(QChar(0xFEFF)))
+        text.remove(0, 1);
+    ++ line;
+    QString field;
+    bool quoted = false;
+    for (int n = 0; ; ) {
+        if (n >= text.size()) {
+            if (!quoted || file.atEnd())
+                break;
+            text = QString::fromUtf8(file.readLine());
+            ++ line;
+            n = 0;
+            continue;
+        }
+        QChar ch = text[n ++];
+        if (quoted) {
+            if (ch != '"')
+                field += ch;
+            else if (n < text.size() && text[n] == '"')
+                field += text[n ++];
+            else
+                quoted = false;
+        } else if (ch == '"' && field.trimmed() == "") {
+            field.clear();
+            quoted = true;
+        } else if (ch == sep) {
+            fields->append(field);
+            field.clear();
+        } else if (ch != '\r' && ch != '\n') {
+            field += ch;
+        }
+    }
+    fields->append(field);
+    return true;
+
+}
+
+bool PinTableReader::next (PinTableRow *row) {
+
+    if (objects) {
+        if (jsonpos >= rows.size())
+            return false;
+        line = ++ jsonpos;
+        const QJsonValue value = rows[jsonpos - 1];
+        if (!value.isObject())
+            throw std::runtime_error(error("expected an object").toStdString());
+        const QJsonObject object = value.toObject();
+        row->line = line;
+        for (int c = 0; c < PinTableColumns; ++ c)
+            row->values[c] = (key[c] == "" ? QString() : jsonString(object.value(key[c])).trimmed());
+        return true;
+    }
+
+    QStringList fields;
+    while (record(&fields)) {
+        bool blank = true;
+        for (const QString &field : fields)
+            blank = blank && field.trimmed() == "";
+        if (blank)
+            continue;
+        row->line = line;
+        for (int c = 0; c < PinTableColumns; ++ c)
+            row->values[c] = (index[c] < 0 ? QString() : fields.value(index[c]).trimmed());
+        return true;
+    }
+
+    return false;
+
+}
@@ -0,0 +1,77 @@
+/*----------------------------------------------------------------------
+Fritzpart - Generates Fritzing parts from a part description script.
+Copyright (C) 2021, Jason Cipriani <jason.cipriani.dev@gmail.com>
+Not affiliated with Fritzing.
+
+This file is part of Fritzpart.
+
+Fritzpart is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+https://github.com/JC3/fritzpart
+----------------------------------------------------------------------*/
+
+#ifndef PINTABLE_H
+#define PINTABLE_H
+
+#include <QString>
+#include <QStringList>
+#include <QFile>
+#include <QJsonArray>
+
+enum PinTableColumn {
+    PinNumberColumn, PinNameColumn, PinXColumn, PinYColumn, PinShapeColumn, PinHoleColumn, PinRingColumn,
+    PinTableColumns
+};
+
+struct PinTableRow {
+    int line;                         // source line (csv/tsv) or array index (json), for errors
+    QString values[PinTableColumns];  // empty if the column isn't mapped
+};
+
+// reads the rows of a pin table (csv, tsv or json) one at a time. options are the
+// key=value arguments of the pintable directive:
+//
+//   format=csv|tsv|json   default: from the file extension
+//   header=yes|no         default: yes, the first row names the columns
+//   units=...             units of the table's values (default: same as the part)
+//   number= name= x= y= shape= hole= ring=
+//                         column, either by header name or 1-based index. by default
+//                         columns with those names are used if the header has them.
+//
+// json files are either an array of arrays (like csv rows) or an array of objects,
+// in which case the column names are object keys. csv and tsv are read a row at a
+// time, but json is parsed whole, so json tables are limited to MaxJsonSize bytes.
+// throws std::runtime_error on bad options or malformed files.
+class PinTableReader {
+public:
+    enum { MaxJsonSize = 16 * 1024 * 1024 };
+    PinTableReader (const QString &filename, const QStringList &options);
+    bool next (PinTableRow *row);
+    QString units () const { return tableunits; }
+private:
+    bool record (QStringList *fields);
+    QString error (const QString &message) const;
+    QFile file;
+    QString format;
+    QString tableunits;
+    bool header;
+    int line;
+    int index[PinTableColumns];   // field index, or -1
+    QString key[PinTableColumns]; // json object key
+    QJsonArray rows;
+    bool objects;
+    int jsonpos;
+};
+
+#endif // PINTABLE_H
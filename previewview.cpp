@@ -0,0 +1,530 @@
+/*----------------------------------------------------------------------
+Fritzpart - Generates Fritzing parts from a part description script.
+Copyright (C) 2021, Jason Cipriani <jason.cipriani.dev@gmail.com>
+Not affiliated with Fritzing.
+
+This file is part of Fritzpart.
+
+Fritzpart is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+https://github.com/JC3/fritzpart
+----------------------------------------------------------------------*/
+
+
+#include "previewview.h"
+#include "rectindex.h"
+#include <QApplication>
+#include <QDomDocument>
+#include <QSvgRenderer>
+#include <QPainter>
+#include <QTextStream>
+#include <QRegularExpression>
+#include <QWheelEvent>
+#include <QMouseEvent>
+#include <QtConcurrent>
+#include <functional>
+#include <algorithm>
+#include <cmath>
+
+// everything the tile renderer and the dirty tile check need to know about one svg.
+struct PreviewContent {
+    QByteArray svg;          // with an id on every leaf element, so the renderer can find them
+    QRectF viewbox;          // empty if there's nothing to show
+    double unitscale;        // pixels per user unit at level 0 (i.e. the svg's own size)
+    QHash<QString,QList<QRectF> > shapes;   // leaf element (in context) -> bounds, user units
+    QHash<QString,QRectF> targets;          // probe targets by id, user units
+    QStringList targetids;                  // by index value
+    RectIndex targetindex;
+    PreviewContent () : unitscale(1) { }
+};
+
+struct PreviewTile {
+    QSharedPointer<const PreviewContent> content;
+    quint64 key;
+    QImage image;
+};
+
+enum { BatchSize = 8 };
+
+static quint64 tileKey (int level, const QPoint &pos) {
+    return ((quint64)(quint16)level << 48) | ((quint64)(pos.x() & 0xffffff) << 24) | (quint64)(pos.y() & 0xffffff);
+}
+
+static int tileLevel (quint64 key) {
+    return (qint16)(key >> 48);
+}
+
+static QPoint tilePos (quint64 key) {
+    return QPoint((key >> 24) & 0xffffff, key & 0xffffff);
+}
+
+// the element's tag and attributes, which is all that can change how its children look.
+static QString startTag (const QDomElement &el) {
+    QString tag = "<" + el.tagName();
+    QDomNamedNodeMap attrs = el.attributes();
+    for (int n = 0; n < attrs.size(); ++ n)
+        tag += " " + attrs.item(n).nodeName() + "=" + attrs.item(n).nodeValue();
+    return tag + ">";
+}
+
+static double strokeWidth (QDomElement el) {
+    for (; !el.isNull(); el = el.parentNode().toElement())
+        if (el.hasAttribute("stroke-width"))
+            return el.attribute("stroke-width").remove(QRegularExpression("[^0-9.]+$")).toDouble();
+    return 0;
+}
+
+static QTransform transformForElement (const QSvgRenderer &renderer, const QString &id) {
+#if QT_VERSION >= QT_VERSION_CHECK(5, 15, 0)
+    return renderer.transformForElement(id);
+#else
+    return QTransform(renderer.matrixForElement(id));
+#endif
+}
+
+static QSharedPointer<const PreviewContent> prepareContent (const QByteArray &svg, const QRegularExpression &probeids) {
+
+    QSharedPointer<PreviewContent> content(new PreviewContent());
+    QDomDocument doc;
+    if (svg.isEmpty() || !doc.setContent(svg))
+        return content;
+
+    // every leaf gets an id (if it doesn't have one) and a signature made of itself and
+    // everything above it, so the same signature means the same pixels.
+    QList<QPair<QString,QDomElement> > leaves;
+    QList<QDomElement> targets;
+    int nextid = 0;
+    std::function<void(QDomElement,const QString&)> walk = [&](QDomElement el, const QString &context) {
+        static const QStringList invisible = { "title", "desc", "metadata" };
+        if (invisible.contains(el.tagName()))
+            return;
+        if (!probeids.pattern().isEmpty() && el.hasAttribute("id") && probeids.match(el.attribute("id")).hasMatch())
+            targets.append(el);
+        if (el.firstChildElement().isNull()) {
+            QString signature;
+            QTextStream out(&signature);
+            el.save(out, -1);
+            out.flush();
+            if (!el.hasAttribute("id"))
+                el.setAttribute("id", QString("preview-%1").arg(nextid ++));
+            leaves.append(qMakePair(context + signature, el));
+        } else {
+            QString inner = context + startTag(el);
+            for (QDomElement ec = el.firstChildElement(); !ec.isNull(); ec = ec.nextSiblingElement())
+                walk(ec, inner);
+        }
+    };
+    walk(doc.documentElement(), QString());
+
+    content->svg = doc.toByteArray(-1);
+    QSvgRenderer renderer(content->svg);
+    if (!renderer.isValid() || renderer.viewBoxF().isEmpty())
+        return content;
+    content->viewbox = renderer.viewBoxF();
+    content->unitscale = renderer.defaultSize().width() / content->viewbox.width();
+
+    // anything the renderer can't place (defs, styles, ...) could affect it all.
+    const double slop = 0.005 * qMax(content->viewbox.width(), content->viewbox.height());
+    for (const auto &leaf : leaves) {
+        const QString id = leaf.second.attribute("id");
+        QRectF bounds = renderer.boundsOnElement(id);
+        if (bounds.width() <= 0 && bounds.height() <= 0) {
+            bounds = content->viewbox;
+        } else {
+            const double margin = strokeWidth(leaf.second) + slop;
+            bounds = transformForElement(renderer, id).mapRect(bounds).adjusted(-margin, -margin, margin, margin);
+        }
+        content->shapes[leaf.first].append(bounds);
+    }
+
+    QList<QPair<QRectF,int> > indexed;
+    for (const QDomElement &target : targets) {
+        const QString id = target.attribute("id");
+        QRectF bounds = renderer.boundsOnElement(id);
+        const double margin = strokeWidth(target) / 2.0;
+        bounds = transformForElement(renderer, id).mapRect(bounds).adjusted(-margin, -margin, margin, margin);
+        content->targets[id] = bounds;
+        indexed.append(qMakePair(bounds, content->targetids.size()));
+        content->targetids.append(id);
+    }
+    content->targetindex = RectIndex(indexed);
+
+    return content;
+
+}
+
+// areas covered by elements that aren't in both a and b.
+static QList<QRectF> changedAreas (const PreviewContent &a, const PreviewContent &b) {
+    QList<QRectF> areas;
+    for (auto shape = a.shapes.begin(); shape != a.shapes.end(); ++ shape) {
+        auto other = b.shapes.find(shape.key());
+        if (other == b.shapes.end() || other->size() != shape->size())
+            areas += *shape;
+    }
+    for (auto shape = b.shapes.begin(); shape != b.shapes.end(); ++ shape) {
+        auto other = a.shapes.find(shape.key());
+        if (other == a.shapes.end() || other->size() != shape->size())
+            areas += *shape;
+    }
+    return areas;
+}
+
+static QList<PreviewTile> renderTiles (QSharedPointer<const PreviewContent> content, int level, double scale, QList<QPoint> positions) {
+    QList<PreviewTile> rendered;
+    QSvgRenderer renderer(content->svg);
+    const QRectF bounds(0, 0, content->viewbox.width() * scale, content->viewbox.height() * scale);
+    for (const QPoint &pos : positions) {
+        QImage image(PreviewView::TileSize, PreviewView::TileSize, QImage::Format_ARGB32_Premultiplied);
+        image.fill(Qt::transparent);
+        QPainter painter(&image);
+        painter.setRenderHint(QPainter::Antialiasing);
+        painter.translate(-pos.x() * PreviewView::TileSize, -pos.y() * PreviewView::TileSize);
+        painter.setClipRect(QRect(pos * PreviewView::TileSize, QSize(PreviewView::TileSize, PreviewView::TileSize)));
+        renderer.render(&painter, bounds);
+        painter.end();
+        rendered.append({ content, tileKey(level, pos), image });
+    }
+    return rendered;
+}
+
+PreviewView::PreviewView (QWidget *parent) :
+    QWidget(parent),
+    haspending(false),
+    level(0),
+    fallback(0),
+    fit(true),
+    frame(0)
+{
+    setToolTip("Wheel to zoom, drag to pan, double click to fit.");
+    connect(&preparing, &QFutureWatcher<ContentPtr>::finished, this, &PreviewView::contentPrepared);
+    connect(&rendering, &QFutureWatcher<QList<PreviewTile> >::finished, this, &PreviewView::tilesRendered);
+}
+
+// running jobs only hold their own copies of the content, so they're left to finish.
+PreviewView::~PreviewView () {
+}
+
+void PreviewView::setContent (const QByteArray &svg) {
+    if (preparing.isRunning()) {
+        pending = svg;
+        haspending = true;
+    } else {
+        preparing.setFuture(QtConcurrent::run(prepareContent, svg, probeids));
+    }
+}
+
+void PreviewView::contentPrepared () {
+
+    ContentPtr next = preparing.result();
+    if (haspending) {
+        preparing.setFuture(QtConcurrent::run(prepareContent, pending, probeids));
+        pending.clear();
+        haspending = false;
+    }
+
+    if (content && next->viewbox == content->viewbox && next->unitscale == content->unitscale) {
+        const QList<QRectF> dirty = changedAreas(*content, *next);
+        for (auto tile = tiles.begin(); tile != tiles.end(); ++ tile) {
+            const double size = TileSize / scale(tileLevel(tile.key()));
+            QRectF area(content->viewbox.topLeft() + QPointF(tilePos(tile.key())) * size, QSizeF(size, size));
+            for (const QRectF &rect : dirty) {
+                if (rect.intersects(area)) {
+                    tile->stale = true;
+                    break;
+                }
+            }
+        }
+    } else {
+        tiles.clear();
+        if (!fit && content && !next->viewbox.contains(center))
+            fit = true;
+    }
+
+    content = next;
+    if (fit)
+        zoomToFit();
+    update();
+
+}
+
+void PreviewView::tilesRendered () {
+    for (const PreviewTile &rendered : rendering.result()) {
+        if (rendered.content != content)
+            continue;
+        Tile &tile = tiles[rendered.key];
+        tile.image = rendered.image;
+        tile.stale = false;
+        tile.used = frame;
+    }
+    evictTiles();
+    update();
+}
+
+double PreviewView::scale (int level) const {
+    return (content ? content->unitscale : 1.0) * std::pow(2.0, level / 4.0);
+}
+
+// device pixel position of the top left of the content, at the current view.
+QPointF PreviewView::origin (int level) const {
+    const QPointF wc = QPointF(width(), height()) * devicePixelRatioF() / 2.0;
+    const QPointF o = wc - (center - content->viewbox.topLeft()) * scale(level);
+    return QPointF(std::round(o.x()), std::round(o.y()));
+}
+
+// device pixels <-> user units, at the current view.
+QPointF PreviewView::toUnits (const QPointF &device) const {
+    return content->viewbox.topLeft() + (device - origin(level)) / scale(level);
+}
+
+QRectF PreviewView::toDevice (const QRectF &units) const {
+    return QRectF(origin(level) + (units.topLeft() - content->viewbox.topLeft()) * scale(level), units.size() * scale(level));
+}
+
+// the smallest probe target under pos (give or take a few pixels, so thin lines can
+// be hit).
+QString PreviewView::targetAt (const QPoint &pos) const {
+    if (!content || content->viewbox.isEmpty())
+        return QString();
+    const QPointF under = toUnits(QPointF(pos) * devicePixelRatioF());
+    const double slop = 3.0 * devicePixelRatioF() / scale(level);
+    QString best;
+    double bestarea = 0;
+    for (int n : content->targetindex.query(QRectF(under - QPointF(slop, slop), QSizeF(2 * slop, 2 * slop)))) {
+        const QString &id = content->targetids[n];
+        const QRectF bounds = content->targets[id];
+        const double area = bounds.width() * bounds.height();
+        if (best.isEmpty() || area < bestarea) {
+            best = id;
+            bestarea = area;
+        }
+    }
+    return best;
+}
+
+void PreviewView::setHighlight (const QStringList &ids) {
+
+    if (ids == highlight)
+        return;
+    highlight = ids;
+
+    if (content && !content->viewbox.isEmpty()) {
+        const QRectF view(0, 0, width() * devicePixelRatioF(), height() * devicePixelRatioF());
+        QRectF first;
+        bool inview = false;
+        for (const QString &id : highlight) {
+            auto target = content->targets.constFind(id);
+            if (target == content->targets.constEnd())
+                continue;
+            if (first.isNull())
+                first = *target;
+            inview = inview || view.intersects(toDevice(*target));
+        }
+        if (!first.isNull() && !inview) {
+            center = first.center();
+            fit = false;
+        }
+    }
+    update();
+
+}
+
+// tiles of the given level that cover the current view.
+QList<QPoint> PreviewView::visibleTiles (int lvl) const {
+    QList<QPoint> visible;
+    const double s = scale(level), f = scale(lvl) / s;
+    const QRectF view(-origin(level) * f, QSizeF(size()) * devicePixelRatioF() * f);
+    const QRectF all(0, 0, content->viewbox.width() * scale(lvl), content->viewbox.height() * scale(lvl));
+    const QRectF area = view & all;
+    if (area.isEmpty())
+        return visible;
+    const int x0 = (int)(area.left() / TileSize), x1 = (int)std::ceil(area.right() / TileSize);
+    const int y0 = (int)(area.top() / TileSize), y1 = (int)std::ceil(area.bottom() / TileSize);
+    for (int y = y0; y < y1; ++ y)
+        for (int x = x0; x < x1; ++ x)
+            visible.append(QPoint(x, y));
+    return visible;
+}
+
+// draws a level's cached tiles scaled to the current view. returns the area (device
+// pixels) of tiles that aren't cached.
+QRegion PreviewView::drawLevel (QPainter &painter, int lvl) {
+    QRegion missing;
+    const double f = scale(level) / scale(lvl);
+    const QPointF o = origin(level);
+    for (const QPoint &pos : visibleTiles(lvl)) {
+        const QRectF target(o + QPointF(pos) * TileSize * f, QSizeF(TileSize, TileSize) * f);
+        auto tile = tiles.find(tileKey(lvl, pos));
+        if (tile == tiles.end()) {
+            missing += target.toAlignedRect();
+        } else {
+            tile->used = frame;
+            painter.drawImage(target, tile->image);
+        }
+    }
+    return missing;
+}
+
+void PreviewView::paintEvent (QPaintEvent *) {
+    if (!content || content->viewbox.isEmpty())
+        return;
+    QPainter painter(this);
+    painter.scale(1.0 / devicePixelRatioF(), 1.0 / devicePixelRatioF());
+    painter.setRenderHint(QPainter::SmoothPixmapTransform);
+    ++ frame;
+    QRegion missing = drawLevel(painter, level);
+    if (missing.isEmpty()) {
+        fallback = level;
+    } else if (fallback != level) {
+        // scale up (or down) whatever was showing before until the new tiles are in.
+        painter.setClipRegion(missing);
+        drawLevel(painter, fallback);
+        painter.setClipping(false);
+    }
+    if (!highlight.isEmpty()) {
+        const double dpr = devicePixelRatioF();
+        painter.setPen(QPen(QColor(230, 0, 230), 2.0 * dpr));
+        painter.setBrush(QColor(230, 0, 230, 60));
+        for (const QString &id : highlight) {
+            auto target = content->targets.constFind(id);
+            if (target == content->targets.constEnd())
+                continue;
+            // tiny ones are still at least a few pixels across.
+            QRectF box = toDevice(*target);
+            const double grow = qMax(0.0, 8.0 * dpr - qMin(box.width(), box.height())) / 2.0;
+            painter.drawRect(box.adjusted(-grow, -grow, grow, grow));
+        }
+    }
+    renderMissingTiles();
+}
+
+// starts rendering the next batch of visible tiles that are missing or stale, nearest to
+// the middle first. does nothing if a batch is already running; it'll come back here
+// when that one's done.
+void PreviewView::renderMissingTiles () {
+    if (!content || content->viewbox.isEmpty() || rendering.isRunning())
+        return;
+    QList<QPoint> missing, stale;
+    for (const QPoint &pos : visibleTiles(level)) {
+        auto tile = tiles.constFind(tileKey(level, pos));
+        if (tile == tiles.constEnd())
+            missing.append(pos);
+        else if (tile->stale)
+            stale.append(pos);
+    }
+    const QPointF middle = (QPointF(width(), height()) * devicePixelRatioF() / 2.0 - origin(level)) / TileSize;
+    auto nearest = [&](const QPoint &a, const QPoint &b) {
+        return (QPointF(a) - middle).manhattanLength() < (QPointF(b) - middle).manhattanLength();
+    };
+    std::sort(missing.begin(), missing.end(), nearest);
+    std::sort(stale.begin(), stale.end(), nearest);
+    QList<QPoint> batch = (missing + stale).mid(0, BatchSize);
+    if (!batch.isEmpty())
+        rendering.setFuture(QtConcurrent::run(renderTiles, content, level, scale(level), batch));
+}
+
+// drops the least recently drawn tiles once there are too many. tiles drawn in the last
+// frame are kept no matter what.
+void PreviewView::evictTiles () {
+    if (tiles.size() <= MaxCachedTiles)
+        return;
+    QList<QPair<quint64,quint64> > ages;
+    for (auto tile = tiles.constBegin(); tile != tiles.constEnd(); ++ tile)
+        ages.append(qMakePair(tile->used, tile.key()));
+    std::sort(ages.begin(), ages.end());
+    for (int n = 0; n < ages.size() && tiles.size() > MaxCachedTiles * 3 / 4 && ages[n].first < frame; ++ n)
+        tiles.remove(ages[n].second);
+}
+
+void PreviewView::zoomToFit () {
+    fit = true;
+    if (!content || content->viewbox.isEmpty()) {
+        update();
+        return;
+    }
+    const QSizeF avail = QSizeF(size()) * devicePixelRatioF();
+    level = MaxLevel;
+    while (level > MinLevel && (content->viewbox.width() * scale(level) > avail.width() ||
+                                content->viewbox.height() * scale(level) > avail.height()))
+        -- level;
+    center = content->viewbox.center();
+    update();
+}
+
+void PreviewView::zoomIn () {
+    setLevel(level + 1, QPointF(width(), height()) * devicePixelRatioF() / 2.0);
+}
+
+void PreviewView::zoomOut () {
+    setLevel(level - 1, QPointF(width(), height()) * devicePixelRatioF() / 2.0);
+}
+
+// zooms keeping the content under anchor (device pixels) where it is.
+void PreviewView::setLevel (int lvl, const QPointF &anchor) {
+    lvl = qBound((int)MinLevel, lvl, (int)MaxLevel);
+    if (!content || content->viewbox.isEmpty() || lvl == level)
+        return;
+    const QPointF offset = anchor - QPointF(width(), height()) * devicePixelRatioF() / 2.0;
+    const QPointF under = center + offset / scale(level);
+    level = lvl;
+    center = under - offset / scale(level);
+    fit = false;
+    update();
+}
+
+void PreviewView::resizeEvent (QResizeEvent *) {
+    if (fit)
+        zoomToFit();
+}
+
+void PreviewView::wheelEvent (QWheelEvent *event) {
+    if (event->angleDelta().y() == 0)
+        return;
+    setLevel(level + (event->angleDelta().y() > 0 ? 1 : -1), event->position() * devicePixelRatioF());
+    event->accept();
+    emit activated();
+}
+
+void PreviewView::mousePressEvent (QMouseEvent *event) {
+    if (event->button() == Qt::LeftButton) {
+        dragfrom = event->pos();
+        pressedat = event->pos();
+        setCursor(Qt::ClosedHandCursor);
+    }
+    emit activated();
+}
+
+void PreviewView::mouseMoveEvent (QMouseEvent *event) {
+    if (!(event->buttons() & Qt::LeftButton) || !content || content->viewbox.isEmpty())
+        return;
+    center -= QPointF(event->pos() - dragfrom) * devicePixelRatioF() / scale(level);
+    center.setX(qBound(content->viewbox.left(), center.x(), content->viewbox.right()));
+    center.setY(qBound(content->viewbox.top(), center.y(), content->viewbox.bottom()));
+    dragfrom = event->pos();
+    fit = false;
+    update();
+}
+
+// a click that didn't turn into a drag probes whatever's under it.
+void PreviewView::mouseReleaseEvent (QMouseEvent *event) {
+    unsetCursor();
+    if (event->button() == Qt::LeftButton && (event->pos() - pressedat).manhattanLength() < QApplication::startDragDistance()) {
+        const QString id = targetAt(event->pos());
+        if (id != "")
+            emit probed(id);
+    }
+}
+
+void PreviewView::mouseDoubleClickEvent (QMouseEvent *) {
+    zoomToFit();
+}
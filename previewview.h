@@ -0,0 +1,114 @@
+/*----------------------------------------------------------------------
+Fritzpart - Generates Fritzing parts from a part description script.
+Copyright (C) 2021, Jason Cipriani <jason.cipriani.dev@gmail.com>
+Not affiliated with Fritzing.
+
+This file is part of Fritzpart.
+
+Fritzpart is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+https://github.com/JC3/fritzpart
+----------------------------------------------------------------------*/
+
+
+#ifndef PREVIEWVIEW_H
+#define PREVIEWVIEW_H
+
+#include <QWidget>
+#include <QByteArray>
+#include <QHash>
+#include <QImage>
+#include <QList>
+#include <QFutureWatcher>
+#include <QSharedPointer>
+#include <QRegion>
+#include <QRegularExpression>
+#include <QStringList>
+
+struct PreviewContent;
+struct PreviewTile;
+
+// zoomable, pannable svg preview. the svg is rasterized in tiles on a background thread
+// and the tiles are cached per zoom level, so panning and going back to a zoom level
+// that's already been seen don't render anything. when the content changes, only the
+// tiles overlapping elements that were added, removed or changed are re-rendered (the
+// old ones are shown until the new ones are ready).
+//
+// wheel zooms around the mouse, dragging pans, double click goes back to fit-to-window.
+// clicking an element whose id matches the probe targets emits probed() with its id
+// (hit testing goes through a RectIndex, so it's fast on huge parts), and highlighted
+// elements are outlined on top of the tiles.
+class PreviewView : public QWidget {
+    Q_OBJECT
+public:
+    explicit PreviewView (QWidget *parent = nullptr);
+    ~PreviewView ();
+    void setContent (const QByteArray &svg);    // empty clears it
+    void clear () { setContent(QByteArray()); }
+    void setProbeTargets (const QRegularExpression &ids) { probeids = ids; } // for the next setContent()
+    void setHighlight (const QStringList &ids);  // scrolls to the first if none are in view
+    QString targetAt (const QPoint &pos) const;  // widget coordinates; empty if nothing's there
+    enum { TileSize = 256, MaxCachedTiles = 192, MinLevel = -24, MaxLevel = 32 };
+signals:
+    void probed (const QString &id);
+    void activated (); // zoomed, panned or clicked
+public slots:
+    void zoomToFit ();
+    void zoomIn ();
+    void zoomOut ();
+protected:
+    void paintEvent (QPaintEvent *event) override;
+    void resizeEvent (QResizeEvent *event) override;
+    void wheelEvent (QWheelEvent *event) override;
+    void mousePressEvent (QMouseEvent *event) override;
+    void mouseMoveEvent (QMouseEvent *event) override;
+    void mouseReleaseEvent (QMouseEvent *event) override;
+    void mouseDoubleClickEvent (QMouseEvent *event) override;
+private slots:
+    void contentPrepared ();
+    void tilesRendered ();
+private:
+    typedef QSharedPointer<const PreviewContent> ContentPtr;
+    struct Tile {
+        QImage image;
+        bool stale;        // content changed under it; shown until it's re-rendered
+        quint64 used;
+    };
+    ContentPtr content;
+    QHash<quint64,Tile> tiles;
+    QFutureWatcher<ContentPtr> preparing;
+    QFutureWatcher<QList<PreviewTile> > rendering;
+    QByteArray pending;
+    bool haspending;
+    int level;
+    int fallback;          // last level that was completely drawn, shown while tiles load
+    QPointF center;        // in svg user units
+    bool fit;
+    QPoint dragfrom;
+    QPoint pressedat;
+    QRegularExpression probeids;
+    QStringList highlight;
+    quint64 frame;
+    double scale (int level) const;
+    QPointF origin (int level) const;
+    QPointF toUnits (const QPointF &device) const;
+    QRectF toDevice (const QRectF &units) const;
+    QList<QPoint> visibleTiles (int level) const;
+    QRegion drawLevel (QPainter &painter, int level);
+    void setLevel (int level, const QPointF &anchor);
+    void renderMissingTiles ();
+    void evictTiles ();
+};
+
+#endif // PREVIEWVIEW_H
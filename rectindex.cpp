@@ -0,0 +1,128 @@
+/*----------------------------------------------------------------------
+Fritzpart - Generates Fritzing parts from a part description script.
+Copyright (C) 2021, Jason Cipriani <jason.cipriani.dev@gmail.com>
+Not affiliated with Fritzing.
+
+This file is part of Fritzpart.
+
+Fritzpart is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+https://github.com/JC3/fritzpart
+----------------------------------------------------------------------*/
+
+
+#include "rectindex.h"
+#include <algorithm>
+#include <cmath>
+
+// unlike QRectF's, these are fine with zero width or height (e.g. straight lines).
+static bool overlaps (const QRectF &a, const QRectF &b) {
+    return a.left() <= b.right() && b.left() <= a.right() && a.top() <= b.bottom() && b.top() <= a.bottom();
+}
+
+static QRectF merged (const QRectF &a, const QRectF &b) {
+    return QRectF(QPointF(qMin(a.left(), b.left()), qMin(a.top(), b.top())),
+                  QPointF(qMax(a.right(), b.right()), qMax(a.bottom(), b.bottom())));
+}
+
+RectIndex::RectIndex (const QList<QPair<QRectF,int> > &items) {
+
+    if (items.isEmpty())
+        return;
+
+    QVector<Entry> entries;
+    entries.reserve(items.size());
+    for (const auto &item : items)
+        entries.append({ item.first.normalized(), item.second });
+    pack(entries);
+    rects.reserve(entries.size());
+    values.reserve(entries.size());
+    for (const Entry &entry : entries) {
+        rects.append(entry.rect);
+        values.append(entry.value);
+    }
+
+    // each level is packed the same way over the bounds of the one below, which gets
+    // reordered to match, until there's a single root.
+    levels.append(group(entries));
+    while (levels.last().size() > 1) {
+        const QVector<Node> below = levels.last();
+        QVector<Entry> nodes;
+        nodes.reserve(below.size());
+        for (int n = 0; n < below.size(); ++ n)
+            nodes.append({ below[n].bounds, n });
+        pack(nodes);
+        QVector<Node> &reordered = levels.last();
+        for (int n = 0; n < nodes.size(); ++ n)
+            reordered[n] = below[nodes[n].value];
+        levels.append(group(nodes));
+    }
+
+}
+
+// orders entries so that each run of NodeSize is close together: vertical slices by x
+// center, then by y center within each slice.
+void RectIndex::pack (QVector<Entry> &entries) {
+
+    const int nodes = (entries.size() + NodeSize - 1) / NodeSize;
+    const int slices = (int)std::ceil(std::sqrt((double)nodes));
+    const int perslice = slices * NodeSize;
+
+    std::sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) {
+        return a.rect.center().x() < b.rect.center().x();
+    });
+    for (int start = 0; start < entries.size(); start += perslice) {
+        auto end = entries.begin() + qMin(start + perslice, entries.size());
+        std::sort(entries.begin() + start, end, [](const Entry &a, const Entry &b) {
+            return a.rect.center().y() < b.rect.center().y();
+        });
+    }
+
+}
+
+QVector<RectIndex::Node> RectIndex::group (const QVector<Entry> &entries) {
+    QVector<Node> nodes;
+    for (int first = 0; first < entries.size(); first += NodeSize) {
+        Node node = { QRectF(), first, qMin((int)NodeSize, entries.size() - first) };
+        node.bounds = entries[first].rect;
+        for (int n = first + 1; n < first + node.count; ++ n)
+            node.bounds = merged(node.bounds, entries[n].rect);
+        nodes.append(node);
+    }
+    return nodes;
+}
+
+QList<int> RectIndex::query (const QRectF &area) const {
+
+    QList<int> found;
+    if (levels.isEmpty())
+        return found;
+
+    // (level, node) pairs still to look at.
+    QVector<QPair<int,int> > stack = { qMakePair(levels.size() - 1, 0) };
+    while (!stack.isEmpty()) {
+        const QPair<int,int> at = stack.takeLast();
+        const Node &node = levels[at.first][at.second];
+        if (!overlaps(node.bounds, area))
+            continue;
+        for (int n = node.first; n < node.first + node.count; ++ n) {
+            if (at.first > 0)
+                stack.append(qMakePair(at.first - 1, n));
+            else if (overlaps(rects[n], area))
+                found.append(values[n]);
+        }
+    }
+    return found;
+
+}
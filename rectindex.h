@@ -0,0 +1,60 @@
+/*----------------------------------------------------------------------
+Fritzpart - Generates Fritzing parts from a part description script.
+Copyright (C) 2021, Jason Cipriani <jason.cipriani.dev@gmail.com>
+Not affiliated with Fritzing.
+
+This file is part of Fritzpart.
+
+Fritzpart is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+https://github.com/JC3/fritzpart
+----------------------------------------------------------------------*/
+
+
+#ifndef RECTINDEX_H
+#define RECTINDEX_H
+
+#include <QRectF>
+#include <QVector>
+#include <QList>
+#include <QPair>
+
+// static r-tree over rectangles, for hit testing previews with thousands of pins. it's
+// bulk loaded (sort-tile-recursive packing) and never changes afterwards, so nodes are
+// just ranges of the level below and a query is O(log n) plus the number of hits.
+class RectIndex {
+public:
+    enum { NodeSize = 16 };
+    RectIndex () { }
+    explicit RectIndex (const QList<QPair<QRectF,int> > &items);
+    QList<int> query (const QRectF &area) const; // values of items intersecting area
+    bool isEmpty () const { return rects.isEmpty(); }
+    int size () const { return rects.size(); }
+private:
+    struct Entry {
+        QRectF rect;
+        int value;
+    };
+    struct Node {
+        QRectF bounds;
+        int first, count; // children, in the level below (or items, for level 0)
+    };
+    static void pack (QVector<Entry> &entries);
+    static QVector<Node> group (const QVector<Entry> &entries);
+    QVector<QRectF> rects;
+    QVector<int> values;
+    QList<QVector<Node> > levels; // levels[0] is over the items, the last one is the root
+};
+
+#endif // RECTINDEX_H
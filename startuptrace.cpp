@@ -0,0 +1,69 @@
+/*----------------------------------------------------------------------
+Fritzpart - Generates Fritzing parts from a part description script.
+Copyright (C) 2021, Jason Cipriani <jason.cipriani.dev@gmail.com>
+Not affiliated with Fritzing.
+
+This file is part of Fritzpart.
+
+Fritzpart is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+https://github.com/JC3/fritzpart
+----------------------------------------------------------------------*/
+
+
+#include "startuptrace.h"
+#include <QElapsedTimer>
+#include <QEvent>
+#include <QMainWindow>
+#include <QStatusBar>
+#include <QDebug>
+
+static bool enabled = false;
+static QElapsedTimer timer;
+
+namespace {
+
+class FirstPaintFilter : public QObject {
+public:
+    explicit FirstPaintFilter (QObject *parent) : QObject(parent) { }
+protected:
+    bool eventFilter (QObject *watched, QEvent *event) override {
+        if (event->type() == QEvent::Paint) {
+            qint64 ms = timer.elapsed();
+            startupTrace("first paint");
+            if (QMainWindow *window = qobject_cast<QMainWindow *>(static_cast<QWidget *>(parent())->window()))
+                window->statusBar()->showMessage(QString("First paint after %1 ms.").arg(ms));
+            watched->removeEventFilter(this);
+            deleteLater();
+        }
+        return false;
+    }
+};
+
+}
+
+void enableStartupTrace () {
+    enabled = true;
+    timer.start();
+}
+
+void startupTrace (const QString &what) {
+    if (enabled)
+        qDebug().noquote() << QString("startup: %1 ms: %2").arg(timer.elapsed(), 5).arg(what);
+}
+
+void traceFirstPaint (QWidget *widget) {
+    if (enabled)
+        widget->installEventFilter(new FirstPaintFilter(widget));
+}
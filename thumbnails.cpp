@@ -0,0 +1,135 @@
+/*----------------------------------------------------------------------
+Fritzpart - Generates Fritzing parts from a part description script.
+Copyright (C) 2021, Jason Cipriani <jason.cipriani.dev@gmail.com>
+Not affiliated with Fritzing.
+
+This file is part of Fritzpart.
+
+Fritzpart is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+https://github.com/JC3/fritzpart
+----------------------------------------------------------------------*/
+
+
+#include "thumbnails.h"
+#include "partcompiler.h"
+#include "partgen.h"
+#include "atomicfile.h"
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QPainter>
+#include <QStandardPaths>
+#include <QSvgRenderer>
+#include <QDebug>
+#include <stdexcept>
+
+QString thumbnailCacheDir () {
+    return QDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation)).absoluteFilePath("thumbnails");
+}
+
+// pin tables are stored in the png as "path <tab> mtime" lines, along with the script's
+// directory (relative table paths would mean different files from somewhere else).
+static QString describeTables (const QHash<QString,QDateTime> &tables) {
+    QStringList lines;
+    for (auto table = tables.cbegin(); table != tables.cend(); ++ table)
+        lines.append(table.key() + "\t" + QString::number(table.value().toMSecsSinceEpoch()));
+    lines.sort();
+    return lines.join("\n");
+}
+
+static bool tablesUnchanged (const QString &description) {
+    for (const QString &line : description.split("\n", Qt::SkipEmptyParts)) {
+        QStringList fields = line.split("\t");
+        if (fields.size() != 2 || QFileInfo(fields[0]).lastModified().toMSecsSinceEpoch() != fields[1].toLongLong())
+            return false;
+    }
+    return true;
+}
+
+static void renderSvg (QPainter &painter, const QDomDocument &svg, const QRectF &area) {
+    QSvgRenderer renderer(svg.toByteArray(-1));
+    QSizeF size = QSizeF(renderer.defaultSize()).scaled(area.size(), Qt::KeepAspectRatio);
+    QRectF bounds(QPointF(), size);
+    bounds.moveCenter(area.center());
+    renderer.render(&painter, bounds);
+}
+
+Thumbnail partThumbnail (const QString &script, const QString &cachedir) {
+
+    Thumbnail thumb;
+    thumb.script = script;
+
+    try {
+
+        QFile file(script);
+        if (!file.open(QFile::ReadOnly | QFile::Text))
+            throw std::runtime_error(file.errorString().toStdString());
+        const QByteArray text = file.readAll();
+        const QString basedir = QFileInfo(script).absolutePath();
+
+        QCryptographicHash hash(QCryptographicHash::Sha1);
+        hash.addData(APPLICATION_VERSION);
+        hash.addData(QByteArray::number(ThumbnailWidth) + "x" + QByteArray::number(ThumbnailHeight) + "\n");
+        hash.addData(text);
+        const QString cached = QDir(cachedir).absoluteFilePath(QString::fromLatin1(hash.result().toHex()) + ".png");
+
+        QImage image;
+        if (image.load(cached, "PNG")) {
+            const QString tables = image.text("tables");
+            if (tables.isEmpty() || (image.text("basedir") == basedir && tablesUnchanged(tables))) {
+                thumb.image = image;
+                thumb.cached = true;
+                return thumb;
+            }
+        }
+
+        PartCompiler compiler;
+        compiler.setScriptPath(script);
+        Part part = compiler.compile(QString::fromUtf8(text));
+
+        image = QImage(ThumbnailWidth, ThumbnailHeight, QImage::Format_ARGB32_Premultiplied);
+        image.fill(Qt::transparent);
+        QPainter painter(&image);
+        painter.setRenderHint(QPainter::Antialiasing);
+        const double half = ThumbnailWidth / 2.0, pad = 4;
+        renderSvg(painter, generateBreadboard(part), QRectF(pad, pad, half - 1.5 * pad, ThumbnailHeight - 2 * pad));
+        renderSvg(painter, generatePCB(part), QRectF(half + 0.5 * pad, pad, half - 1.5 * pad, ThumbnailHeight - 2 * pad));
+        painter.end();
+
+        const QString tables = describeTables(compiler.pinTables());
+        if (!tables.isEmpty()) {
+            image.setText("tables", tables);
+            image.setText("basedir", basedir);
+        }
+        thumb.image = image;
+
+        // a cache that can't be written just means compiling again next time.
+        try {
+            QDir().mkpath(cachedir);
+            AtomicFile out(cached);
+            if (image.save(out.file(), "PNG"))
+                out.commit();
+        } catch (const std::exception &x) {
+            qDebug() << "thumbnail cache:" << x.what();
+        }
+
+    } catch (const std::exception &x) {
+        thumb.error = x.what();
+    }
+
+    return thumb;
+
+}
@@ -0,0 +1,48 @@
+/*----------------------------------------------------------------------
+Fritzpart - Generates Fritzing parts from a part description script.
+Copyright (C) 2021, Jason Cipriani <jason.cipriani.dev@gmail.com>
+Not affiliated with Fritzing.
+
+This file is part of Fritzpart.
+
+Fritzpart is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+https://github.com/JC3/fritzpart
+----------------------------------------------------------------------*/
+
+
+#ifndef THUMBNAILS_H
+#define THUMBNAILS_H
+
+#include <QString>
+#include <QImage>
+
+enum { ThumbnailWidth = 200, ThumbnailHeight = 120 };
+
+struct Thumbnail {
+    QString script;
+    QImage image;     // null if the script didn't compile
+    QString error;
+    bool cached;      // came from the cache without compiling anything
+    Thumbnail () : cached(false) { }
+};
+
+// the gallery picture of a part script: breadboard on the left, pcb on the right. they're
+// cached as pngs in cachedir, named by a hash of the script text, and reused as long as
+// the script and any pin tables it reads haven't changed. safe to call from any thread.
+Thumbnail partThumbnail (const QString &script, const QString &cachedir);
+
+QString thumbnailCacheDir ();
+
+#endif // THUMBNAILS_H
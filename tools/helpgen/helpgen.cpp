@@ -0,0 +1,152 @@
+/*----------------------------------------------------------------------
+Fritzpart - Generates Fritzing parts from a part description script.
+Copyright (C) 2021, Jason Cipriani <jason.cipriani.dev@gmail.com>
+Not affiliated with Fritzing.
+
+This file is part of Fritzpart.
+
+Fritzpart is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+https://github.com/JC3/fritzpart
+----------------------------------------------------------------------*/
+
+
+// renders README.md into the html shown by the help window, plus an index of
+// directive names, so none of this has to happen when help is opened.
+//
+//   helpgen README.md manual.html manual.idx
+
+#include <QGuiApplication>
+#include <QTextDocument>
+#include <QDomDocument>
+#include <QFile>
+#include <cstdio>
+
+static QString cellText (const QDomElement &cell) {
+    return cell.text().simplified();
+}
+
+// wraps the contents of the cell's paragraph in a named anchor.
+static void addAnchor (QDomDocument &doc, QDomElement cell, const QString &name) {
+    QDomElement p = cell.firstChildElement("p");
+    if (p.isNull())
+        p = cell;
+    QDomElement a = doc.createElement("a");
+    a.setAttribute("name", name);
+    while (p.hasChildNodes())
+        a.appendChild(p.firstChild());
+    p.appendChild(a);
+}
+
+int main (int argc, char *argv[]) {
+
+    // QTextDocument needs a gui app for fonts, but there's nothing to display.
+    qputenv("QT_QPA_PLATFORM", "offscreen");
+    QGuiApplication a(argc, argv);
+
+    if (argc != 4) {
+        fprintf(stderr, "usage: helpgen README.md manual.html manual.idx\n");
+        return 2;
+    }
+
+    QFile in(argv[1]);
+    if (!in.open(QFile::ReadOnly)) {
+        fprintf(stderr, "helpgen: %s: %s\n", argv[1], qPrintable(in.errorString()));
+        return 1;
+    }
+
+    QTextDocument markdown;
+    markdown.setMarkdown(QString::fromUtf8(in.readAll()));
+
+    // === begin nightmare of forcing qt5 to style markdown sanely ===
+
+    QDomDocument doc;
+    doc.setContent(markdown.toHtml());
+
+    QStringList keepers = { "font-family", "font-weight", "font-style", "vertical-align" };
+    QList<QDomElement> tables;
+    for (QList<QDomElement> els = { doc.documentElement() }; !els.empty(); ) {
+        QDomElement el = els.front();
+        els.pop_front();
+        // all of these make things get weird. remove them.
+        if (el.tagName() == "br" || el.tagName() == "style" || el.tagName() == "meta") {
+            el.parentNode().removeChild(el);
+            continue;
+        }
+        if (el.tagName() == "table")
+            tables.append(el);
+        // traverse.
+        for (auto ec = el.firstChildElement(); !ec.isNull(); ec = ec.nextSiblingElement())
+            els.append(ec);
+        // discard unwanted style attribute values.
+        QStringList sts = el.attribute("style").split(";"), stk;
+        for (auto st : sts)
+            if (keepers.contains(st.split(":")[0].trimmed()))
+                stk.append(st.trimmed());
+        if (stk.empty() || el.tagName() == "body")
+            el.removeAttribute("style");
+        else
+            el.setAttribute("style", stk.join("; "));
+        // dom manipulations to make code blocks look less shit.
+        if (el.tagName() == "span" &&
+                el.attribute("style").contains("font-family") &&
+                el.parentNode().toElement().tagName() == "p" &&
+                el.parentNode().toElement().text().trimmed() == el.text().trimmed())
+            el.parentNode().toElement().setAttribute("class", "code");
+        if (el.tagName() == "p" &&
+                el.attribute("style").contains("font-family") &&
+                el.text() == "")
+        {
+            el.setAttribute("class", "code");
+            el.appendChild(doc.createEntityReference("nbsp"));
+        }
+    }
+
+    // === end nightmare (sort of) ===
+
+    // the directive table is the one whose first column is "Keyword". every row gets
+    // an anchor, and the index lists "name <tab> anchor <tab> description".
+    QString index;
+    for (const QDomElement &table : tables) {
+        QDomNodeList rows = table.elementsByTagName("tr");
+        if (rows.isEmpty() || cellText(rows.at(0).firstChildElement()) != "Keyword")
+            continue;
+        for (int r = 1; r < rows.size(); ++ r) {
+            QDomElement name = rows.at(r).firstChildElement();
+            QString keyword = cellText(name);
+            if (keyword == "" || keyword.contains(' '))
+                continue;
+            QString anchor = "directive-" + keyword;
+            QString description = cellText(rows.at(r).lastChildElement());
+            addAnchor(doc, name, anchor);
+            index += keyword + "\t" + anchor + "\t" + description + "\n";
+        }
+    }
+
+    if (index == "") {
+        fprintf(stderr, "helpgen: %s: directive table not found\n", argv[1]);
+        return 1;
+    }
+
+    QFile html(argv[2]), idx(argv[3]);
+    if (!html.open(QFile::WriteOnly | QFile::Truncate) || !idx.open(QFile::WriteOnly | QFile::Truncate)) {
+        fprintf(stderr, "helpgen: %s\n", qPrintable(html.isOpen() ? idx.errorString() : html.errorString()));
+        return 1;
+    }
+    html.write(doc.toString().toUtf8());
+    idx.write(index.toUtf8());
+
+    return 0;
+
+}
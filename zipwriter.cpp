@@ -0,0 +1,197 @@
+/*----------------------------------------------------------------------
+Fritzpart - Generates Fritzing parts from a part description script.
+Copyright (C) 2021, Jason Cipriani <jason.cipriani.dev@gmail.com>
+Not affiliated with Fritzing.
+
+This file is part of Fritzpart.
+
+Fritzpart is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+https://github.com/JC3/fritzpart
+----------------------------------------------------------------------*/
+
+#include "zipwriter.h"
+#include "memstats.h"
+#include <QIODevice>
+#include <QFileDevice>
+#include <QtEndian>
+#include <QVector>
+#include <stdexcept>
+
+quint32 zipCrc32 (const QByteArray &data) {
+    static const auto table = []() {
+        QVector<quint32> t(256);
+        for (quint32 n = 0; n < 256; ++ n) {
+            quint32 c = n;
+            for (int k = 0; k < 8; ++ k)
+                c = (c & 1) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
+            t[n] = c;
+        }
+        return t;
+    }();
+    quint32 crc = 0xFFFFFFFFu;
+    for (char ch : data)
+        crc = table[(crc ^ (quint8)ch) & 0xFF] ^ (crc >> 8);
+    return crc ^ 0xFFFFFFFFu;
+}
+
+ZipEntry compressZipEntry (const QString &name, const QByteArray &data, int level) {
+    MemStageScope scope(StageArchive);
+    ZipEntry entry;
+    entry.name = name;
+    entry.crc = zipCrc32(data);
+    entry.size = data.size();
+    entry.deflated = false;
+    if (level > 0 && !data.isEmpty()) {
+        // qCompress gives a 4 byte length, then a zlib stream: 2 byte header, raw deflate
+        // data, 4 byte adler32. zip wants just the raw deflate data.
+        QByteArray z = qCompress(data, qMin(level, 9));
+        if (z.size() > 10 && z.size() - 10 < data.size()) {
+            entry.data = z.mid(6, z.size() - 10);
+            entry.deflated = true;
+        }
+    }
+    if (!entry.deflated)
+        entry.data = data;
+    return entry;
+}
+
+ZipWriter::ZipWriter (QIODevice *out) : out(out), offset(0) {
+    const QDateTime now = QDateTime::currentDateTime();
+    const QDate d = now.date();
+    const QTime t = now.time();
+    dosdate = (quint16)(((qMax(d.year(), 1980) - 1980) << 9) | (d.month() << 5) | d.day());
+    dostime = (quint16)((t.hour() << 11) | (t.minute() << 5) | (t.second() / 2));
+}
+
+void ZipWriter::write (const QByteArray &bytes) {
+    if (out->write(bytes) != bytes.size())
+        throw std::runtime_error(QString("zip: %1").arg(out->errorString()).toStdString());
+    offset += bytes.size();
+}
+
+static void put16 (QByteArray &b, quint16 v) {
+    char le[2];
+    qToLittleEndian(v, le);
+    b.append(le, 2);
+}
+
+static void put32 (QByteArray &b, quint32 v) {
+    char le[4];
+    qToLittleEndian(v, le);
+    b.append(le, 4);
+}
+
+void ZipWriter::add (const ZipEntry &entry) {
+
+    if (records.size() >= 0xFFFF || offset + entry.data.size() + 1024 > 0xFFFFFFFFu)
+        throw std::runtime_error("zip: archive too large");
+
+    const QByteArray name = entry.name.toUtf8();
+    Record record;
+    record.header = entry;
+    record.header.data = QByteArray();
+    record.csize = entry.data.size();
+    record.offset = (quint32)offset;
+
+    QByteArray h;
+    put32(h, 0x04034b50);
+    put16(h, 20);                        // version needed
+    put16(h, 0x0800);                    // flags: utf-8 names
+    put16(h, entry.deflated ? 8 : 0);
+    put16(h, dostime);
+    put16(h, dosdate);
+    put32(h, entry.crc);
+    put32(h, record.csize);
+    put32(h, entry.size);
+    put16(h, name.size());
+    put16(h, 0);                         // extra length
+    h.append(name);
+    write(h);
+    write(entry.data);
+
+    records.append(record);
+
+}
+
+// drops every entry from count on, and the data written for them (including whatever
+// an add() that failed part way through left behind).
+void ZipWriter::truncate (int count) {
+
+    if (count > records.size())
+        return;
+
+    quint64 to = 0;
+    if (count < records.size()) {
+        to = records[count].offset;
+    } else if (count > 0) {
+        const Record &last = records.last();
+        to = last.offset + 30 + last.header.name.toUtf8().size() + last.csize;
+    }
+    if (to == offset && (quint64)out->pos() == to)
+        return;
+
+    QFileDevice *file = qobject_cast<QFileDevice *>(out);
+    if (!file)
+        throw std::runtime_error("zip: can't truncate this device");
+    if (!file->resize(to) || !file->seek(to))
+        throw std::runtime_error(QString("zip: %1").arg(file->errorString()).toStdString());
+
+    records.erase(records.begin() + count, records.end());
+    offset = to;
+
+}
+
+void ZipWriter::close () {
+
+    const quint64 cdstart = offset;
+    QByteArray cd;
+    for (const Record &record : records) {
+        const QByteArray name = record.header.name.toUtf8();
+        put32(cd, 0x02014b50);
+        put16(cd, 20);                   // version made by
+        put16(cd, 20);                   // version needed
+        put16(cd, 0x0800);
+        put16(cd, record.header.deflated ? 8 : 0);
+        put16(cd, dostime);
+        put16(cd, dosdate);
+        put32(cd, record.header.crc);
+        put32(cd, record.csize);
+        put32(cd, record.header.size);
+        put16(cd, name.size());
+        put16(cd, 0);                    // extra length
+        put16(cd, 0);                    // comment length
+        put16(cd, 0);                    // disk number
+        put16(cd, 0);                    // internal attributes
+        put32(cd, 0);                    // external attributes
+        put32(cd, record.offset);
+        cd.append(name);
+    }
+    write(cd);
+
+    if (offset > 0xFFFFFFFFu)
+        throw std::runtime_error("zip: archive too large");
+
+    QByteArray end;
+    put32(end, 0x06054b50);
+    put16(end, 0);
+    put16(end, 0);
+    put16(end, records.size());
+    put16(end, records.size());
+    put32(end, cd.size());
+    put32(end, (quint32)cdstart);
+    put16(end, 0);
+    write(end);
+
+}
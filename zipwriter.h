@@ -0,0 +1,81 @@
+/*----------------------------------------------------------------------
+Fritzpart - Generates Fritzing parts from a part description script.
+Copyright (C) 2021, Jason Cipriani <jason.cipriani.dev@gmail.com>
+Not affiliated with Fritzing.
+
+This file is part of Fritzpart.
+
+Fritzpart is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+https://github.com/JC3/fritzpart
+----------------------------------------------------------------------*/
+
+#ifndef ZIPWRITER_H
+#define ZIPWRITER_H
+
+#include <QString>
+#include <QByteArray>
+#include <QList>
+#include <QDateTime>
+
+class QIODevice;
+
+// a zip member, already compressed and ready to be written.
+struct ZipEntry {
+    QString name;
+    QByteArray data;   // stored or raw deflate
+    quint32 crc;
+    quint32 size;      // uncompressed
+    bool deflated;
+};
+
+enum {
+    ZipStore = 0,        // no compression at all; fastest, e.g. for throwaway builds
+    ZipFastest = 1,
+    ZipDefaultLevel = 6,
+    ZipBest = 9
+};
+
+quint32 zipCrc32 (const QByteArray &data);
+
+// compresses one member at the given level (0 = store). thread safe; members are
+// independent, so callers are free to compress lots of them at once.
+ZipEntry compressZipEntry (const QString &name, const QByteArray &data, int level);
+
+// writes a zip sequentially to a device: local header + data as each entry is added,
+// then the central directory on close(). only the directory is held in memory.
+// throws std::runtime_error on write errors or if the archive gets too big for a
+// plain (non zip64) zip. truncate() takes entries back off the end; that needs the
+// device to be a file.
+class ZipWriter {
+public:
+    explicit ZipWriter (QIODevice *out);
+    void add (const ZipEntry &entry);
+    int entryCount () const { return records.size(); }
+    void truncate (int count);
+    void close ();
+private:
+    struct Record {
+        ZipEntry header; // data left empty
+        quint32 csize;
+        quint32 offset;
+    };
+    void write (const QByteArray &bytes);
+    QIODevice *out;
+    QList<Record> records;
+    quint64 offset;
+    quint16 dostime, dosdate;
+};
+
+#endif // ZIPWRITER_H